@@ -0,0 +1,212 @@
+/**
+ * \file acceptor.h
+ *
+ * \brief Header for incoming connections acceptance
+ *
+ * \author Olivier de BLIC
+ */
+
+
+
+#ifndef ACCEPTOR_H
+#define ACCEPTOR_H
+
+// Standard headers
+#include <string>
+
+// Project headers
+#include "object.h"
+#include "socket.h"
+#include "thread.h"
+
+
+
+// Forward declaration (needed because of cross-references)
+class MANAGER;
+
+
+
+/**
+ * \brief Listening socket with its accept loop
+ */
+class ACCEPTOR : public OBJECT
+{
+public:
+
+  /**
+   * \brief          Acceptor constructor
+   *
+   * \param Manager  Reference to the manager of accepted connections
+   * \param PortNum  Local port number
+   * \param Backlog  Maximal length of the queue of pending connections
+   * \param Shared   Flag telling if other acceptors listen on the same port
+   * \param Namespace Identifiers namespace of the accepted connections
+   */
+  ACCEPTOR(MANAGER& Manager, unsigned short PortNum, int Backlog, bool Shared, int Namespace = 0);
+
+
+
+  /**
+   * \brief          Acceptor constructor (Unix domain socket, for clients on the same host)
+   *
+   * \param Manager  Reference to the manager of accepted connections
+   * \param Path     Path of the listening socket
+   * \param Backlog  Maximal length of the queue of pending connections
+   */
+  ACCEPTOR(MANAGER& Manager, const std::string& Path, int Backlog);
+
+
+
+  /**
+   * \brief          Acceptor constructor (listening socket taken over from another process)
+   *
+   * \param Manager  Reference to the manager of accepted connections
+   * \param SocketId Identifier of the listening socket
+   * \param Namespace Identifiers namespace of the accepted connections
+   */
+  ACCEPTOR(MANAGER& Manager, int SocketId, int Namespace);
+
+
+
+  /**
+   * \brief          Acceptor destructor
+   */
+  virtual ~ACCEPTOR();
+
+
+
+  /**
+   * \brief          Starts the accept loop in a dedicated thread
+   *
+   * \param Cpu      Processor the thread (and the connections it accepts) runs on, -1 for any
+   */
+  void Start(int Cpu);
+
+
+
+  /**
+   * \brief          Stops the accept loop and waits for its thread
+   */
+  void Stop();
+
+
+
+  /**
+   * \brief          Steers new connections of the port to the acceptor of the receiving processor
+   *
+   * \param Count    Number of acceptors sharing the port
+   */
+  void SetCpuSteering(int Count);
+
+
+
+  /**
+   * \brief          Waits for pending connections and accepts them
+   *
+   * \param TimeoutMs Maximal waiting time (in milliseconds)
+   */
+  void Poll(int TimeoutMs);
+
+
+
+  /**
+   * \brief          Getter for the listening socket identifier
+   *
+   * \return         Socket identifier
+   */
+  int GetSocketId() const;
+
+
+
+  /**
+   * \brief          Getter for the identifiers namespace
+   *
+   * \return         Namespace of the accepted connections
+   */
+  int GetNamespace() const;
+
+
+
+  /**
+   * \brief          Getter for the number of accepted connections
+   *
+   * \return         Number of accepted connections
+   */
+  unsigned long GetAccepted() const;
+
+
+
+  /**
+   * \brief          Getter for the number of dropped connections
+   *
+   * \return         Number of connections closed at once (descriptors exhausted)
+   */
+  unsigned long GetDropped() const;
+
+
+
+  /**
+   * \brief          Getter for the number of times the accept queue was found full
+   *
+   * \return         Number of accept queue overflows
+   */
+  unsigned long GetOverflows() const;
+
+
+
+private:
+
+  /**
+   * \brief          Task for the accept loop
+   *
+   * \param  Arg     Pointer to the concerned acceptor
+   *
+   * \return         NULL
+   */
+  static void* RunTask(void* Arg);
+
+
+
+  /**
+   * \brief          Accepts all the pending connections (until the queue is empty)
+   *
+   * \return         Number of accepted connections
+   */
+  int DrainQueue();
+
+
+
+  /// Manager of accepted connections
+  MANAGER&       _Manager;
+
+  /// Listening socket
+  SOCKET&        _Listening;
+
+  /// Descriptor waking up the accept loop when it has to stop
+  int            _WakeId;
+
+  /// Thread running the accept loop (NULL until started)
+  THREAD*        _Thread;
+
+  /// Flag for state of the accept loop
+  volatile bool  _Running;
+
+  /// Number of accepted connections
+  unsigned long  _Accepted;
+
+  /// Number of dropped connections
+  unsigned long  _Dropped;
+
+  /// Number of accept queue overflows
+  unsigned long  _Overflows;
+
+  /// Highest accept queue length observed
+  int            _MaxQueue;
+
+  /// Identifiers namespace of the accepted connections
+  const int      _Namespace;
+};
+
+
+
+#endif
@@ -0,0 +1,149 @@
+/**
+ * \file admin.h
+ *
+ * \brief Header for the administration endpoint (metrics exposition)
+ *
+ * \author Olivier de BLIC
+ */
+
+
+
+#ifndef ADMIN_H
+#define ADMIN_H
+
+// Standard headers
+#include <string>
+#include <vector>
+#include <poll.h>
+
+// Project headers
+#include "object.h"
+#include "statpage.h"
+
+
+
+/// Client of the administration endpoint
+typedef struct
+{
+  /// Socket identifier
+  int          SocketId;
+
+  /// Request received so far
+  std::string  Request;
+
+  /// Reply (empty while the request is incomplete)
+  std::string  Reply;
+
+  /// Number of bytes of the reply already sent
+  size_t       Offset;
+
+  /// Time the client is closed at if still there (coarse clock, in milliseconds)
+  long long    DeadlineMs;
+} ADMIN_CLIENT;
+
+
+
+/**
+ * \brief HTTP endpoint exposing the metrics in the Prometheus text format
+ *
+ * The endpoint has no thread of its own : its sockets are non blocking and are
+ * polled by the main loop of the server, along with the signals. A scrape only
+ * reads the metrics (no lock is taken), and each client is served in a few
+ * calls, then closed. In prefork mode, the connections are run by the worker
+ * processes : their metrics are read from the stats page and added up.
+ */
+class ADMIN : public OBJECT
+{
+public:
+
+  /**
+   * \brief          Administration endpoint constructor
+   *
+   * \param PortNum  Port to listen on
+   * \param Stats    Stats page whose slots are added up (NULL to expose the metrics of this process)
+   */
+  ADMIN(unsigned short PortNum, const STATPAGE* Stats = NULL);
+
+
+
+  /**
+   * \brief          Administration endpoint destructor
+   */
+  virtual ~ADMIN();
+
+
+
+  /**
+   * \brief          Adds the sockets to poll
+   *
+   * \param Checkers Poll entries the ones of the endpoint are appended to
+   */
+  void AddChecks(std::vector<struct pollfd>& Checkers) const;
+
+
+
+  /**
+   * \brief          Serves the clients, according to the poll results
+   *
+   * \param Checkers Poll entries
+   * \param First    Index of the first entry of the endpoint (the listening socket)
+   */
+  void Process(const std::vector<struct pollfd>& Checkers, size_t First);
+
+
+
+  /**
+   * \brief          Writes the metrics in the Prometheus text format
+   *
+   * \param Text     Buffer the metrics are appended to
+   */
+  void Expose(std::string& Text) const;
+
+
+
+private:
+
+  /**
+   * \brief          Accepts the waiting clients
+   */
+  void AcceptClients();
+
+
+
+  /**
+   * \brief          Reads the request of a client, and prepares the reply once complete
+   *
+   * \param Client   Client
+   *
+   * \return         \b true if the client is still served
+   * \return         \b false if it has to be closed
+   */
+  bool ReadRequest(ADMIN_CLIENT& Client);
+
+
+
+  /**
+   * \brief          Sends the reply to a client
+   *
+   * \param Client   Client
+   *
+   * \return         \b true if the reply is still being sent
+   * \return         \b false if the client has to be closed
+   */
+  bool SendReply(ADMIN_CLIENT& Client);
+
+
+
+  /// Listening socket identifier
+  int                        _SocketId;
+
+  /// Clients being served
+  std::vector<ADMIN_CLIENT>  _Clients;
+
+  /// Stats page of the worker processes (NULL if the metrics are the ones of this process)
+  const STATPAGE*            _Stats;
+};
+
+
+
+#endif
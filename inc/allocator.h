@@ -0,0 +1,161 @@
+/**
+ * \file allocator.h
+ *
+ * \brief Header for unique identifiers allocation
+ *
+ * \author Olivier de BLIC
+ */
+
+
+
+#ifndef ALLOCATOR_H
+#define ALLOCATOR_H
+
+// Standard headers
+#include <stddef.h>
+#include <vector>
+#include <utility>
+
+// Project headers
+#include "object.h"
+
+
+
+/// Ranges of identifiers (first identifier and number of identifiers of each range)
+typedef std::vector< std::pair<unsigned int, unsigned int> > ID_RANGES;
+
+
+
+/**
+ * \brief Lock-free allocator of unique identifiers
+ *
+ * Identifiers are bits of a bitmap : a bit is claimed and released with atomic
+ * operations only, starting the search from a shared cursor so that successive
+ * allocations do not scan the same words again. The bitmap may be placed in a
+ * memory area provided by the caller (shared memory for instance).
+ */
+class ALLOCATOR : public OBJECT
+{
+public:
+
+  /**
+   * \brief          Allocator constructor
+   *
+   * \param Capacity Number of identifiers (rounded up to a multiple of 64)
+   * \param Memory   Memory area of GetMemorySize() bytes holding the state (allocated if NULL)
+   * \param Init     Flag telling if the state has to be initialized (always for an allocated one)
+   */
+  ALLOCATOR(unsigned int Capacity, void* Memory = NULL, bool Init = true);
+
+
+
+  /**
+   * \brief          Allocator destructor
+   */
+  virtual ~ALLOCATOR();
+
+
+
+  /**
+   * \brief          Size of the memory area needed by an allocator
+   *
+   * \param Capacity Number of identifiers
+   *
+   * \return         Size of the state (in bytes)
+   */
+  static size_t GetMemorySize(unsigned int Capacity);
+
+
+
+  /**
+   * \brief          Allocates a new identifier
+   *
+   * \return         Identifier
+   */
+  unsigned int Allocate();
+
+
+
+  /**
+   * \brief          Allocates several identifiers, as few ranges as possible
+   *
+   * \param Count    Number of identifiers
+   * \param Ranges   Allocated ranges (appended, adjacent ranges are merged)
+   */
+  void Allocate(unsigned int Count, ID_RANGES& Ranges);
+
+
+
+  /**
+   * \brief          Claims a given identifier
+   *
+   * \param Id       Identifier
+   *
+   * \return         \b true if the identifier was free and is now allocated
+   * \return         \b false if the identifier is already in use
+   */
+  bool Reserve(unsigned int Id);
+
+
+
+  /**
+   * \brief          Releases an identifier
+   *
+   * \param Id       Identifier
+   */
+  void Release(unsigned int Id);
+
+
+
+  /**
+   * \brief          Releases ranges of identifiers
+   *
+   * \param Ranges   Ranges allocated together
+   */
+  void Release(const ID_RANGES& Ranges);
+
+
+
+  /**
+   * \brief          Counts identifiers as leased, within a limit shared by all the owners
+   *
+   * \param Count    Number of identifiers
+   * \param Limit    Highest number of identifiers leased at the same time
+   *
+   * \return         \b true if the identifiers are counted
+   * \return         \b false if the limit would be exceeded (nothing is counted)
+   */
+  bool AddLeased(unsigned int Count, unsigned int Limit);
+
+
+
+  /**
+   * \brief          Stops counting identifiers as leased
+   *
+   * \param Count    Number of identifiers
+   */
+  void RemoveLeased(unsigned int Count);
+
+
+
+private:
+
+  /// Number of 64 bits words of the bitmap
+  unsigned int                 _WordCount;
+
+  /// Index of the word where the next search starts (shared with the bitmap owners)
+  volatile unsigned int*       _Cursor;
+
+  /// Number of identifiers leased (shared with the bitmap owners)
+  volatile unsigned int*       _Leased;
+
+  /// Bitmap of allocated identifiers
+  volatile unsigned long long* _Words;
+
+  /// Memory area allocated by the object (NULL if provided)
+  void*                        _Owned;
+};
+
+
+
+#endif
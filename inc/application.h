@@ -12,6 +12,7 @@
 #define APPLICATION_H
 
 // Standard headers
+#include <vector>
 
 // Project headers
 #include "object.h"
@@ -21,6 +22,15 @@
 
 
 
+// Forward declarations
+class ACCEPTOR;
+class UPGRADE;
+class WORKERS;
+class PUBLISHER;
+class STATPAGE;
+
+
+
 /**
  * \brief Running program and all its components as subobjects
  */
@@ -91,7 +101,48 @@ private:
 
 
   /**
-   * \brief         Signal management function
+   * \brief          Worker process function (prefork mode)
+   */
+  void RunWorker();
+
+
+
+  /**
+   * \brief          Hands the listening sockets and the connections over to a new process
+   *
+   * \param Upgrade    Upgrade socket the new process has connected to
+   * \param Acceptors  Acceptors of the server
+   *
+   * \return         \b true if the new process has taken the sockets over
+   * \return         \b false if the handover has failed (the server then stops as usual)
+   */
+  bool HandOver(UPGRADE& Upgrade, std::vector<ACCEPTOR*>& Acceptors);
+
+
+
+  /**
+   * \brief         Processes the signals received
+   */
+  void ProcessSignals();
+
+
+
+  /**
+   * \brief         Reload request (on SIGHUP)
+   */
+  void Reload();
+
+
+
+  /**
+   * \brief         Logs the metrics of the process (at its end)
+   */
+  void LogMetrics();
+
+
+
+  /**
+   * \brief         Signal management function (fatal signals only)
    *
    * \param         SigNum Signal occured
    */
@@ -107,7 +158,19 @@ private:
 
 
   /// Flag for state of appplication
-  bool _Running;
+  bool       _Running;
+
+  /// Descriptor the stop and reload signals are read from
+  int        _SignalId;
+
+  /// Pool of worker processes (NULL if connections are run by the current process)
+  WORKERS*   _Workers;
+
+  /// Page publishing the server state to local clients (NULL if not published)
+  PUBLISHER* _Publisher;
+
+  /// Page mirroring the metrics to local readers (NULL if not mirrored)
+  STATPAGE*  _Stats;
 };
 
 
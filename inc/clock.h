@@ -0,0 +1,129 @@
+/**
+ * \file clock.h
+ *
+ * \brief Header for time sources
+ *
+ * \author Olivier de BLIC
+ */
+
+
+
+#ifndef CLOCK_H
+#define CLOCK_H
+
+// Standard headers
+
+// Project headers
+
+
+
+/**
+ * \brief Time sources shared by the timers, the timeouts and the logs
+ *
+ * Two kinds of clocks are given, from the cheapest to the most precise :
+ * \li a low resolution clock, the coarse clock of the kernel updated by its
+ *     timer interrupt (read without entering the kernel, a few ms resolution)
+ * \li a high resolution clock, either the one of the kernel or the time stamp
+ *     counter of the processor once calibrated against it (invariant TSC only)
+ */
+class CLOCK
+{
+public:
+
+  /**
+   * \brief          Calibrates the time stamp counter, used then by the high resolution clock
+   *
+   * \return         \b true if the counter is used
+   * \return         \b false if the processor has no invariant counter (the kernel clock is kept)
+   */
+  static bool EnableTsc();
+
+
+
+  /**
+   * \brief          Tells if the high resolution clock reads the time stamp counter
+   *
+   * \return         \b true if the calibrated counter is used
+   * \return         \b false if the kernel clock is used
+   */
+  static bool IsTscEnabled();
+
+
+
+  /**
+   * \brief          High resolution monotonic time
+   *
+   * \return         Monotonic time (in nanoseconds)
+   */
+  static long long GetMonotonicNs();
+
+
+
+  /**
+   * \brief          High resolution monotonic time
+   *
+   * \return         Monotonic time (in milliseconds)
+   */
+  static long long GetMonotonicMs();
+
+
+
+  /**
+   * \brief          High resolution wall clock time
+   *
+   * \return         Time since the epoch (in nanoseconds)
+   */
+  static long long GetRealtimeNs();
+
+
+
+  /**
+   * \brief          Low resolution monotonic time (updated by the timer interrupt)
+   *
+   * \return         Monotonic time (in milliseconds, a few ms late at most)
+   */
+  static long long GetCoarseMs();
+
+
+
+private:
+
+  /**
+   * \brief          Reads the time stamp counter
+   *
+   * \return         Number of cycles of the counter
+   */
+  static unsigned long long ReadTsc();
+
+
+
+  /**
+   * \brief          Conversion of counter cycles to nanoseconds
+   *
+   * \param Cycles   Number of cycles since the calibration
+   *
+   * \return         Number of nanoseconds
+   */
+  static long long CyclesToNs(unsigned long long Cycles);
+
+
+
+  /// Flag telling if the time stamp counter is used
+  static bool                _TscEnabled;
+
+  /// Counter value at the calibration
+  static unsigned long long  _TscBase;
+
+  /// Monotonic time at the calibration (in nanoseconds)
+  static long long           _MonotonicBase;
+
+  /// Wall clock time at the calibration (in nanoseconds)
+  static long long           _RealtimeBase;
+
+  /// Nanoseconds per cycle (fixed point, 32 bits of fraction)
+  static unsigned long long  _NsPerCycle;
+};
+
+
+
+#endif
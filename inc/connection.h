@@ -12,12 +12,14 @@
 #define CONNECTION_H
 
 // Standard headers
+#include <string>
 
 // Project headers
 #include "object.h"
 #include "manager.h"
 #include "socket.h"
 #include "thread.h"
+#include "scheduler.h"
 
 
 
@@ -31,6 +33,8 @@ class MANAGER;
  */
 class CONNECTION : public OBJECT
 {
+  friend class MANAGER;
+
 public:
 
   /**
@@ -38,9 +42,13 @@ public:
    *
    * \param Manager  Reference to the owner manager
    * \param Socket   Reference to the opened socket
+   * \param Namespace Identifiers namespace
    * \param HostID   Host identifier
+   * \param Token    Session token (0 if sessions are disabled)
+   * \param RateMs   Interval between two ID sendings (in milliseconds)
+   * \param DelayMs  Time before the first ID sending (in milliseconds)
    */
-  CONNECTION(MANAGER& Manager, SOCKET& Socket, int HostID);
+  CONNECTION(MANAGER& Manager, SOCKET& Socket, int Namespace, int HostID, unsigned long long Token = 0, int RateMs = 0, int DelayMs = 0);
 
 
 
@@ -51,6 +59,13 @@ public:
 
 
 
+  /**
+   * \brief          Starts the thread of the connection (once the manager knows it)
+   */
+  void Start();
+
+
+
   /**
    * \brief          Getter for host identifier
    *
@@ -60,6 +75,51 @@ public:
 
 
 
+  /**
+   * \brief          Getter for the identifiers namespace
+   *
+   * \return         Namespace of the host identifier (endpoint the client connected to)
+   */
+  int GetNamespace() const;
+
+
+
+  /**
+   * \brief          Getter for the session token
+   *
+   * \return         Token the client presents to resume its session (0 if sessions are disabled)
+   */
+  unsigned long long GetToken() const;
+
+
+
+  /**
+   * \brief          Getter for socket identifier
+   *
+   * \return         Socket identifier
+   */
+  int GetSocketId() const;
+
+
+
+  /**
+   * \brief          Getter for the tick interval
+   *
+   * \return         Interval between two ID sendings (in milliseconds)
+   */
+  int GetRate() const;
+
+
+
+  /**
+   * \brief          Getter for the tick phase
+   *
+   * \return         Time left before the next ID sending (in milliseconds)
+   */
+  int GetTickDelay() const;
+
+
+
 private:
 
   /**
@@ -73,13 +133,95 @@ private:
 
 
 
+  /**
+   * \brief          Processing of a command line received from the client
+   *
+   * \param  Line    Received line (without the new line character)
+   */
+  void ProcessCommand(const std::string& Line);
+
+
+
+  /**
+   * \brief          Processing of a request for several identifiers
+   *
+   * \param  Args    Arguments of the command (number of identifiers, then optionally BIN)
+   *
+   * \return         Reply to send
+   */
+  std::string ProcessGet(const std::string& Args);
+
+
+
+  /**
+   * \brief          Processing of a request to resume a previous session
+   *
+   * \param  Args    Arguments of the command (token of the session)
+   *
+   * \return         Reply to send
+   */
+  std::string ProcessResume(const std::string& Args);
+
+
+
+  /**
+   * \brief          Change of the tick interval
+   *
+   * \param  RateMs  Requested tick interval (in milliseconds, any value a client may send)
+   *
+   * \return         Applied tick interval (bounded by the parameters)
+   */
+  int SetRate(long RateMs);
+
+
+
   // Size by default of I/O buffer ?
 
-  const int  _HostId;
+  /// Identifiers namespace (endpoint the client connected to)
+  const int  _Namespace;
+
+  /// Host identifier (the one of the session once resumed)
+  int        _HostId;
+
+  /// Session token (0 if sessions are disabled)
+  unsigned long long _Token;
+
+  /// Flag telling if the token has been sent to the client (by the previous process for an adopted one)
+  bool       _TokenSent;
+
+  /// Number of count replies sent for the data being processed (their latency is recorded after the flush)
+  int        _CountReplies;
+
+  /// Interval between two ID sendings (in milliseconds)
+  int        _RateMs;
+
+  /// Monotonic time of the last ID sending (in milliseconds)
+  long long  _LastTickMs;
+
+  /// Monotonic time of the next ID sending (in milliseconds)
+  long long  _NextTickMs;
+
+  /// Received data not terminated yet by a new line character
+  std::string _Pending;
 
   MANAGER&   _Manager;
   SOCKET&    _Socket;
   THREAD&    _Thread;
+
+  /// Scheduler of the sendings to the socket
+  SCHEDULER  _Scheduler;
+
+  /// Flag telling if the client is still connected (cleared on hangup or error)
+  bool       _Connected;
+
+  /// Identifiers leased by the GET commands (released by the RELEASE command or on disconnection)
+  ID_RANGES  _Lease;
+
+  /// Number of identifiers leased
+  unsigned int _LeaseCount;
+
+  /// Flag telling if the thread has given the connection up to a shutdown or a handover (set under the lock of the manager)
+  bool       _Stopped;
 };
 
 
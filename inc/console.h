@@ -15,15 +15,56 @@
 #include <pthread.h>
 #include <string>
 #include <sstream>
+#include <vector>
 
 // Project headers
 #include "exception.h"
+#include "logsite.h"
+#include "loglimit.h"
+#include "logformat.h"
+
+// Forward declarations (needed because of cross-references)
+class LOGRING;
+class LOGFILE;
+class THREAD;
 
 // Source line reference format
 #define SSTR(NB)                  #NB
 #define STR(MSG)                  SSTR(MSG)
 #define SOURCE_LINE               __FILE__ ":" STR(__LINE__)
 
+// Maximal size of a log record (longer arguments are truncated)
+#define LOG_RECORD_MAX            (512)
+#define LOG_STAMP_MAX             (32)
+
+// Lowest type of log compiled in (lower ones are removed by the compiler, see LOG_MIN in the Makefile)
+#ifndef LOG_MIN_TYPE
+#define LOG_MIN_TYPE              LOG_CTOR
+#endif
+
+// Log with deferred formatting : the call site is registered once, the arguments are stored raw
+// (and only evaluated if the log is written)
+#define LOG_LINE(TYPE, FORMAT, ...) \
+  do { if((TYPE) >= LOG_MIN_TYPE && App().Console.IsLogged(TYPE)) \
+  { static const LOGSITE LogSite(TYPE, FORMAT, SOURCE_LINE); App().Console.Log(LogSite, ##__VA_ARGS__); } } while(0)
+
+// Limits of the logs written for each client (lines per second, burst, sampling)
+#define LOG_HOT_RATE              (10)
+#define LOG_HOT_BURST             (20)
+#define LOG_HOT_SAMPLE            (100)
+
+// Log on a hot path, limited to RATE lines per second (BURST at once), the others being counted and summarized
+#define LOG_LINE_RATE(TYPE, RATE, BURST, FORMAT, ...) \
+  do { if((TYPE) >= LOG_MIN_TYPE && App().Console.IsLogged(TYPE)) \
+  { static const LOGSITE LogSite(TYPE, FORMAT, SOURCE_LINE); static LOGLIMIT LogLimit(LogSite, RATE, BURST, 1); \
+    if(App().Console.Admit(LogLimit)) { App().Console.Log(LogSite, ##__VA_ARGS__); } } } while(0)
+
+// Log on a hot path, sampled : one line out of EVERY is written, the others being counted and summarized
+#define LOG_LINE_SAMPLE(TYPE, EVERY, FORMAT, ...) \
+  do { if((TYPE) >= LOG_MIN_TYPE && App().Console.IsLogged(TYPE)) \
+  { static const LOGSITE LogSite(TYPE, FORMAT, SOURCE_LINE); static LOGLIMIT LogLimit(LogSite, 0, 0, EVERY); \
+    if(App().Console.Admit(LogLimit)) { App().Console.Log(LogSite, ##__VA_ARGS__); } } } while(0)
+
 
 
 /// Enumeration of log types
@@ -38,12 +79,17 @@ typedef enum
   LOG_ERROR,
   LOG_EXCEPT,
   LOG_SIGNAL,
+  LOG_TYPE_COUNT,
 } LOG_TYPE;
 
 
 
 /**
  * \brief Interface for console output and formated logs
+ *
+ * Once started, log lines are not written by the threads logging them : each
+ * thread queues its lines in its own ring, without any lock, and a writer
+ * thread gathers the lines of all the rings and writes them by batches.
  */
 class CONSOLE
 {
@@ -90,6 +136,58 @@ public:
 
 
 
+  /**
+   * \brief          Writes the logs to a binary file, formatted only when decoded
+   *
+   * \param Path     Path of the binary log (appended if it already exists)
+   */
+  void SetBinary(const std::string& Path);
+
+
+
+  /**
+   * \brief          Writes the log lines to a memory mapped file instead of the standard output
+   *
+   * \param Path     Path of the log file (an existing one is renamed first)
+   * \param SegmentBytes Size of the file before rotation (in bytes)
+   * \param PeriodSec Age of the file before rotation (in seconds, 0 for no limit)
+   */
+  void SetFile(const std::string& Path, size_t SegmentBytes, int PeriodSec);
+
+
+
+  /**
+   * \brief          Starts a new log file at the next line (if lines are written to a file)
+   */
+  void Rotate();
+
+
+
+  /**
+   * \brief          Starts writing the log lines asynchronously
+   *
+   * \note           Threads do not survive a fork : it is called by each process, once the worker processes are forked.
+   */
+  void Start();
+
+
+
+  /**
+   * \brief          Writes the queued log lines and goes back to synchronous writes
+   */
+  void Stop();
+
+
+
+  /**
+   * \brief          Gives the writer a bounded time to write the queued lines, on a fatal signal
+   *
+   * \note           Nothing is joined and no lock is waited for : the crashed thread may hold one.
+   */
+  void Abandon();
+
+
+
 #ifdef DEBUG
   /**
    * \brief            Text log (debug only)
@@ -154,6 +252,30 @@ public:
 
 
 
+  /**
+   * \brief            Tells if the logs of a type are written
+   *
+   * \param Type       Type of log
+   *
+   * \return           \b true if the log has to be written
+   * \return           \b false if its type is filtered out (verbose mode off)
+   */
+  bool IsLogged(LOG_TYPE Type) const;
+
+
+
+  /**
+   * \brief            Tells if a limited log is written (use the LOG_LINE_RATE and LOG_LINE_SAMPLE macros)
+   *
+   * \param Limit      Limit of the call site
+   *
+   * \return           \b true if the log has to be written
+   * \return           \b false if it is suppressed (counted for the summary)
+   */
+  bool Admit(LOGLIMIT& Limit);
+
+
+
   /**
    * \brief            Blank log
    */
@@ -167,7 +289,7 @@ public:
    * \param Msg        Information message
    * \param Source     Source line from where the function is call
    */
-  void LogInfo(std::string Msg, std::string Source = "");
+  void LogInfo(const std::string& Msg, const std::string& Source = "");
 
 
 
@@ -177,7 +299,7 @@ public:
    * \param Msg        Warning message
    * \param Source     Source line from where the function is call
    */
-  void LogWarn(std::string Msg, std::string Source = "");
+  void LogWarn(const std::string& Msg, const std::string& Source = "");
 
 
 
@@ -187,7 +309,7 @@ public:
    * \param Msg        Error message
    * \param Source     Source line from where the function is call
    */
-  void LogError(std::string Msg, std::string Source = "");
+  void LogError(const std::string& Msg, const std::string& Source = "");
 
 
 
@@ -235,8 +357,175 @@ public:
 
 
 
+  /**
+   * \brief            Log with deferred formatting (use the LOG_LINE macro)
+   *
+   * \param Site       Call site of the log
+   * \param Arg1       First argument
+   * \param Arg2       Second argument
+   * \param Arg3       Third argument
+   * \param Arg4       Fourth argument
+   */
+  void Log(const LOGSITE& Site);
+
+  template<typename A>
+  void Log(const LOGSITE& Site, const A& Arg1);
+
+  template<typename A, typename B>
+  void Log(const LOGSITE& Site, const A& Arg1, const B& Arg2);
+
+  template<typename A, typename B, typename C>
+  void Log(const LOGSITE& Site, const A& Arg1, const B& Arg2, const C& Arg3);
+
+  template<typename A, typename B, typename C, typename D>
+  void Log(const LOGSITE& Site, const A& Arg1, const B& Arg2, const C& Arg3, const D& Arg4);
+
+
+
 private:
 
+  /**
+   * \brief            Formatting of a log line
+   *
+   * \param Type       Type of log
+   * \param LogData    Text of the log
+   * \param Source     Source line from where the function is call
+   *
+   * \return           Formatted line
+   */
+  std::string FormatLogLine(LOG_TYPE Type, const std::string& LogData, std::string Source);
+
+
+
+  /**
+   * \brief            Output of a formatted line (queued if the writer is running)
+   *
+   * \param Line       Formatted line
+   */
+  void Emit(const std::string& Line);
+
+
+
+  /**
+   * \brief            Output of an encoded record or of a formatted line
+   *
+   * \param Data       Bytes of the record or of the line
+   * \param Length     Number of bytes
+   */
+  void Emit(const char* Data, size_t Length);
+
+
+
+  /**
+   * \brief            Tells if the logs of a call site are written
+   *
+   * \param Site       Call site of the log
+   *
+   * \return           \b true if the log has to be written
+   * \return           \b false if its type is filtered out
+   */
+  bool IsEnabled(const LOGSITE& Site) const;
+
+
+
+  /**
+   * \brief            Output of a log with deferred formatting
+   *
+   * \param Site       Call site of the log
+   * \param Record     Record, its arguments following LOG_RECORD_HEADER bytes left for its header
+   * \param Length     Length of the record
+   */
+  void Write(const LOGSITE& Site, char* Record, size_t Length);
+
+
+
+  /**
+   * \brief            Adds a text to a batch, as a line or as a binary record
+   *
+   * \param Batch      Buffer the text is appended to
+   * \param Type       Type of log
+   * \param Text       Text of the log
+   */
+  void AppendText(std::string& Batch, LOG_TYPE Type, const std::string& Text);
+
+
+
+  /**
+   * \brief            Writes a batch of lines or of records to the output
+   *
+   * \param Batch      Lines or records (cleared)
+   */
+  void Output(std::string& Batch);
+
+
+
+  /**
+   * \brief            Getter for the ring of the calling thread
+   *
+   * \return           Ring of the thread (taken from the free rings or created on its first log)
+   */
+  LOGRING& GetRing();
+
+
+
+  /**
+   * \brief            Gives up the ring of an ending thread
+   *
+   * \param Ring       Ring of the thread
+   */
+  static void ReleaseRing(void* Ring);
+
+
+
+  /**
+   * \brief            Task of the writer thread
+   *
+   * \param Arg        Pointer to the console
+   *
+   * \return           NULL
+   */
+  static void* RunWriter(void* Arg);
+
+
+
+  /**
+   * \brief            Writes the lines queued in all the rings
+   *
+   * \param Batch      Buffer for the lines (cleared)
+   *
+   * \return           Number of lines written
+   */
+  size_t Drain(std::string& Batch);
+
+
+
+  /**
+   * \brief            Asks for the lines written to the log file to be written back to the disk
+   */
+  void Flush();
+
+
+
+  /**
+   * \brief            Adds the summaries of the suppressed lines of all the limited call sites
+   *
+   * \param Batch      Buffer the summaries are appended to
+   */
+  void Summarize(std::string& Batch);
+
+
+
+  /**
+   * \brief            Adds the summary of the suppressed lines of a call site
+   *
+   * \param Batch      Buffer the summary is appended to
+   * \param Limit      Limit of the call site
+   * \param Count      Number of suppressed lines
+   */
+  void AppendSummary(std::string& Batch, const LOGLIMIT& Limit, unsigned long Count);
+
+
+
   /**
    * \brief            Begin of a new log operation
    */
@@ -373,8 +662,198 @@ private:
 
   /// Stream for log line printing
   std::ostream&       _Stream;
+
+  /// Key of the ring of each thread
+  pthread_key_t       _RingKey;
+
+  /// Mutex protecting the lists of rings (taken on the first log of a thread, and by the writer)
+  pthread_mutex_t     _RingsLock;
+
+  /// Rings of the threads
+  std::vector<LOGRING*> _Rings;
+
+  /// Rings of ended threads, waiting for new threads
+  std::vector<LOGRING*> _FreeRings;
+
+  /// Writer thread (NULL if lines are written synchronously)
+  THREAD*             _Writer;
+
+  /// Flag telling if lines are queued for the writer
+  volatile bool       _Async;
+
+  /// Flag telling if the writer has to keep running
+  volatile bool       _Running;
+
+  /// Flag telling if the writer has written the lines queued before its stop
+  volatile bool       _Drained;
+
+  /// Flag telling if a fatal signal has occurred (the output lock is only tried)
+  volatile bool       _Abandoned;
+
+  /// Number of dropped lines already reported
+  unsigned long       _Dropped;
+
+  /// Time of the next summary of the suppressed lines (coarse clock, in milliseconds)
+  long long           _SummaryMs;
+
+  /// Time of the next flush of the log file (coarse clock, in milliseconds)
+  long long           _FlushMs;
+
+  /// Log file (NULL if lines are written to the stream)
+  LOGFILE*            _File;
+
+  /// Path of the log file
+  std::string         _FilePath;
+
+  /// Size of the log file before rotation
+  size_t              _FileSegment;
+
+  /// Age of the log file before rotation (in seconds)
+  int                 _FilePeriod;
+
+  /// Binary log file (-1 if lines are written to the stream)
+  int                 _BinaryId;
+
+  /// Process the call sites have been described for
+  int                 _SitesPid;
+
+  /// Number of call sites already described in the binary log
+  unsigned int        _SitesWritten;
+
+  /// Call sites of the logs given as text
+  const LOGSITE*      _TextSites[LOG_TYPE_COUNT];
+
+  /// Second of the timestamp prefix cached by each thread
+  static __thread long _StampSecond;
+
+  /// Timestamp prefix ("T:<seconds>.") cached by each thread
+  static __thread char _StampPrefix[LOG_STAMP_MAX];
+
+  /// Length of the cached timestamp prefix
+  static __thread int  _StampLength;
 };
 
 
 
+/**
+ * \brief            Log with deferred formatting (use the LOG_LINE macro)
+ *
+ * \param Site       Call site of the log
+ * \param Arg1       First argument
+ */
+template<typename A>
+void CONSOLE::Log(const LOGSITE& Site, const A& Arg1)
+{
+  if(IsEnabled(Site))
+  {
+    char Record[LOG_RECORD_MAX];
+
+    size_t Length = LOG_RECORD_HEADER;
+
+    Length += LOGFORMAT::PutArg(Record + Length, sizeof(Record) - Length, Arg1);
+
+    Write(Site, Record, Length);
+  }
+}
+
+
+
+/**
+ * \brief            Log with deferred formatting (use the LOG_LINE macro)
+ *
+ * \param Site       Call site of the log
+ * \param Arg1       First argument
+ * \param Arg2       Second argument
+ */
+template<typename A, typename B>
+void CONSOLE::Log(const LOGSITE& Site, const A& Arg1, const B& Arg2)
+{
+  if(IsEnabled(Site))
+  {
+    char Record[LOG_RECORD_MAX];
+
+    size_t Length = LOG_RECORD_HEADER;
+
+    Length += LOGFORMAT::PutArg(Record + Length, sizeof(Record) - Length, Arg1);
+    Length += LOGFORMAT::PutArg(Record + Length, sizeof(Record) - Length, Arg2);
+
+    Write(Site, Record, Length);
+  }
+}
+
+
+
+/**
+ * \brief            Log with deferred formatting (use the LOG_LINE macro)
+ *
+ * \param Site       Call site of the log
+ * \param Arg1       First argument
+ * \param Arg2       Second argument
+ * \param Arg3       Third argument
+ */
+template<typename A, typename B, typename C>
+void CONSOLE::Log(const LOGSITE& Site, const A& Arg1, const B& Arg2, const C& Arg3)
+{
+  if(IsEnabled(Site))
+  {
+    char Record[LOG_RECORD_MAX];
+
+    size_t Length = LOG_RECORD_HEADER;
+
+    Length += LOGFORMAT::PutArg(Record + Length, sizeof(Record) - Length, Arg1);
+    Length += LOGFORMAT::PutArg(Record + Length, sizeof(Record) - Length, Arg2);
+    Length += LOGFORMAT::PutArg(Record + Length, sizeof(Record) - Length, Arg3);
+
+    Write(Site, Record, Length);
+  }
+}
+
+
+
+/**
+ * \brief            Log with deferred formatting (use the LOG_LINE macro)
+ *
+ * \param Site       Call site of the log
+ * \param Arg1       First argument
+ * \param Arg2       Second argument
+ * \param Arg3       Third argument
+ * \param Arg4       Fourth argument
+ */
+template<typename A, typename B, typename C, typename D>
+void CONSOLE::Log(const LOGSITE& Site, const A& Arg1, const B& Arg2, const C& Arg3, const D& Arg4)
+{
+  if(IsEnabled(Site))
+  {
+    char Record[LOG_RECORD_MAX];
+
+    size_t Length = LOG_RECORD_HEADER;
+
+    Length += LOGFORMAT::PutArg(Record + Length, sizeof(Record) - Length, Arg1);
+    Length += LOGFORMAT::PutArg(Record + Length, sizeof(Record) - Length, Arg2);
+    Length += LOGFORMAT::PutArg(Record + Length, sizeof(Record) - Length, Arg3);
+    Length += LOGFORMAT::PutArg(Record + Length, sizeof(Record) - Length, Arg4);
+
+    Write(Site, Record, Length);
+  }
+}
+
+
+
+/**
+ * \brief            Tells if the logs of a type are written
+ *
+ * \param Type       Type of log
+ *
+ * \return           \b true if the log has to be written
+ * \return           \b false if its type is filtered out (verbose mode off)
+ *
+ * \note             Inlined at each call site : a disabled log costs a single, well predicted, branch.
+ */
+inline bool CONSOLE::IsLogged(LOG_TYPE Type) const
+{
+  return (Type != LOG_INFO || _Verbose);
+}
+
+
+
 #endif
@@ -0,0 +1,144 @@
+/**
+ * \file histogram.h
+ *
+ * \brief Header for latency histograms
+ *
+ * \author Olivier de BLIC
+ */
+
+
+
+#ifndef HISTOGRAM_H
+#define HISTOGRAM_H
+
+// Standard headers
+
+// Project headers
+
+// Layout of the histograms
+#define HISTOGRAM_SUB_BITS        (5)
+#define HISTOGRAM_BUCKETS         (1024)
+#define HISTOGRAM_SHARDS          (16)
+
+
+
+/// Values of a histogram merged from all its shards
+typedef struct
+{
+  /// Number of values recorded in each bucket
+  unsigned long long  Counts[HISTOGRAM_BUCKETS];
+
+  /// Number of values recorded
+  unsigned long long  Count;
+
+  /// Sum of the values recorded
+  unsigned long long  Sum;
+
+  /// Highest value recorded
+  unsigned long long  Max;
+} HISTOGRAM_DATA;
+
+
+
+/**
+ * \brief Histogram of durations, with a fixed memory and a bounded relative error
+ *
+ * Values are counted in log-linear buckets : 2^HISTOGRAM_SUB_BITS buckets per
+ * power of two, so that a value is known within 1/32 of itself (exact below
+ * 64), up to 2^36. Threads record to one of several shards (each on its own
+ * cache lines) without any lock, and readers merge them.
+ */
+class HISTOGRAM
+{
+public:
+
+  /**
+   * \brief          Histogram constructor
+   */
+  HISTOGRAM();
+
+
+
+  /**
+   * \brief          Records a value
+   *
+   * \param Value    Value to record (higher values are counted in the last bucket)
+   */
+  void Record(unsigned long long Value);
+
+
+
+  /**
+   * \brief          Merges the shards of the histogram
+   *
+   * \param Data     Merged values (cleared first)
+   */
+  void Merge(HISTOGRAM_DATA& Data) const;
+
+
+
+  /**
+   * \brief          Value below which a part of the values are
+   *
+   * \param Data     Merged values
+   * \param Quantile Part of the values (from 0 to 1)
+   *
+   * \return         Highest value of the bucket of the quantile (0 if there is no value)
+   */
+  static unsigned long long GetPercentile(const HISTOGRAM_DATA& Data, double Quantile);
+
+
+
+private:
+
+  /**
+   * \brief          Bucket of a value
+   *
+   * \param Value    Value
+   *
+   * \return         Index of its bucket
+   */
+  static unsigned int GetBucket(unsigned long long Value);
+
+
+
+  /**
+   * \brief          Lowest value of a bucket
+   *
+   * \param Bucket   Index of the bucket
+   *
+   * \return         Lowest value counted in the bucket
+   */
+  static unsigned long long GetLowest(unsigned int Bucket);
+
+
+
+  /// Values recorded by a part of the threads
+  struct SHARD
+  {
+    /// Number of values recorded in each bucket
+    volatile unsigned long long  Counts[HISTOGRAM_BUCKETS];
+
+    /// Number of values recorded
+    volatile unsigned long long  Count;
+
+    /// Sum of the values recorded
+    volatile unsigned long long  Sum;
+
+    /// Highest value recorded
+    volatile unsigned long long  Max;
+  } __attribute__((aligned(64)));
+
+  /// Shards of the histogram
+  SHARD                 _Shards[HISTOGRAM_SHARDS];
+
+  /// Shard of each thread (-1 until its first record)
+  static __thread int   _Shard;
+
+  /// Number of threads given a shard
+  static volatile unsigned int _Threads;
+};
+
+
+
+#endif
@@ -0,0 +1,158 @@
+/**
+ * \file logfile.h
+ *
+ * \brief Header for the memory mapped log file
+ *
+ * \author Olivier de BLIC
+ */
+
+
+
+#ifndef LOGFILE_H
+#define LOGFILE_H
+
+// Standard headers
+#include <stddef.h>
+#include <string>
+
+// Project headers
+
+
+
+/**
+ * \brief Log file written through a memory mapped segment
+ *
+ * The file is allocated to the size of a segment and mapped at once : lines are
+ * copied to the mapping, without any system call, and the kernel writes the
+ * pages back (asked for by Flush(), without waiting). When the segment is full
+ * or too old, the file is renamed with a time stamp and cut to its used length,
+ * then a new segment is started under the original name.
+ */
+class LOGFILE
+{
+public:
+
+  /**
+   * \brief          Log file constructor (an existing file is rotated first)
+   *
+   * \param Path     Path of the log file
+   * \param SegmentBytes Size of a segment (in bytes)
+   * \param PeriodSec Maximal age of a segment (in seconds, 0 for no limit)
+   */
+  LOGFILE(const std::string& Path, size_t SegmentBytes, int PeriodSec);
+
+
+
+  /**
+   * \brief          Log file destructor (the file is cut to its used length)
+   */
+  ~LOGFILE();
+
+
+
+  /**
+   * \brief          Appends data to the segment, rotating it if needed
+   *
+   * \param Data     Data to append
+   * \param Length   Length of the data
+   *
+   * \return         \b true if the data is written
+   * \return         \b false if no segment could be opened (the data is not written)
+   */
+  bool Append(const char* Data, size_t Length);
+
+
+
+  /**
+   * \brief          Asks the kernel to write the modified pages back (without waiting)
+   */
+  void Flush();
+
+
+
+  /**
+   * \brief          Starts a new segment at the next append
+   */
+  void Rotate();
+
+
+
+  /**
+   * \brief          Gives the segment up without cutting the file (mapping inherited from the parent process)
+   */
+  void Abandon();
+
+
+
+  /**
+   * \brief          Getter for the process which has opened the file
+   *
+   * \return         Process identifier
+   */
+  int GetPid() const;
+
+
+
+private:
+
+  /**
+   * \brief          Opens and maps a new segment
+   *
+   * \return         \b true if the segment is mapped
+   * \return         \b false if the file could not be created or mapped
+   */
+  bool Open();
+
+
+
+  /**
+   * \brief          Unmaps the segment and cuts the file to its used length
+   */
+  void Close();
+
+
+
+  /**
+   * \brief          Renames the file of the segment with a time stamp (unless another process has already)
+   */
+  void Archive();
+
+
+
+  /// Path of the log file
+  const std::string  _Path;
+
+  /// Size of a segment
+  const size_t       _SegmentBytes;
+
+  /// Maximal age of a segment (in milliseconds, 0 for no limit)
+  const long long    _PeriodMs;
+
+  /// Process which has opened the file
+  const int          _Pid;
+
+  /// File of the segment (-1 if none)
+  int                _FileId;
+
+  /// Mapping of the segment
+  char*              _Map;
+
+  /// Number of bytes used in the segment
+  size_t             _Used;
+
+  /// Number of bytes already given to the kernel to write back
+  size_t             _Flushed;
+
+  /// Time the segment has been opened (coarse clock, in milliseconds)
+  long long          _OpenedMs;
+
+  /// Flag requesting a new segment at the next append
+  volatile bool      _Rotate;
+
+  /// Number of segments archived by the process (distinguishes the names within a second)
+  unsigned int       _Archived;
+};
+
+
+
+#endif
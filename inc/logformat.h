@@ -0,0 +1,148 @@
+/**
+ * \file logformat.h
+ *
+ * \brief Header for binary log encoding
+ *
+ * \author Olivier de BLIC
+ */
+
+
+
+#ifndef LOGFORMAT_H
+#define LOGFORMAT_H
+
+// Standard headers
+#include <stddef.h>
+#include <string>
+
+// Project headers
+
+// Layout of the binary log
+#define LOG_FILE_MAGIC            "SSLOG\0\0\1"
+#define LOG_FILE_MAGIC_LENGTH     (8)
+#define LOG_CHUNK                 'C'
+#define LOG_CHUNK_HEADER          (1 + 4 + 4)
+#define LOG_SITE                  'D'
+#define LOG_RECORD                'L'
+#define LOG_RECORD_HEADER         (1 + 4 + 8 + 2)
+#define LOG_ARG_SIGNED            'i'
+#define LOG_ARG_UNSIGNED          'u'
+#define LOG_ARG_STRING            's'
+
+
+
+/**
+ * \brief Encoding and rendering of the binary log
+ *
+ * A binary log starts with a magic number, then holds chunks, each of them
+ * written at once by a process : 'C', process identifier, length, content.
+ * The content is made of call site definitions ('D', identifier, log type,
+ * format, source line) and of records ('L', site identifier, time in ns,
+ * length of the arguments, arguments). Each argument is tagged with its type,
+ * so that records are rendered with the format of their site only when read.
+ * Values are in the byte order of the host.
+ */
+class LOGFORMAT
+{
+public:
+
+  /**
+   * \brief          Encoding of an argument
+   *
+   * \param Buffer   Buffer the argument is written to
+   * \param Room     Space left in the buffer
+   * \param Value    Value of the argument
+   *
+   * \return         Number of bytes written (0 if there is no room left)
+   */
+  static size_t PutArg(char* Buffer, size_t Room, int Value);
+  static size_t PutArg(char* Buffer, size_t Room, unsigned int Value);
+  static size_t PutArg(char* Buffer, size_t Room, long Value);
+  static size_t PutArg(char* Buffer, size_t Room, unsigned long Value);
+  static size_t PutArg(char* Buffer, size_t Room, long long Value);
+  static size_t PutArg(char* Buffer, size_t Room, unsigned long long Value);
+  static size_t PutArg(char* Buffer, size_t Room, const char* Value);
+  static size_t PutArg(char* Buffer, size_t Room, const std::string& Value);
+
+
+
+  /**
+   * \brief          Encoding of the header of a record (its arguments follow it)
+   *
+   * \param Buffer   Buffer of LOG_RECORD_HEADER bytes at least
+   * \param Id       Identifier of the call site
+   * \param TimeNs   Time of the log (in nanoseconds)
+   * \param Length   Length of the arguments
+   */
+  static void PutRecord(char* Buffer, unsigned int Id, unsigned long long TimeNs, size_t Length);
+
+
+
+  /**
+   * \brief          Encoding of a call site definition
+   *
+   * \param Output   Buffer the definition is appended to
+   * \param Id       Identifier of the call site
+   * \param Type     Type of log
+   * \param Format   Format of the lines, arguments being given by '%' and a letter
+   * \param Source   Source line of the call site
+   */
+  static void AppendSite(std::string& Output, unsigned int Id, int Type, const char* Format, const char* Source);
+
+
+
+  /**
+   * \brief          Encoding of a chunk
+   *
+   * \param Output   Buffer the chunk is appended to
+   * \param Pid      Process identifier
+   * \param Content  Definitions and records of the chunk
+   */
+  static void AppendChunk(std::string& Output, unsigned int Pid, const std::string& Content);
+
+
+
+  /**
+   * \brief          Rendering of a line from its format and arguments
+   *
+   * \param Format   Format of the line
+   * \param Args     Encoded arguments
+   * \param Length   Length of the arguments
+   * \param Text     Buffer the line is appended to
+   */
+  static void Render(const char* Format, const char* Args, size_t Length, std::string& Text);
+
+
+
+private:
+
+  /**
+   * \brief          Encoding of an integer argument
+   *
+   * \param Buffer   Buffer the argument is written to
+   * \param Room     Space left in the buffer
+   * \param Tag      Type of the argument
+   * \param Value    Bits of the value
+   *
+   * \return         Number of bytes written (0 if there is no room left)
+   */
+  static size_t PutInteger(char* Buffer, size_t Room, char Tag, unsigned long long Value);
+
+
+
+  /**
+   * \brief          Encoding of a string argument
+   *
+   * \param Buffer   Buffer the argument is written to
+   * \param Room     Space left in the buffer
+   * \param Value    Characters of the string
+   * \param Length   Length of the string (truncated if there is not enough room)
+   *
+   * \return         Number of bytes written (0 if there is no room left)
+   */
+  static size_t PutString(char* Buffer, size_t Room, const char* Value, size_t Length);
+};
+
+
+
+#endif
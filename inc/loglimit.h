@@ -0,0 +1,128 @@
+/**
+ * \file loglimit.h
+ *
+ * \brief Header for log call sites limiting
+ *
+ * \author Olivier de BLIC
+ */
+
+
+
+#ifndef LOGLIMIT_H
+#define LOGLIMIT_H
+
+// Standard headers
+
+// Project headers
+#include "logsite.h"
+
+// Constant values
+#define LOG_LIMIT_MAX             (LOG_SITE_MAX)
+
+
+
+/**
+ * \brief Limit of the lines written by a call site on a hot path
+ *
+ * A limit either lets a given number of lines per second through (token bucket
+ * allowing a burst, kept as the theoretical arrival time of the next line so
+ * that a single compare and swap updates it), or one line out of N (sampling).
+ * Suppressed lines are counted, and reported as a single summary line.
+ */
+class LOGLIMIT
+{
+public:
+
+  /**
+   * \brief          Limit constructor (registers the limit)
+   *
+   * \param Site     Call site of the limited log
+   * \param Rate     Number of lines per second (0 if sampled)
+   * \param Burst    Number of lines allowed at once above the rate
+   * \param Every    One line is written out of this number (1 if rate limited)
+   */
+  LOGLIMIT(const LOGSITE& Site, int Rate, int Burst, int Every);
+
+
+
+  /**
+   * \brief          Tells if a line can be written, and counts it as suppressed if not
+   *
+   * \return         \b true if the line has to be written
+   * \return         \b false if it is suppressed
+   */
+  bool Admit();
+
+
+
+  /**
+   * \brief          Takes the number of lines suppressed since the last call
+   *
+   * \return         Number of suppressed lines (reset to 0)
+   */
+  unsigned long TakeSuppressed();
+
+
+
+  /**
+   * \brief          Getter for the call site
+   *
+   * \return         Call site of the limited log
+   */
+  const LOGSITE& GetSite() const;
+
+
+
+  /**
+   * \brief          Getter for the number of registered limits
+   *
+   * \return         Number of limits
+   */
+  static unsigned int GetCount();
+
+
+
+  /**
+   * \brief          Getter for a registered limit
+   *
+   * \param Id       Index of the limit
+   *
+   * \return         Pointer to the limit (NULL if it is still being registered)
+   */
+  static LOGLIMIT* GetLimit(unsigned int Id);
+
+
+
+private:
+
+  /// Call site of the limited log
+  const LOGSITE&          _Site;
+
+  /// Time between two lines at the given rate (in microseconds, 0 if sampled)
+  const long long         _IntervalUs;
+
+  /// Advance the arrival time may take on the current time (burst)
+  const long long         _ToleranceUs;
+
+  /// One line is written out of this number
+  const unsigned long     _Every;
+
+  /// Theoretical arrival time of the next line (in microseconds)
+  volatile long long      _ArrivalUs;
+
+  /// Number of lines given to the limit
+  volatile unsigned long  _Calls;
+
+  /// Number of lines suppressed since the last summary
+  volatile unsigned long  _Suppressed;
+
+  /// Number of registered limits
+  static volatile unsigned int _Count;
+
+  /// Registered limits
+  static LOGLIMIT* volatile _Limits[LOG_LIMIT_MAX];
+};
+
+
+
+#endif
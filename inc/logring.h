@@ -0,0 +1,152 @@
+/**
+ * \file logring.h
+ *
+ * \brief Header for log lines queuing
+ *
+ * \author Olivier de BLIC
+ */
+
+
+
+#ifndef LOGRING_H
+#define LOGRING_H
+
+// Standard headers
+#include <stddef.h>
+#include <string>
+
+// Project headers
+
+
+
+/**
+ * \brief Ring of log lines written by a single thread and read by the log writer
+ *
+ * Lines are stored as a length followed by the text, in a byte ring indexed by
+ * free-running counters : the producer only moves the tail and the consumer
+ * only moves the head, so that no lock is needed. A line that does not fit is
+ * dropped and counted, the producer never waits for the consumer.
+ */
+class LOGRING
+{
+public:
+
+  /**
+   * \brief          Ring constructor
+   *
+   * \param Capacity Size of the ring (in bytes, power of 2)
+   */
+  LOGRING(size_t Capacity);
+
+
+
+  /**
+   * \brief          Ring destructor
+   */
+  ~LOGRING();
+
+
+
+  /**
+   * \brief          Queues a line (producer side)
+   *
+   * \param Line     Text of the line
+   * \param Length   Length of the text
+   *
+   * \return         \b true if the line is queued
+   * \return         \b false if the ring is full (the line is dropped)
+   */
+  bool Push(const char* Line, size_t Length);
+
+
+
+  /**
+   * \brief          Takes all the queued lines (consumer side)
+   *
+   * \param Batch    Buffer the lines are appended to
+   *
+   * \return         Number of lines taken
+   */
+  size_t Pop(std::string& Batch);
+
+
+
+  /**
+   * \brief          Getter for the number of dropped lines (consumer side)
+   *
+   * \return         Number of lines dropped since the ring creation
+   */
+  unsigned long GetDropped() const;
+
+
+
+  /**
+   * \brief          Marks the ring as given up by its thread (it is then reused once empty)
+   */
+  void Close();
+
+
+
+  /**
+   * \brief          Tells if the ring has been given up by its thread
+   *
+   * \return         \b true if the thread has ended
+   * \return         \b false if the thread may still write lines
+   */
+  bool IsClosed() const;
+
+
+
+  /**
+   * \brief          Gives the ring to a new thread
+   */
+  void Reopen();
+
+
+
+private:
+
+  /**
+   * \brief          Copy to the ring, wrapping at its end
+   *
+   * \param Position Counter of the first byte
+   * \param Data     Data to copy
+   * \param Length   Length of the data
+   */
+  void CopyIn(unsigned long Position, const void* Data, size_t Length);
+
+
+
+  /**
+   * \brief          Copy from the ring, wrapping at its end
+   *
+   * \param Position Counter of the first byte
+   * \param Data     Buffer the data is copied to
+   * \param Length   Length of the data
+   */
+  void CopyOut(unsigned long Position, void* Data, size_t Length) const;
+
+
+
+  /// Ring storage
+  char*                   _Data;
+
+  /// Size of the ring minus one (mask of the positions)
+  const size_t            _Mask;
+
+  /// Counter of bytes written (moved by the producer only)
+  volatile unsigned long  _Tail __attribute__((aligned(64)));
+
+  /// Number of lines dropped because the ring was full (producer only)
+  volatile unsigned long  _Dropped;
+
+  /// Counter of bytes read (moved by the consumer only)
+  volatile unsigned long  _Head __attribute__((aligned(64)));
+
+  /// Flag telling if the thread writing in the ring has ended
+  volatile bool           _Closed;
+};
+
+
+
+#endif
@@ -0,0 +1,125 @@
+/**
+ * \file logsite.h
+ *
+ * \brief Header for log call sites
+ *
+ * \author Olivier de BLIC
+ */
+
+
+
+#ifndef LOGSITE_H
+#define LOGSITE_H
+
+// Standard headers
+
+// Project headers
+
+// Constant values
+#define LOG_SITE_MAX              (1024)
+
+
+
+/**
+ * \brief Call site of a log with deferred formatting
+ *
+ * Each call site is a static object holding the constant parts of its lines
+ * (type, format and source line). It is given an identifier when first run,
+ * so that a record only holds this identifier, a time and the raw arguments :
+ * lines are formatted by the reader of the log, or by the writer thread.
+ */
+class LOGSITE
+{
+public:
+
+  /**
+   * \brief          Call site constructor (registers the site)
+   *
+   * \param Type     Type of log (LOG_TYPE)
+   * \param Format   Format of the lines, arguments being given by '%' and a letter
+   * \param Source   Source line of the call site
+   */
+  LOGSITE(int Type, const char* Format, const char* Source);
+
+
+
+  /**
+   * \brief          Getter for the site identifier
+   *
+   * \return         Identifier of the site (LOG_SITE_MAX if there are too many sites)
+   */
+  unsigned int GetId() const;
+
+
+
+  /**
+   * \brief          Getter for the log type
+   *
+   * \return         Type of log (LOG_TYPE)
+   */
+  int GetType() const;
+
+
+
+  /**
+   * \brief          Getter for the format
+   *
+   * \return         Format of the lines
+   */
+  const char* GetFormat() const;
+
+
+
+  /**
+   * \brief          Getter for the source line
+   *
+   * \return         Source line of the call site
+   */
+  const char* GetSource() const;
+
+
+
+  /**
+   * \brief          Getter for the number of registered sites
+   *
+   * \return         Number of sites (their identifiers are below it)
+   */
+  static unsigned int GetCount();
+
+
+
+  /**
+   * \brief          Getter for a registered site
+   *
+   * \param Id       Identifier of the site
+   *
+   * \return         Pointer to the site (NULL if it is still being registered)
+   */
+  static const LOGSITE* GetSite(unsigned int Id);
+
+
+
+private:
+
+  /// Identifier of the site
+  unsigned int  _Id;
+
+  /// Type of log
+  const int     _Type;
+
+  /// Format of the lines
+  const char*   _Format;
+
+  /// Source line of the call site
+  const char*   _Source;
+
+  /// Number of registered sites
+  static volatile unsigned int _Count;
+
+  /// Registered sites, by identifier
+  static const LOGSITE* volatile _Sites[LOG_SITE_MAX];
+};
+
+
+
+#endif
@@ -14,15 +14,21 @@
 // Standard headers
 #include <pthread.h>
 #include <set>
+#include <string>
+#include <vector>
 
 // Project headers
 #include "object.h"
+#include "allocator.h"
 
 
 
 // Forward declarations (needed because of cross-references)
 class CONNECTION;
 class SOCKET;
+class WORKERS;
+class PUBLISHER;
+class SESSIONS;
 
 
 
@@ -31,6 +37,48 @@ typedef std::set<CONNECTION*> CONTAINER;
 
 
 
+/// Part of the connections a shutdown worker says goodbye to
+typedef struct
+{
+  /// Socket identifiers of the connections
+  std::vector<int>  SocketIds;
+
+  /// Data to send to each connection : its unsent frames, then the goodbye (empty if the client is gone)
+  std::vector<std::string> Frames;
+
+  /// Monotonic time after which the remaining connections are dropped (in milliseconds)
+  long long         DeadlineMs;
+
+  /// Number of connections which have acknowledged the goodbye
+  int               Delivered;
+} FAN_OUT;
+
+
+
+/// State of a connection handed over to another process
+typedef struct
+{
+  /// Socket identifier (in the process owning it)
+  int  SocketId;
+
+  /// Identifiers namespace (endpoint the connection was accepted on)
+  int  Namespace;
+
+  /// Host identifier
+  int  HostId;
+
+  /// Session token given to the client (0 if sessions are disabled)
+  unsigned long long Token;
+
+  /// Interval between two ID sendings (in milliseconds)
+  int  RateMs;
+
+  /// Time left before the next ID sending (in milliseconds)
+  int  DelayMs;
+} HANDOVER;
+
+
+
 /**
  * \brief Connections manager
  */
@@ -56,33 +104,173 @@ private:
 
 public:
 
+  /**
+   * \brief          Sets the number of identifiers namespaces (before any connection)
+   *
+   * \param  Count   Number of namespaces, each with its own identifiers and connections count
+   */
+  void SetNamespaces(int Count);
+
+
+
+  /**
+   * \brief          Keeps the host identifiers of disconnected clients for a while
+   *
+   * \param  TtlMs   Time a disconnected client may resume its session (in milliseconds)
+   */
+  void EnableSessions(int TtlMs);
+
+
+
   /**
    * \brief          Creation of new connection
    *
-   * \param  Socket  Socket already opened
+   * \param  Socket    Socket already opened
+   * \param  Namespace Identifiers namespace of the connection
    *
    * \return         Host identifier
    */
-  int Create(SOCKET&);
+  int Create(SOCKET&, int Namespace = 0);
+
+
+
+  /**
+   * \brief          Creation of a connection taken over from another process
+   *
+   * \param  Socket  Socket already opened
+   * \param  State   State of the connection in the previous process
+   * \param  Lease   Identifiers the client still holds from its GET commands
+   */
+  void Adopt(SOCKET& Socket, const HANDOVER& State, const ID_RANGES& Lease);
 
 
 
   /**
-   * \brief          Destruction of a connection
+   * \brief          Destruction of a connection, by its thread when it ends
    *
-   * \param  HostId  Host identifier of connection to destroy
+   * \param  Connection Connection to destroy (only marked as stopped during a shutdown or a handover)
    */
-  void Destroy(int HostId);
+  void Destroy(CONNECTION& Connection);
+
+
+
+  /**
+   * \brief          Gives back to a reconnected client the host identifier of its session
+   *
+   * \param  Namespace Identifiers namespace of the connection
+   * \param  HostId  Host identifier of the connection (replaced by the one of the session)
+   * \param  Token   Token of the connection (replaced by the one of the session)
+   * \param  Session Token presented by the client
+   *
+   * \return         \b true if the session has been resumed
+   * \return         \b false if the session is unknown or has expired
+   */
+  bool Resume(int Namespace, int& HostId, unsigned long long& Token, unsigned long long Session);
+
+
+
+  /**
+   * \brief          Leases unique identifiers to a client, besides its host identifier
+   *
+   * \param  Namespace Identifiers namespace of the client
+   * \param  Count   Number of identifiers
+   * \param  Ranges  Leased ranges (as contiguous as possible)
+   *
+   * \return         \b true if the identifiers are leased
+   * \return         \b false if the leases of the whole server have reached their budget
+   */
+  bool LeaseIds(int Namespace, unsigned int Count, ID_RANGES& Ranges);
+
+
+
+  /**
+   * \brief          Ends a lease of identifiers
+   *
+   * \param  Namespace Identifiers namespace of the client
+   * \param  Ranges  Leased ranges (cleared)
+   */
+  void ReleaseIds(int Namespace, ID_RANGES& Ranges);
 
 
 
   /**
    * \brief          Getter for the current number of connections
    *
-   * \return         Number of connections in the container
+   * \param  Namespace Identifiers namespace
+   *
+   * \return         Number of connections of the namespace
+   */
+  int Count(int Namespace = 0) const;
+
+
+
+  /**
+   * \brief          Says goodbye to all the clients and closes the connections
+   *
+   * \param DeadlineMs Maximal duration of the goodbye (in milliseconds)
+   *
+   * \post           The sockets of all the connections are closed, the process has to exit.
+   */
+  void Shutdown(int DeadlineMs);
+
+
+
+  /**
+   * \brief          Tells if the connections are being shut down
+   *
+   * \return         \b true if the shutdown has started
+   * \return         \b false otherwise
+   */
+  bool IsClosing() const;
+
+
+
+  /**
+   * \brief          Getter for the descriptor waking the connection threads up at a shutdown or a handover
+   *
+   * \return         Descriptor readable once the connections are closing
+   */
+  int GetWakeId() const;
+
+
+
+  /**
+   * \brief          Stops all the connections without closing them, to hand them over
+   *
+   * \param  States  States of the connections handed over
+   * \param  Leases  Identifiers leased by each connection handed over (in the order of the states)
+   * \param  DeadlineMs Maximal duration of the stop, unsent frames included (in milliseconds)
+   *
+   * \post           Connection threads neither send nor receive anymore, the process has to exit.
+   */
+  void Freeze(std::vector<HANDOVER>& States, std::vector<ID_RANGES>& Leases, int DeadlineMs);
+
+
+
+  /**
+   * \brief          Shares the connections count and the host identifiers with worker processes
+   *
+   * \param  Workers Pool of worker processes (the master process only dispatches the connections)
    */
+  void Attach(WORKERS& Workers);
 
-  int Count() const;
+
+
+  /**
+   * \brief          Publishes the connections count and the host identifiers in a shared page
+   *
+   * \param  Publisher Page read by local clients (its identifiers are then the ones in use)
+   */
+  void Publish(PUBLISHER& Publisher);
+
+
+
+  /**
+   * \brief          Getter for the capacity of host identifiers
+   *
+   * \return         Maximal number of host identifiers
+   */
+  static unsigned int GetIdCapacity();
 
 
 
@@ -91,9 +279,39 @@ private:
   /**
    * \brief          Generator for new host identifer
    *
+   * \param  Namespace Identifiers namespace
+   *
    * \return         New host identifer
    */
-  int NewHostID();
+  int NewHostID(int Namespace);
+
+
+
+  /**
+   * \brief          Release of a host identifier
+   *
+   * \param  Namespace Identifiers namespace
+   * \param  HostId  Host identifier no longer used
+   */
+  void FreeHostID(int Namespace, int HostId);
+
+
+
+  /**
+   * \brief          Release of the host identifiers of the expired sessions
+   */
+  void ExpireSessions();
+
+
+
+  /**
+   * \brief          Getter for the allocator of host identifiers in use
+   *
+   * \param  Namespace Identifiers namespace
+   *
+   * \return         Allocator of the published page, of the workers or of the manager itself
+   */
+  ALLOCATOR& GetAllocator(int Namespace);
 
 
 
@@ -107,17 +325,67 @@ private:
 
 
   /**
-   * \brief          Remove a connection from the container
+   * \brief          Remove a connection from the container (the lock being held)
    *
    * \param Connection Pointer to the connection
+   *
+   * \return         \b true if the connection has been removed
+   * \return         \b false if it was not in the container
    */
-  void Remove(CONNECTION* Connection);
+  bool Remove(CONNECTION* Connection);
+
+
+
+  /**
+   * \brief          Stops the threads of all the connections, so that their sockets are not used anymore
+   *
+   * \param  DeadlineMs Monotonic time after which the threads still running are given up (in milliseconds)
+   * \param  Stopped Connections whose thread has stopped
+   *
+   * \return         Number of connections
+   */
+  size_t StopAll(long long DeadlineMs, std::vector<CONNECTION*>& Stopped);
+
+
+
+  /**
+   * \brief          Task of a shutdown worker
+   *
+   * \param  Arg     Pointer to the part of the connections to process
+   *
+   * \return         NULL
+   */
+  static void* RunFanOut(void* Arg);
 
 
 
   pthread_mutex_t _Lock;
 
   CONTAINER       _Container;
+
+  /// Generators of unique host identifiers owned by the manager (one per namespace)
+  std::vector<ALLOCATOR*> _Allocators;
+
+  /// Pool of worker processes (NULL if connections are run by the current process only)
+  WORKERS*        _Workers;
+
+  /// Page publishing the state to local clients (NULL if not published)
+  PUBLISHER*      _Publisher;
+
+  /// Sessions of disconnected clients (NULL if host identifiers are released at once)
+  SESSIONS*       _Sessions;
+
+  /// Allocators of host identifiers in use (own ones, or shared with workers or local clients)
+  std::vector<ALLOCATOR*> _Ids;
+
+  /// Number of connections of each namespace (in the current process)
+  std::vector<int> _Counts;
+
+  /// Flag telling if the connections are being shut down (they then belong to the shutdown)
+  volatile bool   _Closing;
+
+  /// Descriptor waking the connection threads up once closing (one per process)
+  int             _WakeId;
 };
 
 
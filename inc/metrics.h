@@ -0,0 +1,270 @@
+/**
+ * \file metrics.h
+ *
+ * \brief Header for metrics
+ *
+ * \author Olivier de BLIC
+ */
+
+
+
+#ifndef METRICS_H
+#define METRICS_H
+
+// Standard headers
+#include <stddef.h>
+#include <pthread.h>
+
+// Project headers
+#include "histogram.h"
+
+
+
+/// Enumeration of metrics
+typedef enum
+{
+  METRIC_ACCEPTED,
+  METRIC_ACCEPT_ERRORS,
+  METRIC_ACCEPT_OVERFLOWS,
+  METRIC_CONNECTIONS,
+  METRIC_DISCONNECTED,
+  METRIC_BYTES_SENT,
+  METRIC_BYTES_RECEIVED,
+  METRIC_SEND_ERRORS,
+  METRIC_TICKS_SENT,
+  METRIC_COUNT_REQUESTS,
+  METRIC_GET_REQUESTS,
+  METRIC_RESUMED,
+  METRIC_ID_COUNT
+} METRIC_ID;
+
+
+
+/// Enumeration of histograms (durations in microseconds)
+typedef enum
+{
+  HISTOGRAM_TICK_LATENESS,
+  HISTOGRAM_COUNT_LATENCY,
+  HISTOGRAM_ID_COUNT
+} HISTOGRAM_ID;
+
+
+
+/// Enumeration of metric kinds
+typedef enum
+{
+  METRIC_COUNTER,
+  METRIC_GAUGE,
+  METRIC_SUMMARY
+} METRIC_KIND;
+
+
+
+/// Description of a metric
+typedef struct
+{
+  /// Name of the metric
+  const char*  Name;
+
+  /// Description of the metric
+  const char*  Help;
+
+  /// Counter (only increases), gauge (goes up and down) or summary (histogram)
+  METRIC_KIND  Kind;
+} METRIC_INFO;
+
+
+
+/// Values of the metrics updated by a thread (alone on its cache lines)
+typedef struct METRICS_SHARD
+{
+  /// Values, only written by the thread owning the shard
+  volatile long long      Values[METRIC_ID_COUNT];
+
+  /// Next shard of the list of all the shards
+  struct METRICS_SHARD*   Next;
+
+  /// Next shard of the list of the free shards
+  struct METRICS_SHARD*   NextFree;
+} __attribute__((aligned(64))) METRICS_SHARD;
+
+
+
+/**
+ * \brief Metrics of the server
+ *
+ * Each thread updates its own shard, taken on its first update : a plain
+ * addition, without any atomic operation nor shared cache line. Readers add
+ * the values of all the shards up. The shard of an ended thread keeps its
+ * values and is given to a new thread, so that counters never go backwards
+ * and that there are never more shards than threads running at once.
+ */
+class METRICS
+{
+public:
+
+  /**
+   * \brief          Update of a metric by the calling thread
+   *
+   * \param Id       Metric
+   * \param Value    Value added to the metric (negative to decrease a gauge)
+   */
+  static void Add(METRIC_ID Id, long long Value = 1);
+
+
+
+  /**
+   * \brief          Records a duration in a histogram
+   *
+   * \param Id       Histogram
+   * \param Value    Duration (in microseconds)
+   */
+  static void Record(HISTOGRAM_ID Id, unsigned long long Value);
+
+
+
+  /**
+   * \brief          Reads a metric
+   *
+   * \param Id       Metric
+   *
+   * \return         Sum of the values of all the shards
+   */
+  static long long Read(METRIC_ID Id);
+
+
+
+  /**
+   * \brief          Reads all the metrics
+   *
+   * \param Values   Sums of the values of all the shards, by metric
+   */
+  static void ReadAll(long long Values[METRIC_ID_COUNT]);
+
+
+
+  /**
+   * \brief          Getter for the description of a metric
+   *
+   * \param Id       Metric
+   *
+   * \return         Description of the metric
+   */
+  static const METRIC_INFO& GetInfo(METRIC_ID Id);
+
+
+
+  /**
+   * \brief          Reads a histogram
+   *
+   * \param Id       Histogram
+   * \param Data     Values merged from all the shards
+   */
+  static void ReadHistogram(HISTOGRAM_ID Id, HISTOGRAM_DATA& Data);
+
+
+
+  /**
+   * \brief          Getter for the description of a histogram
+   *
+   * \param Id       Histogram
+   *
+   * \return         Description of the histogram
+   */
+  static const METRIC_INFO& GetInfo(HISTOGRAM_ID Id);
+
+
+
+private:
+
+  /**
+   * \brief          Getter for the shard of the calling thread, on its first update
+   *
+   * \return         Shard of the thread (taken from the free shards or created)
+   */
+  static METRICS_SHARD& GetShard();
+
+
+
+  /**
+   * \brief          Gives up the shard of an ending thread
+   *
+   * \param Shard    Shard of the thread
+   */
+  static void ReleaseShard(void* Shard);
+
+
+
+  /**
+   * \brief          Creation of the key of the shards (once)
+   */
+  static void CreateKey();
+
+
+
+  /// Shard of each thread (NULL until its first update)
+  static __thread METRICS_SHARD* _Shard;
+
+  /// List of all the shards (only grows, read without lock)
+  static METRICS_SHARD* volatile _Shards;
+
+  /// Shards of ended threads, waiting for new threads
+  static METRICS_SHARD* _FreeShards;
+
+  /// Mutex protecting the free shards (taken on the first update of a thread and at its end)
+  static pthread_mutex_t _Lock;
+
+  /// Key giving back the shard of an ending thread
+  static pthread_key_t _Key;
+
+  /// Creation of the key
+  static pthread_once_t _KeyOnce;
+
+  /// Descriptions of the metrics
+  static const METRIC_INFO _Infos[METRIC_ID_COUNT];
+
+  /// Histograms
+  static HISTOGRAM _Histograms[HISTOGRAM_ID_COUNT];
+
+  /// Descriptions of the histograms
+  static const METRIC_INFO _HistogramInfos[HISTOGRAM_ID_COUNT];
+};
+
+
+
+/**
+ * \brief          Update of a metric by the calling thread
+ *
+ * \param Id       Metric
+ * \param Value    Value added to the metric (negative to decrease a gauge)
+ *
+ * \note           Inlined at each call site : a thread local read and an addition.
+ */
+inline void METRICS::Add(METRIC_ID Id, long long Value)
+{
+  METRICS_SHARD* Shard = _Shard;
+
+  if(Shard == NULL)
+  {
+    Shard = &GetShard();
+  }
+
+  Shard->Values[Id] += Value;
+}
+
+
+
+/**
+ * \brief          Records a duration in a histogram
+ *
+ * \param Id       Histogram
+ * \param Value    Duration (in microseconds)
+ */
+inline void METRICS::Record(HISTOGRAM_ID Id, unsigned long long Value)
+{
+  _Histograms[Id].Record(Value);
+}
+
+
+
+#endif
@@ -13,6 +13,7 @@
 
 // Standard headers
 #include <string>
+#include <vector>
 
 // Project headers
 
@@ -102,6 +103,212 @@ public:
 
 
 
+  /**
+   * \brief          Getter for the minimal tick interval a client may request
+   *
+   * \return         Minimal tick interval (in milliseconds)
+   */
+  int GetRateMin() const;
+
+
+
+  /**
+   * \brief          Getter for the maximal tick interval a client may request
+   *
+   * \return         Maximal tick interval (in milliseconds)
+   */
+  int GetRateMax() const;
+
+
+
+  /**
+   * \brief          Getter for the length of the queue of pending connections
+   *
+   * \return         Listening backlog
+   */
+  int GetBacklog() const;
+
+
+
+  /**
+   * \brief          Getter for the number of acceptors listening on the server port
+   *
+   * \return         Number of acceptors
+   */
+  int GetAcceptors() const;
+
+
+
+  /**
+   * \brief          Getter for steering of connections to the acceptor of the receiving processor
+   *
+   * \return         \b true if enabled
+   * \return         \b false if disabled
+   */
+  bool GetSteering() const;
+
+
+
+  /**
+   * \brief          Getter for the TCP Fast Open queue length
+   *
+   * \return         Queue length (0 if disabled)
+   */
+  int GetFastOpen() const;
+
+
+
+  /**
+   * \brief          Getter for the deferred accept timeout
+   *
+   * \return         Maximal waiting time for the first data in seconds (0 if disabled)
+   */
+  int GetDeferAccept() const;
+
+
+
+  /**
+   * \brief          Getter for the keep alive probes setting
+   *
+   * \param Idle     Idle time before the first probe (in seconds)
+   * \param Interval Time between two probes (in seconds)
+   * \param Count    Number of unanswered probes before dropping the connection
+   *
+   * \return         \b true if set
+   * \return         \b false if the system defaults apply
+   */
+  bool GetKeepAlive(int& Idle, int& Interval, int& Count) const;
+
+
+
+  /**
+   * \brief          Getter for the TCP user timeout
+   *
+   * \return         Maximal time sent data may stay unacknowledged in ms (0 for the system default)
+   */
+  int GetUserTimeout() const;
+
+
+
+  /**
+   * \brief          Getter for the maximal duration of the goodbye to clients at shutdown
+   *
+   * \return         Shutdown deadline (in milliseconds)
+   */
+  int GetShutdownDeadline() const;
+
+
+
+  /**
+   * \brief          Getter for the path of the upgrade socket
+   *
+   * \return         Path of the Unix socket sockets are handed over through (empty if disabled)
+   */
+  const std::string& GetUpgradePath() const;
+
+
+
+  /**
+   * \brief          Getter for the number of worker processes
+   *
+   * \return         Number of worker processes (0 if connections are run by a single process)
+   */
+  int GetWorkers() const;
+
+
+
+  /**
+   * \brief          Getter for the path of the Unix domain listening socket
+   *
+   * \return         Path of the socket for clients on the same host (empty if disabled)
+   */
+  const std::string& GetLocalPath() const;
+
+
+
+  /**
+   * \brief          Getter for the path of the page publishing the server state
+   *
+   * \return         Path of the shared memory file read by local clients (empty if disabled)
+   */
+  const std::string& GetSharedPath() const;
+
+
+
+  /**
+   * \brief          Getter for the ports of the additional endpoints
+   *
+   * \return         Port numbers, each endpoint having its own identifiers and connections count
+   */
+  const std::vector<unsigned short>& GetEndpoints() const;
+
+
+
+  /**
+   * \brief          Getter for the time a disconnected client may resume its session
+   *
+   * \return         Session TTL (in milliseconds, 0 if sessions are disabled)
+   */
+  int GetSessionTtl() const;
+
+
+
+  /**
+   * \brief          Getter for the path of the binary log
+   *
+   * \return         Path of the file logs are written to, formatted only when decoded (empty if disabled)
+   */
+  const std::string& GetBinaryLog() const;
+
+
+
+  /**
+   * \brief          Getter for the time stamp counter flag
+   *
+   * \return         \b true if the high resolution clock has to read the calibrated counter
+   * \return         \b false if it has to read the kernel clock
+   */
+  bool GetTsc() const;
+
+
+
+  /**
+   * \brief          Getter for the path of the log file
+   *
+   * \return         Path of the memory mapped file lines are written to (empty if they go to the standard output)
+   */
+  const std::string& GetLogFile() const;
+
+
+
+  /**
+   * \brief          Getter for the log file rotation
+   *
+   * \param SegmentMb Size of the file before rotation (in MB)
+   * \param PeriodSec Age of the file before rotation (in seconds, 0 for no limit)
+   */
+  void GetLogRotation(int& SegmentMb, int& PeriodSec) const;
+
+
+
+  /**
+   * \brief          Getter for the administration port
+   *
+   * \return         Port the metrics are exposed on (0 if disabled)
+   */
+  unsigned short GetAdminPort() const;
+
+
+
+  /**
+   * \brief          Getter for the path of the page mirroring the metrics
+   *
+   * \return         Path of the shared memory file read by seastar-stat (empty if disabled)
+   */
+  const std::string& GetStatsPath() const;
+
+
+
 private:
 
   bool           _AlreadyParsed;
@@ -115,6 +322,56 @@ private:
   bool           _Verbose;
 
   unsigned short _PortNum;
+
+  int            _RateMinMs;
+
+  int            _RateMaxMs;
+
+  int            _Backlog;
+
+  int            _Acceptors;
+
+  bool           _Steering;
+
+  int            _FastOpen;
+
+  int            _DeferAccept;
+
+  int            _KeepIdle;
+
+  int            _KeepInterval;
+
+  int            _KeepCount;
+
+  int            _UserTimeout;
+
+  int            _ShutdownMs;
+
+  std::string    _UpgradePath;
+
+  int            _Workers;
+
+  std::string    _LocalPath;
+
+  std::string    _SharedPath;
+
+  std::vector<unsigned short> _Endpoints;
+
+  int            _SessionTtlMs;
+
+  std::string    _BinaryLog;
+
+  bool           _Tsc;
+
+  std::string    _LogFile;
+
+  int            _LogSegmentMb;
+
+  int            _LogPeriodSec;
+
+  unsigned short _AdminPort;
+
+  std::string    _StatsPath;
 };
 
 
@@ -0,0 +1,222 @@
+/**
+ * \file publisher.h
+ *
+ * \brief Header for server state published in shared memory
+ *
+ * \author Olivier de BLIC
+ */
+
+
+
+#ifndef PUBLISHER_H
+#define PUBLISHER_H
+
+// Standard headers
+#include <string>
+#include <vector>
+#include <sys/types.h>
+#include <pthread.h>
+
+// Project headers
+#include "object.h"
+#include "allocator.h"
+
+
+
+/// Statistics of a shard (the server process, or a worker process in prefork mode)
+typedef struct
+{
+  /// Number of connections currently run
+  int                 Active;
+
+  /// Highest number of connections run at the same time
+  int                 Peak;
+
+  /// Number of connections created since the start
+  unsigned long long  Created;
+} SHARD_STATS;
+
+
+
+/// Header of the published page (the shards statistics and the identifiers bitmap follow)
+typedef struct
+{
+  /// Format identifier
+  unsigned int        Magic;
+
+  /// Number of shards
+  unsigned int        ShardCount;
+
+  /// Number of host identifiers
+  unsigned int        IdCapacity;
+
+  /// Offset of the identifiers allocator state (in bytes from the header)
+  unsigned int        IdOffset;
+
+  /// Process identifier of the server (0 once it has stopped or handed over)
+  volatile pid_t      Pid;
+} PAGE_HEADER;
+
+
+
+/// Shard of the published page (one cache line each, updated by its own process only)
+typedef struct
+{
+  /// Sequence number of the seqlock of the shard (odd while an update is in progress)
+  volatile unsigned   Sequence;
+
+  /// Statistics of the shard
+  SHARD_STATS         Stats;
+} __attribute__((aligned(64))) PAGE_SHARD;
+
+
+
+/**
+ * \brief Memory-mapped page publishing the server state to local readers
+ *
+ * The server maps a file holding the statistics of each shard, each one protected
+ * by its own seqlock and written by its own process only : no lock is shared
+ * between processes, so that a worker dying in the middle of an update blocks no
+ * one. Readers copy each shard without any lock or system call, retry if its
+ * sequence number is odd or has changed, and sum the shards to get the number of
+ * connections of the whole server. The page also holds the
+ * host identifiers bitmap, so that local clients may claim unique identifiers with
+ * atomic operations only, in the same space as the identifiers of connections.
+ *
+ * A restarted server publishes a new file : readers reopen the path once the
+ * process identifier of their page is 0.
+ */
+class PUBLISHER : public OBJECT
+{
+public:
+
+  /**
+   * \brief          Publisher constructor (server side, creates the page)
+   *
+   * \param Path       Path of the published file
+   * \param ShardCount Number of shards
+   * \param IdCapacity Number of host identifiers
+   */
+  PUBLISHER(const std::string& Path, int ShardCount, unsigned int IdCapacity);
+
+
+
+  /**
+   * \brief          Publisher constructor (reader side, maps an existing page)
+   *
+   * \param Path     Path of the published file
+   */
+  PUBLISHER(const std::string& Path);
+
+
+
+  /**
+   * \brief          Publisher destructor
+   */
+  virtual ~PUBLISHER();
+
+
+
+  /**
+   * \brief          Selects the shard updated by the current process (server side)
+   *
+   * \param Shard    Index of the shard
+   */
+  void SetShard(int Shard);
+
+
+
+  /**
+   * \brief          Updates the number of connections of the current shard (server side)
+   *
+   * \param Delta    Number of connections added (negative if removed)
+   */
+  void Update(int Delta);
+
+
+
+  /**
+   * \brief          Clears a shard whose connections have been lost (server side)
+   *
+   * Only called once the process of the shard has been reaped : it is then the
+   * single writer of the shard.
+   *
+   * \param Shard    Index of the shard
+   */
+  void ResetShard(int Shard);
+
+
+
+  /**
+   * \brief          Reads a consistent copy of the published state (no system call)
+   *
+   * \param Count    Number of connections of the whole server
+   * \param Shards   Statistics of each shard
+   */
+  void Snapshot(int& Count, std::vector<SHARD_STATS>& Shards) const;
+
+
+
+  /**
+   * \brief          Tells if the server publishing the page is still running
+   *
+   * \return         \b true if the page is alive
+   * \return         \b false if the server has stopped (the path may hold a newer page)
+   */
+  bool IsAlive() const;
+
+
+
+  /**
+   * \brief          Getter for the host identifiers allocator of the page
+   *
+   * \return         Reference to the allocator
+   */
+  ALLOCATOR& GetAllocator();
+
+
+
+private:
+
+  /**
+   * \brief          Maps the page file
+   *
+   * \param Size     Size of the file (in bytes)
+   */
+  void Map(size_t Size);
+
+
+
+  /**
+   * \brief          Getter for a shard of the page
+   *
+   * \param Shard    Index of the shard
+   *
+   * \return         Shard in the page
+   */
+  PAGE_SHARD* GetShard(int Shard) const;
+
+
+
+  /// Descriptor of the page file
+  int            _FileId;
+
+  /// Size of the mapping (in bytes)
+  size_t         _Size;
+
+  /// Header of the page
+  PAGE_HEADER*   _Header;
+
+  /// Shard updated by the current process
+  int            _Shard;
+
+  /// Lock serializing the updates of the threads of the current process
+  pthread_mutex_t _Lock;
+
+  /// Host identifiers allocator (in the page)
+  ALLOCATOR*     _Allocator;
+};
+
+
+
+#endif
@@ -0,0 +1,163 @@
+/**
+ * \file scheduler.h
+ *
+ * \brief Header for priority-aware sendings
+ *
+ * \author Olivier de BLIC
+ */
+
+
+
+#ifndef SCHEDULER_H
+#define SCHEDULER_H
+
+// Standard headers
+#include <string>
+#include <deque>
+
+// Project headers
+#include "object.h"
+
+
+
+// Forward declaration (needed because of cross-references)
+class SOCKET;
+
+
+
+/// Enumeration of sending classes (by decreasing weight)
+typedef enum
+{
+  SEND_INTERACTIVE,
+  SEND_TICK,
+  SEND_CLASS_COUNT,
+} SEND_CLASS;
+
+
+
+/**
+ * \brief Send scheduler sharing a socket between several classes of frames
+ *
+ * Each class has its own queue and queues are served by a deficit round robin
+ * weighted by class, so that replies to requests keep a low latency even when
+ * the socket cannot absorb all the periodic sendings. Periodic ticks are
+ * coalesced : at most one tick is waiting at any time.
+ */
+class SCHEDULER : public OBJECT
+{
+public:
+
+  /**
+   * \brief          Scheduler constructor
+   *
+   * \param Socket   Reference to the socket frames are sent to
+   */
+  SCHEDULER(SOCKET& Socket);
+
+
+
+  /**
+   * \brief          Scheduler destructor
+   */
+  virtual ~SCHEDULER();
+
+
+
+  /**
+   * \brief          Queue a frame to send
+   *
+   * \param Class    Sending class of the frame
+   * \param Frame    Data to send
+   */
+  void Push(SEND_CLASS Class, const std::string& Frame);
+
+
+
+  /**
+   * \brief          Send as many queued frames as the socket accepts without blocking
+   *
+   * \return         \b true if all the frames are sent
+   * \return         \b false if some frames are still waiting
+   */
+  bool Flush();
+
+
+
+  /**
+   * \brief          Tells if frames are waiting to be sent
+   *
+   * \return         \b true if frames are waiting
+   * \return         \b false if nothing is waiting
+   */
+  bool IsPending() const;
+
+
+
+  /**
+   * \brief          Takes the data not sent yet, once nothing sends to the socket anymore
+   *
+   * \param Unsent   Buffer the end of the batch being sent, then the queued frames, are appended to
+   */
+  void TakeUnsent(std::string& Unsent);
+
+
+
+  /**
+   * \brief          Getter for the number of coalesced ticks
+   *
+   * \return         Number of ticks merged with an already waiting one
+   */
+  unsigned long GetCoalesced() const;
+
+
+
+private:
+
+  /**
+   * \brief          Tells if frames are waiting in the queues
+   *
+   * \return         \b true if at least one queue is not empty
+   * \return         \b false if all the queues are empty
+   */
+  bool IsQueued() const;
+
+
+
+  /**
+   * \brief          Move the next frames to send in the batch, according to the weights
+   *
+   * \return         \b true if at least one frame has been moved
+   * \return         \b false if all the queues are empty
+   */
+  bool SelectNext();
+
+
+
+  /// Socket frames are sent to
+  SOCKET&                  _Socket;
+
+  /// Queues of frames waiting to be sent (one per class)
+  std::deque<std::string>  _Queues[SEND_CLASS_COUNT];
+
+  /// Credit of bytes for each class in the current round
+  int                      _Deficit[SEND_CLASS_COUNT];
+
+  /// Class currently served in the round
+  int                      _Round;
+
+  /// Flag telling if the current class has already received its quantum
+  bool                     _Credited;
+
+  /// Batch of frames currently being sent
+  std::string              _Batch;
+
+  /// Number of bytes of the batch already sent
+  size_t                   _Offset;
+
+  /// Number of coalesced ticks
+  unsigned long            _Coalesced;
+};
+
+
+
+#endif
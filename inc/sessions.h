@@ -0,0 +1,132 @@
+/**
+ * \file sessions.h
+ *
+ * \brief Header for resumable sessions
+ *
+ * \author Olivier de BLIC
+ */
+
+
+
+#ifndef SESSIONS_H
+#define SESSIONS_H
+
+// Standard headers
+#include <pthread.h>
+#include <deque>
+#include <vector>
+#include <utility>
+#include <tr1/unordered_map>
+
+// Project headers
+#include "object.h"
+
+
+
+/// Host identifier kept for a disconnected client
+typedef struct
+{
+  /// Identifiers namespace (endpoint the client connected to)
+  int        Namespace;
+
+  /// Host identifier (still allocated)
+  int        HostId;
+
+  /// Monotonic time after which the session cannot be resumed (in milliseconds)
+  long long  ExpiryMs;
+} SESSION;
+
+
+
+/**
+ * \brief Table of the sessions of disconnected clients
+ *
+ * Each connection is given a token with its first ID. When the client leaves,
+ * its host identifier is parked under this token instead of being released, so
+ * that a client coming back within the TTL gets it again. Tokens are looked up
+ * in a hash table and, as they all live for the same TTL, expire in the order
+ * they were parked : expired sessions are popped from the head of a queue.
+ */
+class SESSIONS : public OBJECT
+{
+public:
+
+  /**
+   * \brief          Sessions table constructor
+   *
+   * \param TtlMs    Time a disconnected client may resume its session (in milliseconds)
+   */
+  SESSIONS(int TtlMs);
+
+
+
+  /**
+   * \brief          Sessions table destructor
+   */
+  virtual ~SESSIONS();
+
+
+
+  /**
+   * \brief          Generator for a new session token
+   *
+   * \return         Random token, unknown to the table (never 0)
+   */
+  unsigned long long NewToken();
+
+
+
+  /**
+   * \brief          Keeps the host identifier of a disconnected client
+   *
+   * \param Token    Token of the session
+   * \param Namespace Identifiers namespace of the client
+   * \param HostId   Host identifier, left allocated until it is resumed or expires
+   */
+  void Park(unsigned long long Token, int Namespace, int HostId);
+
+
+
+  /**
+   * \brief          Gives back the host identifier of a session to a reconnected client
+   *
+   * \param Token    Token presented by the client
+   * \param Namespace Identifiers namespace of the new connection
+   *
+   * \return         Host identifier of the session (removed from the table)
+   * \return         -1 if the token is unknown, expired or from another namespace
+   */
+  int Resume(unsigned long long Token, int Namespace);
+
+
+
+  /**
+   * \brief          Removes the expired sessions
+   *
+   * \param Expired  Sessions whose host identifiers have to be released (appended)
+   */
+  void Expire(std::vector<SESSION>& Expired);
+
+
+
+private:
+
+  /// Sessions indexed by token
+  typedef std::tr1::unordered_map<unsigned long long, SESSION> TABLE;
+
+  /// Lock protecting the table and the queue
+  pthread_mutex_t          _Lock;
+
+  /// Time a disconnected client may resume its session (in milliseconds)
+  const int                _TtlMs;
+
+  /// Sessions of the disconnected clients
+  TABLE                    _Table;
+
+  /// Expiry times and tokens, in the order sessions were parked
+  std::deque< std::pair<long long, unsigned long long> > _Expiries;
+};
+
+
+
+#endif
@@ -23,6 +23,15 @@
 
 
 
+/// Enumeration of socket domains
+typedef enum
+{
+  SOCKET_TCP,
+  SOCKET_LOCAL,
+} SOCKET_DOMAIN;
+
+
+
 /**
  * \brief Wrapper for sockets use in C++
  */
@@ -34,8 +43,19 @@ public:
 
   /**
    * \brief          Socket constructor
+   *
+   * \param Domain   TCP socket or Unix domain stream socket (for clients on the same host)
+   */
+  SOCKET(SOCKET_DOMAIN Domain = SOCKET_TCP);
+
+
+
+  /**
+   * \brief          Socket constructor (wrapper of an already opened socket)
+   *
+   * \param SocketId Already existing socket identifier (opened with accept or received from another process)
    */
-  SOCKET();
+  explicit SOCKET(int SocketId);
 
 
 
@@ -73,10 +93,21 @@ public:
 
 
 
+  /**
+   * \brief          Binds the socket to a file system path (Unix domain server mode)
+   *
+   * \param Path     Path of the socket (a stale socket file is replaced)
+   */
+  void Bind(const std::string& Path);
+
+
+
   /**
    * \brief          Listens the socket (server mode)
+   *
+   * \param Backlog  Maximal length of the queue of pending connections
    */
-  void Listen();
+  void Listen(int Backlog);
 
 
 
@@ -99,6 +130,100 @@ public:
   SOCKET& Accept();
 
 
+
+  /**
+   * \brief          Accepts a connection without blocking (server mode)
+   *
+   * \return         Pointer to the accepted socket
+   * \return         NULL if no connection is pending
+   *
+   * \note           When the process runs out of file descriptors, the pending connection is
+   *                 accepted on a reserved descriptor and immediately closed, so that the queue
+   *                 does not stay readable forever.
+   */
+  SOCKET* TryAccept();
+
+
+
+  /**
+   * \brief          Getter for the accept queue state (server mode)
+   *
+   * \param Length   Number of connections waiting to be accepted
+   * \param Backlog  Maximal length of the queue
+   *
+   * \note           Both are 0 for a Unix domain socket, which does not report them.
+   */
+  void GetAcceptQueue(int& Length, int& Backlog) const;
+
+
+
+  /**
+   * \brief          Switches the socket to the non-blocking mode
+   */
+  void SetNonBlocking();
+
+
+
+  /**
+   * \brief          Allows several sockets to listen on the same port (before binding)
+   */
+  void SetReusePort();
+
+
+
+  /**
+   * \brief          Steers new connections to the listener of the receiving processor (server mode)
+   *
+   * \param Count    Number of sockets in the reuse port group
+   *
+   * \note           The connection received by the processor N goes to the listener
+   *                 bound in position N modulo Count in the group.
+   */
+  void SetCpuSteering(int Count);
+
+
+
+  /**
+   * \brief          Enables TCP Fast Open on a listening socket (server mode)
+   *
+   * \param QueueLen Maximal number of pending Fast Open requests
+   */
+  void SetFastOpen(int QueueLen);
+
+
+
+  /**
+   * \brief          Defers accept until the client sends data (server mode)
+   *
+   * \param Seconds  Maximal waiting time for the first data
+   */
+  void SetDeferAccept(int Seconds);
+
+
+
+  /**
+   * \brief          Tunes the keep alive probes detecting dead peers
+   *
+   * \param Idle     Idle time before the first probe (in seconds)
+   * \param Interval Time between two probes (in seconds)
+   * \param Count    Number of unanswered probes before dropping the connection
+   *
+   * \note           Accepted sockets inherit the setting of the listening socket.
+   */
+  void SetKeepAlive(int Idle, int Interval, int Count);
+
+
+
+  /**
+   * \brief          Bounds the time sent data may stay unacknowledged
+   *
+   * \param TimeoutMs Maximal time before dropping the connection (in milliseconds)
+   *
+   * \note           Accepted sockets inherit the setting of the listening socket.
+   */
+  void SetUserTimeout(int TimeoutMs);
+
+
   /**
    * \brief          Tells if the socket is connected
    *
@@ -119,7 +244,17 @@ public:
 
 
 
-  bool WaitData();
+  /**
+   * \brief          Waits for incoming data until a timeout
+   *
+   * \param TimeoutMs Maximal waiting time (in milliseconds)
+   * \param WakeOnWrite Also wakes up when data can be sent without blocking
+   * \param WakeId   Descriptor which ends the wait once readable (-1 for none)
+   *
+   * \return         \b true if data is waiting
+   * \return         \b false if timed out (or only writable, or woken up)
+   */
+  bool WaitData(int TimeoutMs, bool WakeOnWrite = false, int WakeId = -1);
 
 
 
@@ -132,6 +267,18 @@ public:
 
 
 
+  /**
+   * \brief          Sends data to socket without blocking
+   *
+   * \param Data     Data to send
+   * \param Offset   Position of the first byte to send in data
+   *
+   * \return         Number of bytes actually sent (0 if the socket would block)
+   */
+  size_t TrySend(const std::string& Data, size_t Offset = 0);
+
+
+
   /**
    * \brief          Sends data to socket
    *
@@ -152,17 +299,11 @@ public:
 
 private:
 
-  /**
-   * \brief          Socket constructor (reserved for accept method)
-   *
-   * \param SocketId Already existing socket identifier (opened with accept)
-   */
-  SOCKET(int SocketId);
-
-
-
   /// Socket identifier
   int  _SocketId;
+
+  /// Descriptor kept in reserve to recover from descriptors exhaustion (server mode)
+  int  _ReserveId;
 };
 
 
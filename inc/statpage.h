@@ -0,0 +1,287 @@
+/**
+ * \file statpage.h
+ *
+ * \brief Header for metrics mirrored in shared memory
+ *
+ * \author Olivier de BLIC
+ */
+
+
+
+#ifndef STATPAGE_H
+#define STATPAGE_H
+
+// Standard headers
+#include <string>
+#include <vector>
+#include <sys/types.h>
+
+// Project headers
+#include "metrics.h"
+#include "histogram.h"
+
+// Layout of the stats page
+#define STAT_PAGE_VERSION         (1)
+#define STAT_NAME_LENGTH          (56)
+
+
+
+/// Header of the stats page (the names and the slots follow)
+typedef struct
+{
+  /// Format identifier
+  unsigned int        Magic;
+
+  /// Version of the layout (readers refuse the other ones)
+  unsigned int        Version;
+
+  /// Number of slots (the server process, then each worker process in prefork mode)
+  unsigned int        SlotCount;
+
+  /// Number of metrics of each slot
+  unsigned int        MetricCount;
+
+  /// Number of histograms of each slot
+  unsigned int        HistogramCount;
+
+  /// Number of buckets of each histogram
+  unsigned int        BucketCount;
+
+  /// Offset of the first slot (in bytes from the header)
+  unsigned int        SlotOffset;
+
+  /// Size of each slot (in bytes)
+  unsigned int        SlotSize;
+
+  /// Interval between two updates of a slot (in milliseconds)
+  unsigned int        IntervalMs;
+
+  /// Process identifier of the server (0 once it has stopped or handed over)
+  volatile pid_t      Pid;
+} STAT_HEADER;
+
+
+
+/// Description of a metric or a histogram of the page
+typedef struct
+{
+  /// Name of the metric (Prometheus name)
+  char                Name[STAT_NAME_LENGTH];
+
+  /// Kind of the metric (METRIC_KIND)
+  unsigned int        Kind;
+
+  /// Padding (8 bytes alignment of the descriptions)
+  unsigned int        Reserved;
+} STAT_NAME;
+
+
+
+/// Header of a slot (the metric values and the histograms follow)
+typedef struct
+{
+  /// Sequence number of the seqlock (odd while an update is in progress)
+  volatile unsigned   Sequence;
+
+  /// Process identifier of the process updating the slot (0 if never updated)
+  volatile pid_t      Pid;
+
+  /// Time of the last update (monotonic, in nanoseconds)
+  volatile unsigned long long TimeNs;
+} STAT_SLOT;
+
+
+
+/// Consistent copy of a slot
+typedef struct
+{
+  /// Process identifier of the process updating the slot (0 if never updated)
+  pid_t                        Pid;
+
+  /// Time of the copied update (monotonic, in nanoseconds)
+  unsigned long long           TimeNs;
+
+  /// Values of the metrics
+  std::vector<long long>       Values;
+
+  /// Histograms
+  std::vector<HISTOGRAM_DATA>  Histograms;
+} STAT_SNAPSHOT;
+
+
+
+/**
+ * \brief Memory-mapped page mirroring the metrics to local readers
+ *
+ * The server process and each of its workers copy their metrics and histograms
+ * to their own slot of the page, from their main loop, at a fixed interval :
+ * threads running connections do nothing more than update their shards. Each
+ * slot is protected by its own seqlock, having a single writer : readers copy
+ * it without any lock or system call and retry if the sequence number is odd
+ * or has changed. Names and kinds of the metrics are written in the page, so
+ * that a reader needs nothing but the layout version.
+ *
+ * As the page of the server state, a restarted server publishes a new file :
+ * readers reopen the path once the process identifier of their page is 0.
+ */
+class STATPAGE
+{
+public:
+
+  /**
+   * \brief          Stats page constructor (server side, creates the page)
+   *
+   * \param Path       Path of the page file
+   * \param SlotCount  Number of slots
+   * \param IntervalMs Interval between two updates of a slot (in milliseconds)
+   */
+  STATPAGE(const std::string& Path, int SlotCount, int IntervalMs);
+
+
+
+  /**
+   * \brief          Stats page constructor (reader side, maps an existing page read-only)
+   *
+   * \param Path     Path of the page file
+   */
+  explicit STATPAGE(const std::string& Path);
+
+
+
+  /**
+   * \brief          Stats page destructor
+   */
+  ~STATPAGE();
+
+
+
+  /**
+   * \brief          Selects the slot updated by the current process (server side)
+   *
+   * \param Slot     Index of the slot
+   */
+  void SetSlot(int Slot);
+
+
+
+  /**
+   * \brief          Updates the slot of the current process once its interval has elapsed (server side)
+   *
+   * \return         Time left before the next update (in milliseconds)
+   */
+  int Publish();
+
+
+
+  /**
+   * \brief          Reads a consistent copy of a slot (no system call)
+   *
+   * \param Slot     Index of the slot
+   * \param Snapshot Copy of the slot
+   */
+  void Snapshot(int Slot, STAT_SNAPSHOT& Snapshot) const;
+
+
+
+  /**
+   * \brief          Getter for the number of slots
+   *
+   * \return         Number of slots of the page
+   */
+  int GetSlotCount() const;
+
+
+
+  /**
+   * \brief          Getter for the number of metrics
+   *
+   * \return         Number of metrics of each slot
+   */
+  int GetMetricCount() const;
+
+
+
+  /**
+   * \brief          Getter for the number of histograms
+   *
+   * \return         Number of histograms of each slot
+   */
+  int GetHistogramCount() const;
+
+
+
+  /**
+   * \brief          Getter for the description of a metric or a histogram
+   *
+   * \param Index    Index of the metric (the histograms follow the metrics)
+   *
+   * \return         Description written in the page
+   */
+  const STAT_NAME& GetName(int Index) const;
+
+
+
+  /**
+   * \brief          Getter for the interval between two updates of a slot
+   *
+   * \return         Interval (in milliseconds)
+   */
+  int GetInterval() const;
+
+
+
+  /**
+   * \brief          Tells if the server publishing the page is still running
+   *
+   * \return         \b true if the page is alive
+   * \return         \b false if the server has stopped (the path may hold a newer page)
+   */
+  bool IsAlive() const;
+
+
+
+private:
+
+  /**
+   * \brief          Maps the page file
+   *
+   * \param Size     Size of the file (in bytes)
+   * \param Writable Mapping of the server (the readers only read the page)
+   */
+  void Map(size_t Size, bool Writable);
+
+
+
+  /**
+   * \brief          Getter for the header of a slot
+   *
+   * \param Slot     Index of the slot
+   *
+   * \return         Header of the slot
+   */
+  STAT_SLOT* GetSlot(int Slot) const;
+
+
+
+  /// Descriptor of the page file
+  int                 _FileId;
+
+  /// Size of the mapping
+  size_t              _Size;
+
+  /// Mapped page
+  STAT_HEADER*        _Header;
+
+  /// Descriptions of the metrics and the histograms
+  STAT_NAME*          _Names;
+
+  /// Slot updated by the current process (-1 on the reader side)
+  int                 _Slot;
+
+  /// Time of the next update of the slot (monotonic, in milliseconds)
+  long long           _NextMs;
+};
+
+
+
+#endif
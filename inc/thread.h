@@ -32,8 +32,10 @@ public:
    * \param Proc   Pointer to function used to run thread
    *
    * \param Arg    Argument to pass to the function
+   *
+   * \param Joinable Flag telling if the thread end can be waited for (detached otherwise)
    */
-  THREAD(void* (*Proc)(void*), void* Arg);
+  THREAD(void* (*Proc)(void*), void* Arg, bool Joinable = false);
 
 
 
@@ -58,6 +60,32 @@ public:
 
 
 
+  /**
+   * \brief        Waits for the end of the thread (joinable threads only)
+   */
+  void Join();
+
+
+
+  /**
+   * \brief        Binds the thread to a processor (before it starts)
+   *
+   * \param Cpu    Processor index
+   */
+  void SetAffinity(int Cpu);
+
+
+
+  /**
+   * \brief        Tells if the calling thread is this thread
+   *
+   * \return       \b true if called from the thread itself
+   * \return       \b false otherwise
+   */
+  bool IsCurrent() const;
+
+
+
 private:
 
   /**
@@ -85,6 +113,9 @@ private:
 
   /// Pointer to the argument the thread has to pass to its function
   void*           _Argument;
+
+  /// Flag telling if the thread is not running (never run, waited for or cancelled)
+  bool            _Ended;
 };
 
 
@@ -0,0 +1,146 @@
+/**
+ * \file upgrade.h
+ *
+ * \brief Header for sockets handover between processes (hot upgrade)
+ *
+ * \author Olivier de BLIC
+ */
+
+
+
+#ifndef UPGRADE_H
+#define UPGRADE_H
+
+// Standard headers
+#include <string>
+#include <vector>
+
+// Project headers
+#include "object.h"
+#include "manager.h"
+
+
+
+/// Enumeration of handover record kinds
+typedef enum
+{
+  RECORD_LISTENER,
+  RECORD_CONNECTION,
+  RECORD_LEASE,
+  RECORD_END,
+} RECORD_KIND;
+
+
+
+/// Handover record (sent along with the socket it describes)
+typedef struct
+{
+  /// Kind of record
+  int       Kind;
+
+  /// State of the connection (only the socket and the namespace for a listener, the namespace and the host identifier for a lease)
+  HANDOVER  State;
+
+  /// First identifier and number of identifiers of a range leased by the connection (lease records only)
+  unsigned int Range[2];
+} RECORD;
+
+
+
+/**
+ * \brief Unix socket used to hand the sockets over to a new process of the server
+ *
+ * A running server listens on the upgrade socket. A new process first connects to
+ * it : the running one then stops accepting, freezes its connections and sends the
+ * listening and connected sockets (SCM_RIGHTS) with their state, then the ranges
+ * of identifiers leased by the connections (records without any socket, each one
+ * naming its connection by namespace and host identifier), before exiting
+ * without closing them. Clients do not see any disconnection.
+ */
+class UPGRADE : public OBJECT
+{
+public:
+
+  /**
+   * \brief          Upgrade socket constructor
+   *
+   * \param Path     Path of the Unix socket
+   */
+  UPGRADE(const std::string& Path);
+
+
+
+  /**
+   * \brief          Upgrade socket destructor
+   */
+  virtual ~UPGRADE();
+
+
+
+  /**
+   * \brief          Takes the sockets over from a running process, if any
+   *
+   * \param Listeners    Received listening sockets (with their namespace)
+   * \param Connections  Received connections
+   * \param Leases       Identifiers leased by each received connection (in the order of the connections)
+   *
+   * \return         \b true if the sockets have been taken over
+   * \return         \b false if no process was running
+   */
+  bool TakeOver(std::vector<HANDOVER>& Listeners, std::vector<HANDOVER>& Connections, std::vector<ID_RANGES>& Leases);
+
+
+
+  /**
+   * \brief          Listens for a new process taking the sockets over
+   */
+  void Listen();
+
+
+
+  /**
+   * \brief          Hands the sockets over to the new process which has connected
+   *
+   * \param Listeners    Listening sockets (with their namespace)
+   * \param Connections  Frozen connections
+   * \param Leases       Identifiers leased by each frozen connection (in the order of the connections)
+   */
+  void HandOver(const std::vector<HANDOVER>& Listeners, const std::vector<HANDOVER>& Connections, const std::vector<ID_RANGES>& Leases);
+
+
+
+  /**
+   * \brief          Socket identifier getter
+   *
+   * \return         Socket identifier (-1 if not listening)
+   */
+  int GetId() const;
+
+
+
+private:
+
+  /**
+   * \brief          Sends records with their sockets in a single message
+   *
+   * \param PeerId   Socket identifier of the new process
+   * \param Records  Records to send
+   * \param Count    Number of records
+   */
+  static void SendRecords(int PeerId, const RECORD* Records, size_t Count);
+
+
+
+  /// Path of the Unix socket
+  const std::string  _Path;
+
+  /// Listening socket identifier
+  int                _SocketId;
+
+  /// Flag telling if the sockets have been handed over (the path then belongs to the new process)
+  bool               _HandedOver;
+};
+
+
+
+#endif
@@ -0,0 +1,221 @@
+/**
+ * \file workers.h
+ *
+ * \brief Header for worker processes (prefork mode)
+ *
+ * \author Olivier de BLIC
+ */
+
+
+
+#ifndef WORKERS_H
+#define WORKERS_H
+
+// Standard headers
+#include <vector>
+#include <sys/types.h>
+
+// Project headers
+#include "object.h"
+#include "allocator.h"
+
+
+
+/// State of a worker process shared with the master (one cache line each)
+typedef struct
+{
+  /// Number of connections run by the worker (all namespaces)
+  volatile int       Active;
+
+  /// Number of connections received from the master
+  volatile unsigned  Received;
+
+  /// Flag telling if the worker process is running
+  volatile int       Alive;
+
+  /// Padding up to the size of a cache line
+  char               Padding[64 - 3 * sizeof(int)];
+} WORKER_SLOT;
+
+
+
+/**
+ * \brief Pool of worker processes running the connections accepted by the master
+ *
+ * The master process accepts the connections and passes each socket (SCM_RIGHTS)
+ * to the least loaded worker over a Unix socket. A shared memory segment holds the
+ * number of connections of every worker and the host identifiers allocators (one per
+ * namespace), so that the connections counts and the identifiers stay server-wide. A worker crash
+ * only drops its own connections.
+ */
+class WORKERS : public OBJECT
+{
+public:
+
+  /**
+   * \brief          Workers pool constructor
+   *
+   * \param Count      Number of worker processes
+   * \param IdCapacity Number of host identifiers shared by the workers (in each namespace)
+   * \param Namespaces Number of identifiers namespaces
+   */
+  WORKERS(int Count, unsigned int IdCapacity, int Namespaces);
+
+
+
+  /**
+   * \brief          Workers pool destructor
+   */
+  virtual ~WORKERS();
+
+
+
+  /**
+   * \brief          Starts the worker processes (before any thread is created)
+   *
+   * \return         \b true in a worker process
+   * \return         \b false in the master process
+   */
+  bool Spawn();
+
+
+
+  /**
+   * \brief          Passes an accepted connection to the least loaded worker (master only)
+   *
+   * \param SocketId Socket identifier of the connection (still to close by the caller)
+   * \param Namespace Identifiers namespace of the connection
+   */
+  void Dispatch(int SocketId, int Namespace);
+
+
+
+  /**
+   * \brief          Receives a connection passed by the master (worker only)
+   *
+   * \param Namespace Identifiers namespace of the connection
+   *
+   * \return         Socket identifier of the connection (-1 if none is waiting)
+   */
+  int Receive(int& Namespace);
+
+
+
+  /**
+   * \brief          Stops the worker processes and waits for them (master only)
+   */
+  void Stop();
+
+
+
+  /**
+   * \brief          Collects the worker processes which have exited (master only)
+   *
+   * \param Exited   Indexes of the workers which have exited
+   */
+  void Reap(std::vector<int>& Exited);
+
+
+
+  /**
+   * \brief          Updates the number of connections run by the current worker
+   *
+   * \param Namespace Identifiers namespace of the connections
+   * \param Delta    Number of connections added (negative if removed)
+   */
+  void Update(int Namespace, int Delta);
+
+
+
+  /**
+   * \brief          Getter for the number of connections of the whole server
+   *
+   * \param Namespace Identifiers namespace
+   *
+   * \return         Number of connections of the namespace run by all the workers
+   */
+  int GetCount(int Namespace) const;
+
+
+
+  /**
+   * \brief          Getter for the host identifiers allocator shared by the workers
+   *
+   * \param Namespace Identifiers namespace
+   *
+   * \return         Reference to the allocator
+   */
+  ALLOCATOR& GetAllocator(int Namespace);
+
+
+
+  /**
+   * \brief          Getter for the socket identifier of the channel from the master (worker only)
+   *
+   * \return         Socket identifier (-1 if the master has left)
+   */
+  int GetChannelId() const;
+
+
+
+  /**
+   * \brief          Tells if the current process is the master
+   *
+   * \return         \b true in the master process
+   * \return         \b false in a worker process
+   */
+  bool IsMaster() const;
+
+
+
+  /**
+   * \brief          Getter for the index of the current worker process
+   *
+   * \return         Index of the worker (-1 in the master process)
+   */
+  int GetIndex() const;
+
+
+
+private:
+
+  /// Number of worker processes
+  const int             _Count;
+
+  /// Number of identifiers namespaces
+  const int             _Namespaces;
+
+  /// Index of the current worker process (-1 in the master process)
+  int                   _Index;
+
+  /// Process identifiers of the workers
+  std::vector<pid_t>    _Pids;
+
+  /// Sockets of the channels to the workers (master ends) or from the master (worker end)
+  std::vector<int>      _Channels;
+
+  /// Number of connections passed to each worker (master only)
+  std::vector<unsigned> _Dispatched;
+
+  /// Shared memory segment
+  void*                 _Memory;
+
+  /// Size of the shared memory segment (in bytes)
+  size_t                _Size;
+
+  /// States of the workers (in the shared memory segment)
+  WORKER_SLOT*          _Slots;
+
+  /// Connections counts of each worker and namespace (in the shared memory segment)
+  volatile int*         _Counts;
+
+  /// Distance between the counts of two workers (one cache line at least)
+  size_t                _Stride;
+
+  /// Host identifiers allocators of each namespace (in the shared memory segment)
+  std::vector<ALLOCATOR*> _Allocators;
+};
+
+
+
+#endif
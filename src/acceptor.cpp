@@ -0,0 +1,409 @@
+/**
+ * \file acceptor.cpp
+ *
+ * \brief Module for incoming connections acceptance
+ *
+ * \author Olivier de BLIC
+ */
+
+
+
+// Standard headers
+#include <string>
+#include <poll.h>
+#include <unistd.h>
+#include <sys/eventfd.h>
+
+// Project headers
+#include "acceptor.h"
+#include "application.h"
+#include "manager.h"
+#include "exception.h"
+#include "clock.h"
+#include "metrics.h"
+
+// Constant values
+#define POLL_TIMEOUT_MS  (1000)
+
+
+
+/**
+ * \brief          Acceptor constructor
+ *
+ * \param Manager  Reference to the manager of accepted connections
+ * \param PortNum  Local port number
+ * \param Backlog  Maximal length of the queue of pending connections
+ * \param Shared   Flag telling if other acceptors listen on the same port
+ * \param Namespace Identifiers namespace of the accepted connections
+ */
+ACCEPTOR::ACCEPTOR(MANAGER& Manager, unsigned short PortNum, int Backlog, bool Shared, int Namespace)
+: OBJECT("ACCEPTOR"), _Manager(Manager), _Listening(*new SOCKET()), _WakeId(eventfd(0, EFD_NONBLOCK | EFD_CLOEXEC)), _Thread(NULL), _Running(false), _Accepted(0), _Dropped(0), _Overflows(0), _MaxQueue(0), _Namespace(Namespace)
+{
+  if(_WakeId == -1)
+  {
+    throw EXCEPTION("Error creating acceptor wake up descriptor");
+  }
+
+  // Each acceptor has its own queue, the kernel balances the connections between them
+  if(Shared)
+  {
+    _Listening.SetReusePort();
+  }
+
+  _Listening.Bind(PortNum);
+
+  // Reconnecting clients may send their first data with the SYN
+  if(App().Param.GetFastOpen() > 0)
+  {
+    _Listening.SetFastOpen(App().Param.GetFastOpen());
+  }
+
+  // Connections are not accepted (and no thread spawned) until the client talks
+  if(App().Param.GetDeferAccept() > 0)
+  {
+    _Listening.SetDeferAccept(App().Param.GetDeferAccept());
+  }
+
+  int Idle;
+  int Interval;
+  int KeepCount;
+
+  // Dead peers are detected by the kernel, accepted sockets inherit these settings
+  if(App().Param.GetKeepAlive(Idle, Interval, KeepCount))
+  {
+    _Listening.SetKeepAlive(Idle, Interval, KeepCount);
+  }
+
+  if(App().Param.GetUserTimeout() > 0)
+  {
+    _Listening.SetUserTimeout(App().Param.GetUserTimeout());
+  }
+
+  _Listening.Listen(Backlog);
+
+  // The queue is drained until it would block
+  _Listening.SetNonBlocking();
+}
+
+
+
+/**
+ * \brief          Acceptor constructor (Unix domain socket, for clients on the same host)
+ *
+ * \param Manager  Reference to the manager of accepted connections
+ * \param Path     Path of the listening socket
+ * \param Backlog  Maximal length of the queue of pending connections
+ */
+ACCEPTOR::ACCEPTOR(MANAGER& Manager, const std::string& Path, int Backlog)
+: OBJECT("ACCEPTOR"), _Manager(Manager), _Listening(*new SOCKET(SOCKET_LOCAL)), _WakeId(eventfd(0, EFD_NONBLOCK | EFD_CLOEXEC)), _Thread(NULL), _Running(false), _Accepted(0), _Dropped(0), _Overflows(0), _MaxQueue(0), _Namespace(0)
+{
+  if(_WakeId == -1)
+  {
+    throw EXCEPTION("Error creating acceptor wake up descriptor");
+  }
+
+  // No TCP option here : the peer is on the same host
+  _Listening.Bind(Path);
+
+  _Listening.Listen(Backlog);
+
+  _Listening.SetNonBlocking();
+}
+
+
+
+/**
+ * \brief          Acceptor constructor (listening socket taken over from another process)
+ *
+ * \param Manager  Reference to the manager of accepted connections
+ * \param SocketId Identifier of the listening socket
+ * \param Namespace Identifiers namespace of the accepted connections
+ */
+ACCEPTOR::ACCEPTOR(MANAGER& Manager, int SocketId, int Namespace)
+: OBJECT("ACCEPTOR"), _Manager(Manager), _Listening(*new SOCKET(SocketId)), _WakeId(eventfd(0, EFD_NONBLOCK | EFD_CLOEXEC)), _Thread(NULL), _Running(false), _Accepted(0), _Dropped(0), _Overflows(0), _MaxQueue(0), _Namespace(Namespace)
+{
+  if(_WakeId == -1)
+  {
+    throw EXCEPTION("Error creating acceptor wake up descriptor");
+  }
+
+  // Options, binding and listening state come along with the socket
+  _Listening.SetNonBlocking();
+}
+
+
+
+/**
+ * \brief          Acceptor destructor
+ */
+ACCEPTOR::~ACCEPTOR()
+{
+  Stop();
+
+  delete &_Listening;
+
+  close(_WakeId);
+}
+
+
+
+/**
+ * \brief          Starts the accept loop in a dedicated thread
+ *
+ * \param Cpu      Processor the thread (and the connections it accepts) runs on, -1 for any
+ */
+void ACCEPTOR::Start(int Cpu)
+{
+  _Running = true;
+
+  _Thread = new THREAD(RunTask, (void*)this, true);
+
+  // Connection threads inherit the affinity of the thread creating them
+  if(Cpu >= 0)
+  {
+    _Thread->SetAffinity(Cpu);
+  }
+
+  _Thread->Run();
+}
+
+
+
+/**
+ * \brief          Stops the accept loop and waits for its thread
+ */
+void ACCEPTOR::Stop()
+{
+  if(_Thread == NULL)
+  {
+    return;
+  }
+
+  _Running = false;
+
+  // Wakes up the thread waiting for connections (the socket itself is left untouched)
+  eventfd_write(_WakeId, 1);
+
+  _Thread->Join();
+
+  delete _Thread;
+
+  _Thread = NULL;
+}
+
+
+
+/**
+ * \brief          Steers new connections of the port to the acceptor of the receiving processor
+ *
+ * \param Count    Number of acceptors sharing the port
+ */
+void ACCEPTOR::SetCpuSteering(int Count)
+{
+  _Listening.SetCpuSteering(Count);
+}
+
+
+
+/**
+ * \brief          Waits for pending connections and accepts them
+ *
+ * \param TimeoutMs Maximal waiting time (in milliseconds)
+ */
+void ACCEPTOR::Poll(int TimeoutMs)
+{
+  struct pollfd Checkers[2] = { {_Listening.GetId(), POLLIN, 0}, {_WakeId, POLLIN, 0} };
+
+  if(poll(Checkers, 2, TimeoutMs) <= 0 || ! (Checkers[0].revents & POLLIN))
+  {
+    return;
+  }
+
+  int Length;
+  int Backlog;
+
+  // The queue state is sampled before draining it
+  _Listening.GetAcceptQueue(Length, Backlog);
+
+  if(Length > _MaxQueue)
+  {
+    _MaxQueue = Length;
+  }
+
+  // The kernel accepts one connection more than the backlog before dropping SYNs
+  if(Length > Backlog)
+  {
+    _Overflows++;
+
+    METRICS::Add(METRIC_ACCEPT_OVERFLOWS);
+
+    LOG_LINE(LOG_WARN, "Accept queue is full (%d/%d), %u overflow(s) so far", Length, Backlog, _Overflows);
+  }
+
+  long long Begin = CLOCK::GetMonotonicNs();
+
+  int Count = DrainQueue();
+
+  // Setup cost of the batch : accept, socket wrapping and thread spawning
+  long ElapsedUs = (CLOCK::GetMonotonicNs() - Begin) / 1000;
+
+  LOG_LINE(LOG_INFO, "%d new client(s) connected in %d us, %u so far (highest queue length is %d)", Count, ElapsedUs, _Accepted, _MaxQueue);
+}
+
+
+
+/**
+ * \brief          Getter for the listening socket identifier
+ *
+ * \return         Socket identifier
+ */
+int ACCEPTOR::GetSocketId() const
+{
+  return _Listening.GetId();
+}
+
+
+
+/**
+ * \brief          Getter for the identifiers namespace
+ *
+ * \return         Namespace of the accepted connections
+ */
+int ACCEPTOR::GetNamespace() const
+{
+  return _Namespace;
+}
+
+
+
+/**
+ * \brief          Getter for the number of accepted connections
+ *
+ * \return         Number of accepted connections
+ */
+unsigned long ACCEPTOR::GetAccepted() const
+{
+  return _Accepted;
+}
+
+
+
+/**
+ * \brief          Getter for the number of dropped connections
+ *
+ * \return         Number of connections closed at once (descriptors exhausted)
+ */
+unsigned long ACCEPTOR::GetDropped() const
+{
+  return _Dropped;
+}
+
+
+
+/**
+ * \brief          Getter for the number of times the accept queue was found full
+ *
+ * \return         Number of accept queue overflows
+ */
+unsigned long ACCEPTOR::GetOverflows() const
+{
+  return _Overflows;
+}
+
+
+
+/**
+ * \brief          Task for the accept loop
+ *
+ * \param  Arg     Pointer to the concerned acceptor
+ *
+ * \return         NULL
+ */
+void* ACCEPTOR::RunTask(void* Arg)
+{
+  // Equivalent of 'this' pointer in a non-static method
+  ACCEPTOR& Acceptor = *(ACCEPTOR*)Arg;
+
+  while(Acceptor._Running)
+  {
+    try
+    {
+      Acceptor.Poll(POLL_TIMEOUT_MS);
+    }
+
+    catch(EXCEPTION Exception)
+    {
+      if(Acceptor._Running)
+      {
+        App().Console.LogExcept(Exception);
+      }
+    }
+  }
+
+  return NULL;
+}
+
+
+
+/**
+ * \brief          Accepts all the pending connections (until the queue is empty)
+ *
+ * \return         Number of accepted connections
+ */
+int ACCEPTOR::DrainQueue()
+{
+  int Count = 0;
+
+  while(true)
+  {
+    SOCKET* ConnectedSock;
+
+    try
+    {
+      ConnectedSock = _Listening.TryAccept();
+    }
+
+    catch(EXCEPTION Exception)
+    {
+      _Dropped++;
+
+      METRICS::Add(METRIC_ACCEPT_ERRORS);
+
+      App().Console.LogExcept(Exception);
+
+      // The remaining connections will be accepted at next poll
+      break;
+    }
+
+    if(ConnectedSock == NULL)
+    {
+      break;
+    }
+
+    try
+    {
+      _Manager.Create(*ConnectedSock, _Namespace);
+    }
+
+    catch(EXCEPTION Exception)
+    {
+      _Dropped++;
+
+      METRICS::Add(METRIC_ACCEPT_ERRORS);
+
+      App().Console.LogExcept(Exception);
+
+      delete ConnectedSock;
+
+      continue;
+    }
+
+    Count++;
+  }
+
+  _Accepted += Count;
+
+  METRICS::Add(METRIC_ACCEPTED, Count);
+
+  return Count;
+}
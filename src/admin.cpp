@@ -0,0 +1,442 @@
+/**
+ * \file admin.cpp
+ *
+ * \brief Module for the administration endpoint (metrics exposition)
+ *
+ * \author Olivier de BLIC
+ */
+
+
+
+// Standard headers
+#include <string>
+#include <vector>
+#include <string.h>
+#include <unistd.h>
+#include <errno.h>
+#include <poll.h>
+#include <sys/socket.h>
+#include <netinet/in.h>
+
+// Project headers
+#include "admin.h"
+#include "application.h"
+#include "exception.h"
+#include "metrics.h"
+#include "clock.h"
+
+// Constant values
+#define ADMIN_BACKLOG           (16)
+#define ADMIN_CLIENTS_MAX       (16)
+#define ADMIN_REQUEST_MAX       (8192)
+#define ADMIN_TIMEOUT_MS        (5000)
+#define ADMIN_REPLY_RESERVE     (4096)
+#define METRICS_PATH            "/metrics"
+#define CONTENT_TYPE            "text/plain; version=0.0.4"
+
+
+
+/**
+ * \brief          Appends an integer to a text (without going through a stream)
+ *
+ * \param Text     Buffer the integer is appended to
+ * \param Value    Integer
+ */
+static void AppendInteger(std::string& Text, long long Value)
+{
+  char Digits[24];
+
+  int Count = 0;
+
+  unsigned long long Magnitude = (Value < 0 ? -(unsigned long long)Value : Value);
+
+  do
+  {
+    Digits[Count++] = '0' + Magnitude % 10;
+    Magnitude /= 10;
+  }
+  while(Magnitude != 0);
+
+  if(Value < 0)
+  {
+    Text += '-';
+  }
+
+  while(Count > 0)
+  {
+    Text += Digits[--Count];
+  }
+}
+
+
+
+/**
+ * \brief          Appends the header of a metric
+ *
+ * \param Text     Buffer the header is appended to
+ * \param Info     Description of the metric
+ */
+static void AppendHeader(std::string& Text, const METRIC_INFO& Info)
+{
+  static const char* Kinds[] = { "counter", "gauge", "summary" };
+
+  Text += "# HELP ";
+  Text += Info.Name;
+  Text += ' ';
+  Text += Info.Help;
+  Text += "\n# TYPE ";
+  Text += Info.Name;
+  Text += ' ';
+  Text += Kinds[Info.Kind];
+  Text += '\n';
+}
+
+
+
+/**
+ * \brief          Appends a sample of a metric
+ *
+ * \param Text     Buffer the sample is appended to
+ * \param Name     Name of the metric
+ * \param Suffix   Suffix of the name, then labels
+ * \param Value    Value of the sample
+ */
+static void AppendSample(std::string& Text, const char* Name, const char* Suffix, long long Value)
+{
+  Text += Name;
+  Text += Suffix;
+  Text += ' ';
+  AppendInteger(Text, Value);
+  Text += '\n';
+}
+
+
+
+/**
+ * \brief          Administration endpoint constructor
+ *
+ * \param PortNum  Port to listen on
+ * \param Stats    Stats page whose slots are added up (NULL to expose the metrics of this process)
+ */
+ADMIN::ADMIN(unsigned short PortNum, const STATPAGE* Stats)
+: OBJECT("ADMIN"), _SocketId(-1), _Stats(Stats)
+{
+  _SocketId = socket(AF_INET, SOCK_STREAM | SOCK_NONBLOCK | SOCK_CLOEXEC, 0);
+
+  if(_SocketId == -1)
+  {
+    throw EXCEPTION("Error creating admin socket");
+  }
+
+  int Enabled = 1;
+
+  // A new process of the server listens along with the previous one until it is handed the clients over
+  setsockopt(_SocketId, SOL_SOCKET, SO_REUSEADDR, &Enabled, sizeof(Enabled));
+  setsockopt(_SocketId, SOL_SOCKET, SO_REUSEPORT, &Enabled, sizeof(Enabled));
+
+  sockaddr_in Addr;
+
+  memset(&Addr, 0, sizeof(Addr));
+  Addr.sin_family = AF_INET;
+  Addr.sin_addr.s_addr = htonl(INADDR_ANY);
+  Addr.sin_port = htons(PortNum);
+
+  if(bind(_SocketId, (sockaddr*)&Addr, sizeof(Addr)) == -1 || listen(_SocketId, ADMIN_BACKLOG) == -1)
+  {
+    close(_SocketId);
+    throw EXCEPTION("Error listening on admin socket");
+  }
+
+  LOG_LINE(LOG_INFO, "Metrics exposed on port %d", (int)PortNum);
+}
+
+
+
+/**
+ * \brief          Administration endpoint destructor
+ */
+ADMIN::~ADMIN()
+{
+  for(size_t Index = 0; Index < _Clients.size(); Index++)
+  {
+    close(_Clients[Index].SocketId);
+  }
+
+  close(_SocketId);
+}
+
+
+
+/**
+ * \brief          Adds the sockets to poll
+ *
+ * \param Checkers Poll entries the ones of the endpoint are appended to
+ */
+void ADMIN::AddChecks(std::vector<struct pollfd>& Checkers) const
+{
+  // Once full, waiting clients stay in the backlog : polled, they would wake the loop up at once forever
+  struct pollfd Checker = {_SocketId, (short)(_Clients.size() < ADMIN_CLIENTS_MAX ? POLLIN : 0), 0};
+
+  Checkers.push_back(Checker);
+
+  for(size_t Index = 0; Index < _Clients.size(); Index++)
+  {
+    Checker.fd = _Clients[Index].SocketId;
+    Checker.events = (_Clients[Index].Reply.empty() ? POLLIN : POLLOUT);
+
+    Checkers.push_back(Checker);
+  }
+}
+
+
+
+/**
+ * \brief          Serves the clients, according to the poll results
+ *
+ * \param Checkers Poll entries
+ * \param First    Index of the first entry of the endpoint (the listening socket)
+ */
+void ADMIN::Process(const std::vector<struct pollfd>& Checkers, size_t First)
+{
+  long long Now = CLOCK::GetCoarseMs();
+
+  std::vector<ADMIN_CLIENT> Clients;
+
+  // Clients are in the same order as their poll entries
+  for(size_t Index = 0; Index < _Clients.size(); Index++)
+  {
+    ADMIN_CLIENT& Client = _Clients[Index];
+
+    short Events = Checkers[First + 1 + Index].revents;
+
+    bool Served = true;
+
+    if(Events & (POLLERR | POLLHUP | POLLNVAL))
+    {
+      Served = false;
+    }
+    else if(Events & POLLIN)
+    {
+      Served = ReadRequest(Client);
+    }
+    else if(Events & POLLOUT)
+    {
+      Served = SendReply(Client);
+    }
+
+    if(Served && Now < Client.DeadlineMs)
+    {
+      Clients.push_back(Client);
+    }
+    else
+    {
+      close(Client.SocketId);
+    }
+  }
+
+  _Clients.swap(Clients);
+
+  if(Checkers[First].revents & POLLIN)
+  {
+    AcceptClients();
+  }
+}
+
+
+
+/**
+ * \brief          Writes the metrics in the Prometheus text format
+ *
+ * \param Text     Buffer the metrics are appended to
+ */
+void ADMIN::Expose(std::string& Text) const
+{
+  std::vector<long long> Values(METRIC_ID_COUNT, 0);
+
+  std::vector<HISTOGRAM_DATA> Histograms(HISTOGRAM_ID_COUNT);
+
+  if(_Stats == NULL)
+  {
+    // Shards and histograms are read without any lock : the connections are never slowed down by a scrape
+    METRICS::ReadAll(&Values[0]);
+
+    for(int Id = 0; Id < HISTOGRAM_ID_COUNT; Id++)
+    {
+      METRICS::ReadHistogram((HISTOGRAM_ID)Id, Histograms[Id]);
+    }
+  }
+  else
+  {
+    memset(&Histograms[0], 0, Histograms.size() * sizeof(HISTOGRAM_DATA));
+
+    STAT_SNAPSHOT Snapshot;
+
+    // Every process copies its metrics to its own slot : the server is the sum of them (as read by seastar-stat)
+    for(int Slot = 0; Slot < _Stats->GetSlotCount(); Slot++)
+    {
+      _Stats->Snapshot(Slot, Snapshot);
+
+      if(Snapshot.Pid == 0)
+      {
+        continue;
+      }
+
+      for(int Id = 0; Id < METRIC_ID_COUNT; Id++)
+      {
+        Values[Id] += Snapshot.Values[Id];
+      }
+
+      for(int Id = 0; Id < HISTOGRAM_ID_COUNT; Id++)
+      {
+        HISTOGRAM_DATA& Data = Histograms[Id];
+
+        for(int Bucket = 0; Bucket < HISTOGRAM_BUCKETS; Bucket++)
+        {
+          Data.Counts[Bucket] += Snapshot.Histograms[Id].Counts[Bucket];
+        }
+
+        Data.Count += Snapshot.Histograms[Id].Count;
+        Data.Sum += Snapshot.Histograms[Id].Sum;
+
+        if(Snapshot.Histograms[Id].Max > Data.Max)
+        {
+          Data.Max = Snapshot.Histograms[Id].Max;
+        }
+      }
+    }
+  }
+
+  for(int Id = 0; Id < METRIC_ID_COUNT; Id++)
+  {
+    const METRIC_INFO& Info = METRICS::GetInfo((METRIC_ID)Id);
+
+    AppendHeader(Text, Info);
+    AppendSample(Text, Info.Name, "", Values[Id]);
+  }
+
+  for(int Id = 0; Id < HISTOGRAM_ID_COUNT; Id++)
+  {
+    const METRIC_INFO& Info = METRICS::GetInfo((HISTOGRAM_ID)Id);
+
+    const HISTOGRAM_DATA& Data = Histograms[Id];
+
+    AppendHeader(Text, Info);
+    AppendSample(Text, Info.Name, "{quantile=\"0.5\"}", HISTOGRAM::GetPercentile(Data, 0.5));
+    AppendSample(Text, Info.Name, "{quantile=\"0.99\"}", HISTOGRAM::GetPercentile(Data, 0.99));
+    AppendSample(Text, Info.Name, "{quantile=\"0.999\"}", HISTOGRAM::GetPercentile(Data, 0.999));
+    AppendSample(Text, Info.Name, "{quantile=\"1\"}", Data.Max);
+    AppendSample(Text, Info.Name, "_sum", Data.Sum);
+    AppendSample(Text, Info.Name, "_count", Data.Count);
+  }
+}
+
+
+
+/**
+ * \brief          Accepts the waiting clients
+ */
+void ADMIN::AcceptClients()
+{
+  while(_Clients.size() < ADMIN_CLIENTS_MAX)
+  {
+    int SocketId = accept4(_SocketId, NULL, NULL, SOCK_NONBLOCK | SOCK_CLOEXEC);
+
+    if(SocketId == -1)
+    {
+      // Nothing left to accept, or an aborted connection : the others are accepted at the next poll
+      return;
+    }
+
+    ADMIN_CLIENT Client;
+
+    Client.SocketId = SocketId;
+    Client.Offset = 0;
+    Client.DeadlineMs = CLOCK::GetCoarseMs() + ADMIN_TIMEOUT_MS;
+
+    _Clients.push_back(Client);
+  }
+}
+
+
+
+/**
+ * \brief          Reads the request of a client, and prepares the reply once complete
+ *
+ * \param Client   Client
+ *
+ * \return         \b true if the client is still served
+ * \return         \b false if it has to be closed
+ */
+bool ADMIN::ReadRequest(ADMIN_CLIENT& Client)
+{
+  char Buffer[1024];
+
+  ssize_t Count = recv(Client.SocketId, Buffer, sizeof(Buffer), 0);
+
+  if(Count <= 0)
+  {
+    return (Count < 0 && (errno == EAGAIN || errno == EINTR));
+  }
+
+  Client.Request.append(Buffer, Count);
+
+  if(Client.Request.find("\r\n\r\n") == std::string::npos && Client.Request.find("\n\n") == std::string::npos)
+  {
+    return (Client.Request.length() < ADMIN_REQUEST_MAX);
+  }
+
+  std::string Body;
+  const char* Status;
+
+  // Only the request line matters : "GET /metrics HTTP/1.1", possibly with a query string
+  if(Client.Request.compare(0, 4, "GET ") != 0)
+  {
+    Status = "405 Method Not Allowed";
+  }
+  else if(Client.Request.compare(4, sizeof(METRICS_PATH) - 1, METRICS_PATH) != 0 ||
+          strchr(" ?", Client.Request[4 + sizeof(METRICS_PATH) - 1]) == NULL)
+  {
+    Status = "404 Not Found";
+  }
+  else
+  {
+    Status = "200 OK";
+
+    Body.reserve(ADMIN_REPLY_RESERVE);
+
+    Expose(Body);
+  }
+
+  Client.Reply = "HTTP/1.1 ";
+  Client.Reply += Status;
+  Client.Reply += "\r\nContent-Type: " CONTENT_TYPE "\r\nContent-Length: ";
+  AppendInteger(Client.Reply, Body.length());
+  Client.Reply += "\r\nConnection: close\r\n\r\n";
+  Client.Reply += Body;
+
+  return SendReply(Client);
+}
+
+
+
+/**
+ * \brief          Sends the reply to a client
+ *
+ * \param Client   Client
+ *
+ * \return         \b true if the reply is still being sent
+ * \return         \b false if the client has to be closed
+ */
+bool ADMIN::SendReply(ADMIN_CLIENT& Client)
+{
+  ssize_t Count = send(Client.SocketId, Client.Reply.data() + Client.Offset, Client.Reply.length() - Client.Offset, MSG_NOSIGNAL);
+
+  if(Count < 0)
+  {
+    return (errno == EAGAIN || errno == EINTR);
+  }
+
+  Client.Offset += Count;
+
+  return (Client.Offset < Client.Reply.length());
+}
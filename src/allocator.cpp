@@ -0,0 +1,297 @@
+/**
+ * \file allocator.cpp
+ *
+ * \brief Module for unique identifiers allocation
+ *
+ * \author Olivier de BLIC
+ */
+
+
+
+// Standard headers
+#include <stdlib.h>
+#include <string.h>
+
+// Project headers
+#include "allocator.h"
+#include "exception.h"
+
+// Constant values
+#define WORD_BITS               (64)
+#define CACHE_LINE_SIZE         (64)
+
+
+
+/**
+ * \brief          Allocator constructor
+ *
+ * \param Capacity Number of identifiers (rounded up to a multiple of 64)
+ * \param Memory   Memory area of GetMemorySize() bytes holding the state (allocated if NULL)
+ * \param Init     Flag telling if the state has to be initialized (always for an allocated one)
+ */
+ALLOCATOR::ALLOCATOR(unsigned int Capacity, void* Memory, bool Init)
+: OBJECT("ALLOCATOR"), _WordCount((Capacity + WORD_BITS - 1) / WORD_BITS), _Owned(NULL)
+{
+  if(_WordCount == 0)
+  {
+    throw EXCEPTION("Allocator capacity is null");
+  }
+
+  if(Memory == NULL)
+  {
+    Memory = _Owned = malloc(GetMemorySize(Capacity));
+
+    Init = true;
+
+    if(Memory == NULL)
+    {
+      throw EXCEPTION("Error allocating identifiers bitmap");
+    }
+  }
+
+  // The cursor and the leased count have their own cache line, apart from the bitmap
+  _Cursor = (volatile unsigned int*)Memory;
+  _Leased = _Cursor + 1;
+  _Words = (volatile unsigned long long*)((char*)Memory + CACHE_LINE_SIZE);
+
+  if(Init)
+  {
+    memset(Memory, 0, GetMemorySize(Capacity));
+  }
+}
+
+
+
+/**
+ * \brief          Allocator destructor
+ */
+ALLOCATOR::~ALLOCATOR()
+{
+  free(_Owned);
+}
+
+
+
+/**
+ * \brief          Size of the memory area needed by an allocator
+ *
+ * \param Capacity Number of identifiers
+ *
+ * \return         Size of the state (in bytes)
+ */
+size_t ALLOCATOR::GetMemorySize(unsigned int Capacity)
+{
+  return CACHE_LINE_SIZE + ((Capacity + WORD_BITS - 1) / WORD_BITS) * sizeof(unsigned long long);
+}
+
+
+
+/**
+ * \brief          Allocates a new identifier
+ *
+ * \return         Identifier
+ */
+unsigned int ALLOCATOR::Allocate()
+{
+  unsigned int Start = *_Cursor % _WordCount;
+
+  for(unsigned int Scanned = 0; Scanned < _WordCount; Scanned++)
+  {
+    unsigned int Index = (Start + Scanned) % _WordCount;
+
+    unsigned long long Word = _Words[Index];
+
+    // Several threads may race for the same word : the claim is retried until it is full
+    while(~Word != 0)
+    {
+      unsigned long long Mask = ~Word & (Word + 1);
+
+      Word = __sync_fetch_and_or(&_Words[Index], Mask);
+
+      if((Word & Mask) == 0)
+      {
+        *_Cursor = Index;
+
+        return Index * WORD_BITS + __builtin_ctzll(Mask);
+      }
+    }
+  }
+
+  throw EXCEPTION("No more identifier available");
+}
+
+
+
+/**
+ * \brief          Allocates several identifiers, as few ranges as possible
+ *
+ * \param Count    Number of identifiers
+ * \param Ranges   Allocated ranges (appended, adjacent ranges are merged)
+ */
+void ALLOCATOR::Allocate(unsigned int Count, ID_RANGES& Ranges)
+{
+  ID_RANGES Claimed;
+
+  unsigned int Start = *_Cursor % _WordCount;
+
+  for(unsigned int Scanned = 0; Scanned < _WordCount && Count > 0; Scanned++)
+  {
+    unsigned int Index = (Start + Scanned) % _WordCount;
+
+    unsigned long long Word = _Words[Index];
+
+    // Each run of free bits is claimed at once : free words give whole ranges of 64
+    while(~Word != 0 && Count > 0)
+    {
+      unsigned int Low = __builtin_ctzll(~Word);
+
+      unsigned int Run = ((Word >> Low) == 0 ? WORD_BITS - Low : __builtin_ctzll(Word >> Low));
+
+      unsigned int Take = (Run < Count ? Run : Count);
+
+      unsigned long long Mask = (Take == WORD_BITS ? ~0ULL : ((1ULL << Take) - 1)) << Low;
+
+      unsigned long long Previous = __sync_val_compare_and_swap(&_Words[Index], Word, Word | Mask);
+
+      if(Previous != Word)
+      {
+        // Another thread has changed the word : the runs are computed again
+        Word = Previous;
+        continue;
+      }
+
+      Word |= Mask;
+      Count -= Take;
+
+      unsigned int First = Index * WORD_BITS + Low;
+
+      if(! Claimed.empty() && Claimed.back().first + Claimed.back().second == First)
+      {
+        Claimed.back().second += Take;
+      }
+      else
+      {
+        Claimed.push_back(std::make_pair(First, Take));
+      }
+
+      *_Cursor = Index;
+    }
+  }
+
+  if(Count > 0)
+  {
+    Release(Claimed);
+
+    throw EXCEPTION("No more identifier available");
+  }
+
+  Ranges.insert(Ranges.end(), Claimed.begin(), Claimed.end());
+}
+
+
+
+/**
+ * \brief          Claims a given identifier
+ *
+ * \param Id       Identifier
+ *
+ * \return         \b true if the identifier was free and is now allocated
+ * \return         \b false if the identifier is already in use
+ */
+bool ALLOCATOR::Reserve(unsigned int Id)
+{
+  if(Id / WORD_BITS >= _WordCount)
+  {
+    return false;
+  }
+
+  unsigned long long Mask = 1ULL << (Id % WORD_BITS);
+
+  return ((__sync_fetch_and_or(&_Words[Id / WORD_BITS], Mask) & Mask) == 0);
+}
+
+
+
+/**
+ * \brief          Releases an identifier
+ *
+ * \param Id       Identifier
+ */
+void ALLOCATOR::Release(unsigned int Id)
+{
+  if(Id / WORD_BITS < _WordCount)
+  {
+    __sync_fetch_and_and(&_Words[Id / WORD_BITS], ~(1ULL << (Id % WORD_BITS)));
+  }
+}
+
+
+
+/**
+ * \brief          Releases ranges of identifiers
+ *
+ * \param Ranges   Ranges allocated together
+ */
+void ALLOCATOR::Release(const ID_RANGES& Ranges)
+{
+  for(size_t Range = 0; Range < Ranges.size(); Range++)
+  {
+    unsigned int Id = Ranges[Range].first;
+    unsigned int End = Ranges[Range].first + Ranges[Range].second;
+
+    // Bits are cleared a word at a time
+    while(Id < End && Id / WORD_BITS < _WordCount)
+    {
+      unsigned int Low = Id % WORD_BITS;
+      unsigned int Take = (End - Id < WORD_BITS - Low ? End - Id : WORD_BITS - Low);
+
+      unsigned long long Mask = (Take == WORD_BITS ? ~0ULL : ((1ULL << Take) - 1)) << Low;
+
+      __sync_fetch_and_and(&_Words[Id / WORD_BITS], ~Mask);
+
+      Id += Take;
+    }
+  }
+}
+
+
+
+/**
+ * \brief          Counts identifiers as leased, within a limit shared by all the owners
+ *
+ * \param Count    Number of identifiers
+ * \param Limit    Highest number of identifiers leased at the same time
+ *
+ * \return         \b true if the identifiers are counted
+ * \return         \b false if the limit would be exceeded (nothing is counted)
+ */
+bool ALLOCATOR::AddLeased(unsigned int Count, unsigned int Limit)
+{
+  unsigned int Leased = *_Leased;
+
+  while(Count <= Limit && Leased <= Limit - Count)
+  {
+    unsigned int Previous = __sync_val_compare_and_swap(_Leased, Leased, Leased + Count);
+
+    if(Previous == Leased)
+    {
+      return true;
+    }
+
+    Leased = Previous;
+  }
+
+  return false;
+}
+
+
+
+/**
+ * \brief          Stops counting identifiers as leased
+ *
+ * \param Count    Number of identifiers
+ */
+void ALLOCATOR::RemoveLeased(unsigned int Count)
+{
+  __sync_fetch_and_sub(_Leased, Count);
+}
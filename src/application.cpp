@@ -12,16 +12,31 @@
 #include <signal.h>
 #include <stdlib.h>
 #include <stdio.h>
+#include <string.h>
 #include <execinfo.h>
+#include <unistd.h>
+#include <poll.h>
+#include <sys/signalfd.h>
+#include <vector>
 
 // Project headers
 #include "application.h"
 #include "object.h"
 #include "socket.h"
+#include "acceptor.h"
 #include "connection.h"
+#include "upgrade.h"
+#include "workers.h"
+#include "publisher.h"
+#include "statpage.h"
 #include "exception.h"
+#include "clock.h"
+#include "metrics.h"
+#include "admin.h"
 
 // Constant values
+#define POLL_TIMEOUT_MS    (1000)
+#define STATS_INTERVAL_MS  (10)
 
 
 
@@ -29,7 +44,7 @@
  * \brief          Application constructor
  */
 APPLICATION::APPLICATION()
-: OBJECT("APPLICATION"), _Running(true)
+: OBJECT("APPLICATION"), _Running(true), _SignalId(-1), _Workers(NULL), _Publisher(NULL), _Stats(NULL)
 {
 }
 
@@ -40,6 +55,18 @@ APPLICATION::APPLICATION()
  */
 APPLICATION::~APPLICATION()
 {
+  Console.Stop();
+
+  if(_SignalId != -1)
+  {
+    close(_SignalId);
+  }
+
+  delete _Workers;
+
+  delete _Publisher;
+
+  delete _Stats;
 }
 
 
@@ -63,6 +90,27 @@ int APPLICATION::Main(int ArgCnt, char *ArgVal[])
 
     Console.SetVerbose(Param.GetVerbose());
 
+    if(! Param.GetBinaryLog().empty())
+    {
+      Console.SetBinary(Param.GetBinaryLog());
+    }
+
+    if(! Param.GetLogFile().empty())
+    {
+      int SegmentMb;
+      int PeriodSec;
+
+      Param.GetLogRotation(SegmentMb, PeriodSec);
+
+      Console.SetFile(Param.GetLogFile(), (size_t)SegmentMb << 20, PeriodSec);
+    }
+
+    // Calibrated before any thread reads the clock
+    if(Param.GetTsc() && ! CLOCK::EnableTsc())
+    {
+      Console.LogWarn("No invariant TSC, the kernel clock is kept");
+    }
+
     if(Param.GetHelp())
     {
       Console.PrintHelp();
@@ -110,26 +158,356 @@ int APPLICATION::Main(int ArgCnt, char *ArgVal[])
  */
 void APPLICATION::RunServer(int PortNum)
 {
-  SOCKET ListeningSocket;
+  int CpuCount = sysconf(_SC_NPROCESSORS_ONLN);
+
+  // The steering program gives the connection received by the processor N to the listener N of the group
+  int Steered = (Param.GetSteering() ? CpuCount : 0);
+
+  std::vector<ACCEPTOR*> Acceptors;
+
+  UPGRADE* Upgrade = NULL;
+
+  std::vector<HANDOVER> Listeners;
+
+  std::vector<HANDOVER> Connections;
+
+  std::vector<ID_RANGES> Leases;
+
+  bool TakenOver = false;
+
+  const std::vector<unsigned short>& Endpoints = Param.GetEndpoints();
+
+  // The main port is the first namespace, each additional endpoint has its own one
+  Manager.SetNamespaces(1 + Endpoints.size());
+
+  if(Param.GetSessionTtl() > 0)
+  {
+    Manager.EnableSessions(Param.GetSessionTtl());
+  }
+
+  if(! Param.GetUpgradePath().empty())
+  {
+    Upgrade = new UPGRADE(Param.GetUpgradePath());
+
+    TakenOver = Upgrade->TakeOver(Listeners, Connections, Leases);
+  }
+
+  // The previous process has stopped updating its page once the sockets are taken over
+  if(! Param.GetSharedPath().empty())
+  {
+    _Publisher = new PUBLISHER(Param.GetSharedPath(), Param.GetWorkers() > 0 ? Param.GetWorkers() : 1, MANAGER::GetIdCapacity());
+
+    Manager.Publish(*_Publisher);
+  }
+
+  // One slot for this process and one for each worker, all of them mapping the page before the fork
+  if(! Param.GetStatsPath().empty())
+  {
+    _Stats = new STATPAGE(Param.GetStatsPath(), 1 + Param.GetWorkers(), STATS_INTERVAL_MS);
+
+    LOG_LINE(LOG_INFO, "Metrics now mirrored in %s", Param.GetStatsPath());
+  }
+
+  // Worker processes are forked before any thread is created
+  if(Param.GetWorkers() > 0)
+  {
+    _Workers = new WORKERS(Param.GetWorkers(), MANAGER::GetIdCapacity(), 1 + Endpoints.size());
+
+    bool Worker = _Workers->Spawn();
+
+    Manager.Attach(*_Workers);
+
+    if(Worker)
+    {
+      if(_Publisher != NULL)
+      {
+        _Publisher->SetShard(_Workers->GetIndex());
+      }
+
+      if(_Stats != NULL)
+      {
+        _Stats->SetSlot(1 + _Workers->GetIndex());
+      }
+
+      RunWorker();
+      return;
+    }
+  }
+
+  // Log lines are written by a thread of the process, hence once the workers are forked
+  Console.Start();
+
+  if(TakenOver)
+  {
+    // Listening sockets keep their order, hence the steering program attached to the group stays valid
+    for(size_t Index = 0; Index < Listeners.size(); Index++)
+    {
+      Acceptors.push_back(new ACCEPTOR(Manager, Listeners[Index].SocketId, Listeners[Index].Namespace));
+    }
+
+    for(size_t Index = 0; Index < Connections.size(); Index++)
+    {
+      try
+      {
+        Manager.Adopt(*new SOCKET(Connections[Index].SocketId), Connections[Index], Leases[Index]);
+      }
+
+      catch(EXCEPTION Exception)
+      {
+        Console.LogExcept(Exception);
+      }
+    }
+
+    LOG_LINE(LOG_INFO, "%u client(s) and %u listening socket(s) taken over", Connections.size(), Listeners.size());
+  }
+  else
+  {
+    int Count = Param.GetAcceptors();
+
+    // Any other group size would send connections to the acceptor of another processor
+    if(Steered > 0 && Count != Steered)
+    {
+      LOG_LINE(LOG_WARN, "%d acceptor(s) instead of %d, one per processor for the steering", Steered, Count);
+
+      Count = Steered;
+    }
+
+    // Acceptors are bound in order : the steering program selects them by position
+    for(int Index = 0; Index < Count; Index++)
+    {
+      Acceptors.push_back(new ACCEPTOR(Manager, PortNum, Param.GetBacklog(), Count > 1));
+    }
+
+    // A single listener is not in a reuse port group, nothing to steer
+    if(Steered > 1)
+    {
+      Acceptors[0]->SetCpuSteering(Count);
+    }
+
+    // Clients on the same host may skip the TCP stack (same connections otherwise)
+    if(! Param.GetLocalPath().empty())
+    {
+      Acceptors.push_back(new ACCEPTOR(Manager, Param.GetLocalPath(), Param.GetBacklog()));
+    }
+
+    for(size_t Index = 0; Index < Endpoints.size(); Index++)
+    {
+      Acceptors.push_back(new ACCEPTOR(Manager, Endpoints[Index], Param.GetBacklog(), false, 1 + Index));
+    }
+  }
+
+  for(size_t Index = 0; Index < Acceptors.size(); Index++)
+  {
+    // Only the steered group is pinned : the local and extra listeners are not steered
+    Acceptors[Index]->Start((int)Index < Steered ? (int)Index : -1);
+  }
+
+  if(Upgrade != NULL)
+  {
+    Upgrade->Listen();
+  }
+
+  ADMIN* Admin = NULL;
+
+  if(Param.GetAdminPort() != 0)
+  {
+    // In prefork mode, the metrics of the workers are only known through the stats page
+    Admin = new ADMIN(Param.GetAdminPort(), _Workers != NULL ? _Stats : NULL);
+  }
+
+  LOG_LINE(LOG_INFO, "Now waiting for new connections");
 
-  ListeningSocket.Bind(PortNum);
+  bool HandedOver = false;
 
-  ListeningSocket.Listen();
+  std::vector<struct pollfd> Checkers;
 
   while(_Running)
   {
-    Console.LogInfo("Now waiting for a new connection");
+    struct pollfd Fixed[2] =
+    {
+      {_SignalId, POLLIN, 0},
+      {Upgrade != NULL ? Upgrade->GetId() : -1, POLLIN, 0},
+    };
+
+    Checkers.assign(Fixed, Fixed + 2);
 
-    SOCKET& ConnectedSock = ListeningSocket.Accept();
+    // Scrapes are served by this loop, between the signals
+    if(Admin != NULL)
+    {
+      Admin->AddChecks(Checkers);
+    }
 
-    int HostId = Manager.Create(ConnectedSock);
+    // The metrics are mirrored by this loop too, the connection threads are left alone
+    int Timeout = (_Stats != NULL ? _Stats->Publish() : POLL_TIMEOUT_MS);
 
-    std::ostringstream Text;
+    int Ready = poll(&Checkers[0], Checkers.size(), Timeout);
+
+    // Also called on timeouts, to close the idle clients
+    if(Admin != NULL)
+    {
+      Admin->Process(Checkers, 2);
+    }
 
-    Text << "A new client is connected with host ID " << HostId;
+    if(Ready <= 0)
+    {
+      continue;
+    }
 
-    Console.LogInfo(Text.str());
+    if(Checkers[0].revents & POLLIN)
+    {
+      ProcessSignals();
+    }
+
+    if(Checkers[1].revents & POLLIN)
+    {
+      HandedOver = HandOver(*Upgrade, Acceptors);
+    }
   }
+
+  for(size_t Index = 0; Index < Acceptors.size(); Index++)
+  {
+    delete Acceptors[Index];
+  }
+
+  if(_Workers != NULL)
+  {
+    _Workers->Stop();
+  }
+  // The new process owns the clients now : they are neither told goodbye nor closed
+  else if(! HandedOver)
+  {
+    Manager.Shutdown(Param.GetShutdownDeadline());
+  }
+
+  delete Admin;
+
+  delete Upgrade;
+
+  LogMetrics();
+}
+
+
+
+/**
+ * \brief          Worker process function (prefork mode)
+ */
+void APPLICATION::RunWorker()
+{
+  Console.Start();
+
+  LOG_LINE(LOG_INFO, "Worker now waiting for connections from the master");
+
+  while(_Running)
+  {
+    struct pollfd Checkers[2] =
+    {
+      {_SignalId, POLLIN, 0},
+      {_Workers->GetChannelId(), POLLIN, 0},
+    };
+
+    int Timeout = (_Stats != NULL ? _Stats->Publish() : POLL_TIMEOUT_MS);
+
+    if(poll(Checkers, 2, Timeout) <= 0)
+    {
+      continue;
+    }
+
+    if(Checkers[0].revents & POLLIN)
+    {
+      ProcessSignals();
+    }
+
+    if(Checkers[1].revents & (POLLIN | POLLHUP | POLLERR))
+    {
+      try
+      {
+        int SocketId;
+        int Namespace;
+
+        while((SocketId = _Workers->Receive(Namespace)) != -1)
+        {
+          SOCKET* Socket = new SOCKET(SocketId);
+
+          try
+          {
+            Manager.Create(*Socket, Namespace);
+          }
+
+          catch(EXCEPTION Exception)
+          {
+            delete Socket;
+            throw;
+          }
+        }
+      }
+
+      catch(EXCEPTION Exception)
+      {
+        Console.LogExcept(Exception);
+      }
+    }
+  }
+
+  Manager.Shutdown(Param.GetShutdownDeadline());
+
+  LogMetrics();
+}
+
+
+
+/**
+ * \brief          Hands the listening sockets and the connections over to a new process
+ *
+ * \param Upgrade    Upgrade socket the new process has connected to
+ * \param Acceptors  Acceptors of the server
+ *
+ * \return         \b true if the new process has taken the sockets over
+ * \return         \b false if the handover has failed (the server then stops as usual)
+ */
+bool APPLICATION::HandOver(UPGRADE& Upgrade, std::vector<ACCEPTOR*>& Acceptors)
+{
+  LOG_LINE(LOG_INFO, "New process found, handing the sockets over");
+
+  std::vector<HANDOVER> Listeners;
+
+  std::vector<HANDOVER> Connections;
+
+  std::vector<ID_RANGES> Leases;
+
+  // Pending connections stay queued in the listening sockets for the new process
+  for(size_t Index = 0; Index < Acceptors.size(); Index++)
+  {
+    Acceptors[Index]->Stop();
+
+    HANDOVER Listener;
+
+    memset(&Listener, 0, sizeof(Listener));
+
+    Listener.SocketId = Acceptors[Index]->GetSocketId();
+    Listener.Namespace = Acceptors[Index]->GetNamespace();
+
+    Listeners.push_back(Listener);
+  }
+
+  Manager.Freeze(Connections, Leases, Param.GetShutdownDeadline());
+
+  _Running = false;
+
+  try
+  {
+    Upgrade.HandOver(Listeners, Connections, Leases);
+  }
+
+  catch(EXCEPTION Exception)
+  {
+    Console.LogExcept(Exception);
+
+    return false;
+  }
+
+  LOG_LINE(LOG_INFO, "%u client(s) handed over", Connections.size());
+
+  return true;
 }
 
 
@@ -139,7 +517,7 @@ void APPLICATION::RunServer(int PortNum)
  */
 void APPLICATION::SetSignalConfig()
 {
-  int Ret;
+  int Ret = 0;
 
   struct sigaction SigAction;
 
@@ -149,57 +527,148 @@ void APPLICATION::SetSignalConfig()
 
   sigemptyset(&SigAction.sa_mask);
 
-  /// @todo Improve the signals management
-
-  /*
-  sigaddset(&SigAction.sa_mask, SIGINT);
-  sigaddset(&SigAction.sa_mask, SIGSEGV);
-  sigaddset(&SigAction.sa_mask, SIGABRT);
-  sigaddset(&SigAction.sa_mask, SIGTERM);
-  */
+  // Fatal signals are still caught asynchronously, to print the backtrace
+  Ret |= sigaction(SIGSEGV, &SigAction, NULL);
+  Ret |= sigaction(SIGABRT, &SigAction, NULL);
 
-  //sigprocmask(SIG_SETMASK, &SigAction.sa_mask, NULL);
+  // Writing to a closed connection must not kill the process
+  SigAction.sa_handler = SIG_IGN;
 
-  pthread_sigmask(SIG_SETMASK, &SigAction.sa_mask, NULL);
-
-  Ret = sigaction(SIGINT,  &SigAction, NULL);
-  Ret = sigaction(SIGSEGV, &SigAction, NULL);
-  Ret = sigaction(SIGABRT, &SigAction, NULL);
-  Ret = sigaction(SIGTERM, &SigAction, NULL);
+  Ret |= sigaction(SIGPIPE, &SigAction, NULL);
 
   if(Ret != 0)
   {
     throw EXCEPTION("Error setting signal configuration");
   }
+
+  // Stop, reload and child signals are blocked before any thread is created (threads inherit the mask)
+  sigset_t SigMask;
+
+  sigemptyset(&SigMask);
+  sigaddset(&SigMask, SIGINT);
+  sigaddset(&SigMask, SIGTERM);
+  sigaddset(&SigMask, SIGHUP);
+  sigaddset(&SigMask, SIGCHLD);
+
+  if(pthread_sigmask(SIG_BLOCK, &SigMask, NULL) != 0)
+  {
+    throw EXCEPTION("Error setting signal mask");
+  }
+
+  // They are read synchronously by the main loop instead
+  _SignalId = signalfd(-1, &SigMask, SFD_NONBLOCK | SFD_CLOEXEC);
+
+  if(_SignalId == -1)
+  {
+    throw EXCEPTION("Error creating signal descriptor");
+  }
 }
 
 
 
 /**
- * \brief         Signal management function
+ * \brief         Processes the signals received
+ */
+void APPLICATION::ProcessSignals()
+{
+  struct signalfd_siginfo Info;
+
+  while(read(_SignalId, &Info, sizeof(Info)) == sizeof(Info))
+  {
+    Console.LogSignal(Info.ssi_signo);
+
+    switch(Info.ssi_signo)
+    {
+      case SIGINT:
+      case SIGTERM:
+      _Running = false;
+      break;
+
+      case SIGHUP:
+      Reload();
+      break;
+
+      case SIGCHLD:
+      if(_Workers != NULL)
+      {
+        std::vector<int> Exited;
+
+        _Workers->Reap(Exited);
+
+        // Connections of a crashed worker are closed by the system
+        for(size_t Index = 0; Index < Exited.size() && _Publisher != NULL; Index++)
+        {
+          _Publisher->ResetShard(Exited[Index]);
+        }
+      }
+      break;
+
+      default:
+      break;
+    }
+  }
+}
+
+
+
+/**
+ * \brief         Reload request (on SIGHUP)
+ */
+void APPLICATION::Reload()
+{
+  LOG_LINE(LOG_INFO, "Reload requested");
+
+  // The current log file is renamed with a time stamp, a new one is started
+  Console.Rotate();
+}
+
+
+
+/**
+ * \brief         Logs the metrics of the process (at its end)
+ */
+void APPLICATION::LogMetrics()
+{
+  long long Values[METRIC_ID_COUNT];
+
+  METRICS::ReadAll(Values);
+
+  for(int Id = 0; Id < METRIC_ID_COUNT; Id++)
+  {
+    LOG_LINE(LOG_INFO, "Metric %s = %d", METRICS::GetInfo((METRIC_ID)Id).Name, Values[Id]);
+  }
+
+  HISTOGRAM_DATA Data;
+
+  for(int Id = 0; Id < HISTOGRAM_ID_COUNT; Id++)
+  {
+    METRICS::ReadHistogram((HISTOGRAM_ID)Id, Data);
+
+    const char* Name = METRICS::GetInfo((HISTOGRAM_ID)Id).Name;
+
+    LOG_LINE(LOG_INFO, "Metric %s : %u values, max = %u", Name, Data.Count, Data.Max);
+    LOG_LINE(LOG_INFO, "Metric %s : p50 = %u, p99 = %u, p99.9 = %u", Name,
+             HISTOGRAM::GetPercentile(Data, 0.5), HISTOGRAM::GetPercentile(Data, 0.99), HISTOGRAM::GetPercentile(Data, 0.999));
+  }
+}
+
+
+
+/**
+ * \brief         Signal management function (fatal signals only)
  *
  * \param         SigNum Signal occured
  */
 void APPLICATION::SignalHandler(int SigNum)
 {
-  App().Console.LogSignal(SigNum);
+  // The lines still queued are written before the ones of the crash, if the writer is not blocked
+  App().Console.Abandon();
 
-  switch(SigNum)
-  {
-    case SIGINT:
-    case SIGTERM:
-    App()._Running = false;
-    break;
+  App().Console.LogSignal(SigNum);
 
-    case SIGSEGV:
-    case SIGABRT:
-    PrintBackTrace();
-    exit(EXIT_FAILURE);
-    break;
+  PrintBackTrace();
 
-    default:
-    break;
-  }
+  exit(EXIT_FAILURE);
 }
 
 
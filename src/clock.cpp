@@ -0,0 +1,216 @@
+/**
+ * \file clock.cpp
+ *
+ * \brief Module for time sources
+ *
+ * \author Olivier de BLIC
+ */
+
+
+
+// Standard headers
+#include <time.h>
+#include <unistd.h>
+
+// Project headers
+#include "clock.h"
+
+// Constant values
+#define CALIBRATION_US          (20000)
+#define FIXED_POINT_SHIFT       (32)
+#define NS_PER_SECOND           (1000000000LL)
+#define NS_PER_MS               (1000000LL)
+
+#ifndef CLOCK_MONOTONIC_COARSE
+#define CLOCK_MONOTONIC_COARSE  CLOCK_MONOTONIC
+#endif
+
+// Static members
+bool                CLOCK::_TscEnabled = false;
+unsigned long long  CLOCK::_TscBase = 0;
+long long           CLOCK::_MonotonicBase = 0;
+long long           CLOCK::_RealtimeBase = 0;
+unsigned long long  CLOCK::_NsPerCycle = 0;
+
+
+
+/**
+ * \brief          Reading of a kernel clock
+ *
+ * \param Id       Identifier of the clock
+ *
+ * \return         Time of the clock (in nanoseconds)
+ */
+static long long ReadClock(clockid_t Id)
+{
+  struct timespec TimeValue;
+
+  clock_gettime(Id, &TimeValue);
+
+  return (long long)TimeValue.tv_sec * NS_PER_SECOND + TimeValue.tv_nsec;
+}
+
+
+
+/**
+ * \brief          Calibrates the time stamp counter, used then by the high resolution clock
+ *
+ * \return         \b true if the counter is used
+ * \return         \b false if the processor has no invariant counter (the kernel clock is kept)
+ */
+bool CLOCK::EnableTsc()
+{
+#if defined(__x86_64__)
+  unsigned int Eax = 0x80000000, Ebx, Ecx, Edx;
+
+  __asm__ __volatile__("cpuid" : "+a"(Eax), "=b"(Ebx), "=c"(Ecx), "=d"(Edx));
+
+  if(Eax < 0x80000007)
+  {
+    return false;
+  }
+
+  Eax = 0x80000007;
+
+  __asm__ __volatile__("cpuid" : "+a"(Eax), "=b"(Ebx), "=c"(Ecx), "=d"(Edx));
+
+  // Invariant counter : constant rate, not stopped in deep sleep states
+  if((Edx & (1 << 8)) == 0)
+  {
+    return false;
+  }
+
+  long long MonotonicBegin = ReadClock(CLOCK_MONOTONIC);
+  long long RealtimeBegin = ReadClock(CLOCK_REALTIME);
+  unsigned long long TscBegin = ReadTsc();
+
+  usleep(CALIBRATION_US);
+
+  long long MonotonicEnd = ReadClock(CLOCK_MONOTONIC);
+  unsigned long long TscEnd = ReadTsc();
+
+  if(TscEnd <= TscBegin || MonotonicEnd <= MonotonicBegin)
+  {
+    return false;
+  }
+
+  _NsPerCycle = ((unsigned long long)(MonotonicEnd - MonotonicBegin) << FIXED_POINT_SHIFT) / (TscEnd - TscBegin);
+  _TscBase = TscBegin;
+  _MonotonicBase = MonotonicBegin;
+  _RealtimeBase = RealtimeBegin;
+
+  __sync_synchronize();
+
+  _TscEnabled = true;
+
+  return true;
+#else
+  return false;
+#endif
+}
+
+
+
+/**
+ * \brief          Tells if the high resolution clock reads the time stamp counter
+ *
+ * \return         \b true if the calibrated counter is used
+ * \return         \b false if the kernel clock is used
+ */
+bool CLOCK::IsTscEnabled()
+{
+  return _TscEnabled;
+}
+
+
+
+/**
+ * \brief          High resolution monotonic time
+ *
+ * \return         Monotonic time (in nanoseconds)
+ */
+long long CLOCK::GetMonotonicNs()
+{
+  if(_TscEnabled)
+  {
+    return _MonotonicBase + CyclesToNs(ReadTsc() - _TscBase);
+  }
+
+  return ReadClock(CLOCK_MONOTONIC);
+}
+
+
+
+/**
+ * \brief          High resolution monotonic time
+ *
+ * \return         Monotonic time (in milliseconds)
+ */
+long long CLOCK::GetMonotonicMs()
+{
+  return GetMonotonicNs() / NS_PER_MS;
+}
+
+
+
+/**
+ * \brief          High resolution wall clock time
+ *
+ * \return         Time since the epoch (in nanoseconds)
+ */
+long long CLOCK::GetRealtimeNs()
+{
+  if(_TscEnabled)
+  {
+    // Not adjusted by NTP after the calibration
+    return _RealtimeBase + CyclesToNs(ReadTsc() - _TscBase);
+  }
+
+  return ReadClock(CLOCK_REALTIME);
+}
+
+
+
+/**
+ * \brief          Low resolution monotonic time (updated by the timer interrupt)
+ *
+ * \return         Monotonic time (in milliseconds, a few ms late at most)
+ */
+long long CLOCK::GetCoarseMs()
+{
+  return ReadClock(CLOCK_MONOTONIC_COARSE) / NS_PER_MS;
+}
+
+
+
+/**
+ * \brief          Reads the time stamp counter
+ *
+ * \return         Number of cycles of the counter
+ */
+unsigned long long CLOCK::ReadTsc()
+{
+#if defined(__x86_64__)
+  unsigned int Low, High;
+
+  __asm__ __volatile__("rdtsc" : "=a"(Low), "=d"(High));
+
+  return ((unsigned long long)High << 32) | Low;
+#else
+  return 0;
+#endif
+}
+
+
+
+/**
+ * \brief          Conversion of counter cycles to nanoseconds
+ *
+ * \param Cycles   Number of cycles since the calibration
+ *
+ * \return         Number of nanoseconds
+ */
+long long CLOCK::CyclesToNs(unsigned long long Cycles)
+{
+  return (long long)(((unsigned __int128)Cycles * _NsPerCycle) >> FIXED_POINT_SHIFT);
+}
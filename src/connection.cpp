@@ -10,18 +10,30 @@
 
 // Standard headers
 #include <string>
+#include <sstream>
+#include <iomanip>
 #include <unistd.h>
+#include <stdlib.h>
+#include <string.h>
+#include <arpa/inet.h>
 
 // Project headers
 #include "connection.h"
 #include "object.h"
 #include "application.h"
+#include "clock.h"
+#include "metrics.h"
 
 // Constant values
 #define CYCLE_DURATION_MS       (1000)
-#define SLICE_DURATION_MS       (50)
-#define CYCLE_DURATION_US       ((CYCLE_DURATION_MS) * (1000))
-#define SLICE_DURATION_US       ((SLICE_DURATION_MS) * (1000))
+#define PENDING_MAX_LENGTH      (1024)
+#define RATE_COMMAND            "RATE "
+#define GET_COMMAND             "GET "
+#define GET_BINARY              "BIN"
+#define GET_MAX_COUNT           (65536)
+#define LEASE_MAX_COUNT         (262144)
+#define RELEASE_COMMAND         "RELEASE"
+#define RESUME_COMMAND          "RESUME "
 
 
 
@@ -30,16 +42,31 @@
  *
  * \param Manager  Reference to the owner manager
  * \param Socket   Reference to the opened socket
+ * \param Namespace Identifiers namespace
  * \param HostID   Host identifier
+ * \param Token    Session token (0 if sessions are disabled)
+ * \param RateMs   Interval between two ID sendings (in milliseconds, 0 for the default one)
+ * \param DelayMs  Time before the first ID sending (in milliseconds)
  */
-CONNECTION::CONNECTION(MANAGER& Manager, SOCKET& Socket, int HostID)
-: OBJECT("CONNECTION"), _Manager(Manager), _HostId(HostID), _Socket(Socket), _Thread(*new THREAD(RunTask, (void*)this))
+CONNECTION::CONNECTION(MANAGER& Manager, SOCKET& Socket, int Namespace, int HostID, unsigned long long Token, int RateMs, int DelayMs)
+: OBJECT("CONNECTION"), _Manager(Manager), _Namespace(Namespace), _HostId(HostID), _Token(Token), _TokenSent(RateMs > 0), _CountReplies(0), _Socket(Socket), _Thread(*new THREAD(RunTask, (void*)this)), _Scheduler(Socket), _Connected(true), _LeaseCount(0), _Stopped(false)
 {
 #ifdef DEBUG
   App().Console.LogCtor(_ObjName);
 #endif
 
-  _Thread.Run();
+  // The first ID is sent as soon as the thread runs
+  _LastTickMs = CLOCK::GetMonotonicMs();
+  _NextTickMs = _LastTickMs;
+
+  SetRate(RateMs > 0 ? RateMs : CYCLE_DURATION_MS);
+
+  // A connection taken over from another process keeps its tick phase
+  if(DelayMs > 0)
+  {
+    _NextTickMs += DelayMs;
+    _LastTickMs = _NextTickMs - _RateMs;
+  }
 }
 
 
@@ -53,12 +80,35 @@ CONNECTION::~CONNECTION()
   App().Console.LogDtor(_ObjName);
 #endif
 
-  if(_Socket.IsConnected())
+  // Nothing is sent to a client known to have left
+  if(_Connected)
   {
-    _Socket.Send("BYE\n");
+    try
+    {
+      _Socket.TrySend("Bye\n");
+    }
+
+    catch(EXCEPTION Exception)
+    {
+    }
   }
 
   _Thread.Cancel();
+
+  _Manager.ReleaseIds(_Namespace, _Lease);
+
+  delete &_Thread;
+  delete &_Socket;
+}
+
+
+
+/**
+ * \brief          Starts the thread of the connection (once the manager knows it)
+ */
+void CONNECTION::Start()
+{
+  _Thread.Run();
 }
 
 
@@ -74,6 +124,68 @@ int CONNECTION::GetHostID() const
 
 
 
+/**
+ * \brief          Getter for the identifiers namespace
+ *
+ * \return         Namespace of the host identifier (endpoint the client connected to)
+ */
+int CONNECTION::GetNamespace() const
+{
+  return _Namespace;
+}
+
+
+
+/**
+ * \brief          Getter for the session token
+ *
+ * \return         Token the client presents to resume its session (0 if sessions are disabled)
+ */
+unsigned long long CONNECTION::GetToken() const
+{
+  return _Token;
+}
+
+
+
+/**
+ * \brief          Getter for socket identifier
+ *
+ * \return         Socket identifier
+ */
+int CONNECTION::GetSocketId() const
+{
+  return _Socket.GetId();
+}
+
+
+
+/**
+ * \brief          Getter for the tick interval
+ *
+ * \return         Interval between two ID sendings (in milliseconds)
+ */
+int CONNECTION::GetRate() const
+{
+  return _RateMs;
+}
+
+
+
+/**
+ * \brief          Getter for the tick phase
+ *
+ * \return         Time left before the next ID sending (in milliseconds)
+ */
+int CONNECTION::GetTickDelay() const
+{
+  long long Delay = _NextTickMs - CLOCK::GetMonotonicMs();
+
+  return (Delay > 0 ? Delay : 0);
+}
+
+
+
 /**
  * \brief          Task for the connection management
  *
@@ -90,86 +202,363 @@ void* CONNECTION::RunTask(void* Arg)
 
   //HostConn._Manager.Add(&HostConn);
 
-  App().Console.LogInfo("Local address is " + HostConn._Socket.GetLocalAddr());
-  App().Console.LogInfo("Remote address is " + HostConn._Socket.GetRemoteAddr());
+  LOG_LINE_RATE(LOG_INFO, LOG_HOT_RATE, LOG_HOT_BURST, "Local address is %s", HostConn._Socket.GetLocalAddr());
+  LOG_LINE_RATE(LOG_INFO, LOG_HOT_RATE, LOG_HOT_BURST, "Remote address is %s", HostConn._Socket.GetRemoteAddr());
 
   try
   {
-    while(HostConn._Socket.IsConnected())
+    // The hangup is reported by the wait (or by an empty reception), not polled
+    while(HostConn._Connected && ! HostConn._Manager.IsClosing())
     {
-      // Send the host ID
-      Buffer << "ID=" << HostConn._HostId << std::endl;
-      HostConn._Socket.Send(Buffer.str());
+      long long Now = CLOCK::GetMonotonicMs();
+
+      // No more ID is sent once the goodbye may have been
+      if(Now >= HostConn._NextTickMs && ! HostConn._Manager.IsClosing())
+      {
+        METRICS::Record(HISTOGRAM_TICK_LATENESS, CLOCK::GetMonotonicNs() / 1000 - HostConn._NextTickMs * 1000);
 
-      // Clear the buffer
-      Buffer.clear();
-      Buffer.str("");
+        // Queue the host ID (merged with the previous one if still not sent)
+        Buffer << "ID=" << HostConn._HostId << std::endl;
 
-      for(__useconds_t ElapsedTime = CYCLE_DURATION_US; ElapsedTime > 0; ElapsedTime -= SLICE_DURATION_US)
+        if(HostConn._Token != 0 && ! HostConn._TokenSent)
+        {
+          // The token comes with the first ID, and must not be lost by a tick merge
+          Buffer << "TOKEN=" << std::hex << std::setw(16) << std::setfill('0') << HostConn._Token << std::dec << std::endl;
+          HostConn._Scheduler.Push(SEND_INTERACTIVE, Buffer.str());
+          HostConn._TokenSent = true;
+        }
+        else
+        {
+          HostConn._Scheduler.Push(SEND_TICK, Buffer.str());
+        }
+
+        METRICS::Add(METRIC_TICKS_SENT);
+
+        // Clear the buffer
+        Buffer.clear();
+        Buffer.str("");
+
+        // Schedule without drift, but missed ticks are skipped instead of being sent in a burst
+        HostConn._LastTickMs = HostConn._NextTickMs;
+        HostConn._NextTickMs += HostConn._RateMs;
+
+        if(HostConn._NextTickMs <= Now)
+        {
+          HostConn._LastTickMs = Now;
+          HostConn._NextTickMs = Now + HostConn._RateMs;
+        }
+      }
+
+      // Sleep until the next tick
+      long long Timeout = HostConn._NextTickMs - Now;
+
+      HostConn._Scheduler.Flush();
+
+      // Once closing, the data is left to the goodbye or to the next process
+      if(HostConn._Socket.WaitData(Timeout, HostConn._Scheduler.IsPending(), HostConn._Manager.GetWakeId()) && ! HostConn._Manager.IsClosing())
       {
-        usleep(SLICE_DURATION_US);
+        long long ReceivedNs = CLOCK::GetMonotonicNs();
 
-        if(HostConn._Socket.IsDataWaiting())
+        std::string Data = HostConn._Socket.Receive();
+
+        if(Data.length() == 0)
         {
-          std::string Data = HostConn._Socket.Receive();
+          // The client has closed the connection
+          HostConn._Connected = false;
+          break;
+        }
 
-          /// \bug IsDataWaiting() just ensure that reading socket will not block ! Data is not waiting for sure !
+        LOG_LINE_SAMPLE(LOG_INFO, LOG_HOT_SAMPLE, "Data received : '%s'", Data);
 
-          if(Data.length() > 0)
-          {
-            App().Console.LogInfo("Data received : '" + Data + "'", SOURCE_LINE);
-
-#if 0
-            // The parser will do something like (ignoring case and trailing blanks, taking parameters, etc.)
-
-            if(Data == "play")
-            {
-              // Do something
-            }
-            else if(Data == "pause")
-            {
-              // Do something
-            }
-            else if(Data == "stop")
-            {
-              // Do something
-            }
-            else if(Data == "open")
-            {
-              // Do something
-            }
-            else if(Data == "kill")
-            {
-              // Do something
-            }
-            else
-            {
-              // Do nothing
-            }
-#endif
+        HostConn._Pending += Data;
+
+        size_t EndOfLine;
 
-            if(Data.find('\n') != Data.npos)
-            {
-              Buffer << "COUNT=" << HostConn._Manager.Count() << std::endl;
-              HostConn._Socket.Send(Buffer.str());
+        while((EndOfLine = HostConn._Pending.find('\n')) != HostConn._Pending.npos)
+        {
+          HostConn.ProcessCommand(HostConn._Pending.substr(0, EndOfLine));
+          HostConn._Pending.erase(0, EndOfLine + 1);
+        }
+
+        // Replies are sent at once, ahead of the waiting ticks
+        HostConn._Scheduler.Flush();
+
+        if(HostConn._CountReplies > 0)
+        {
+          unsigned long long LatencyUs = (CLOCK::GetMonotonicNs() - ReceivedNs) / 1000;
 
-              Buffer.clear();
-              Buffer.str("");
-            }
+          for(; HostConn._CountReplies > 0; HostConn._CountReplies--)
+          {
+            METRICS::Record(HISTOGRAM_COUNT_LATENCY, LatencyUs);
           }
         }
+
+        // A client never sending new line characters cannot make the buffer grow forever
+        if(HostConn._Pending.length() > PENDING_MAX_LENGTH)
+        {
+          HostConn._Pending.clear();
+        }
       }
     }
   }
 
   catch(EXCEPTION Exception)
   {
+    HostConn._Connected = false;
+
     App().Console.LogExcept(Exception);
   }
 
   //HostConn._Manager.Remove(&HostConn);
 
-  HostConn._Manager.Destroy(HostConn._HostId);
+  METRICS::Add(METRIC_DISCONNECTED);
+
+  // Last use of the connection by its thread during a shutdown or a handover
+  HostConn._Manager.Destroy(HostConn);
 
   return NULL;
 }
+
+
+
+/**
+ * \brief          Processing of a command line received from the client
+ *
+ * \param  Line    Received line (without the new line character)
+ */
+void CONNECTION::ProcessCommand(const std::string& Line)
+{
+  std::ostringstream Buffer;
+
+  if(Line.compare(0, sizeof(RATE_COMMAND) - 1, RATE_COMMAND) == 0)
+  {
+    const char* Value = Line.c_str() + sizeof(RATE_COMMAND) - 1;
+    char* End = NULL;
+
+    long RateMs = strtol(Value, &End, 10);
+
+    // Only trailing blanks are tolerated after the value
+    while(End != Value && (*End == ' ' || *End == '\t' || *End == '\r'))
+    {
+      End++;
+    }
+
+    if(End == Value || *End != '\0' || RateMs <= 0)
+    {
+      Buffer << "ERROR=invalid rate" << std::endl;
+    }
+    else
+    {
+      Buffer << "RATE=" << SetRate(RateMs) << std::endl;
+    }
+  }
+  else if(Line.compare(0, sizeof(GET_COMMAND) - 1, GET_COMMAND) == 0)
+  {
+    METRICS::Add(METRIC_GET_REQUESTS);
+
+    Buffer << ProcessGet(Line.substr(sizeof(GET_COMMAND) - 1));
+  }
+  else if(Line.compare(0, sizeof(RESUME_COMMAND) - 1, RESUME_COMMAND) == 0)
+  {
+    Buffer << ProcessResume(Line.substr(sizeof(RESUME_COMMAND) - 1));
+  }
+  else if(Line.compare(0, sizeof(RELEASE_COMMAND) - 1, RELEASE_COMMAND) == 0 &&
+          Line.find_first_not_of(" \t\r", sizeof(RELEASE_COMMAND) - 1) == std::string::npos)
+  {
+    // The client tells that it does not use its identifiers anymore
+    Buffer << "RELEASED=" << _LeaseCount << std::endl;
+
+    _Manager.ReleaseIds(_Namespace, _Lease);
+
+    _LeaseCount = 0;
+  }
+  else
+  {
+    METRICS::Add(METRIC_COUNT_REQUESTS);
+
+    _CountReplies++;
+
+    // Any other line is answered with the number of connected clients
+    Buffer << "COUNT=" << _Manager.Count(_Namespace) << std::endl;
+  }
+
+  _Scheduler.Push(SEND_INTERACTIVE, Buffer.str());
+}
+
+
+
+/**
+ * \brief          Processing of a request for several identifiers
+ *
+ * \param  Args    Arguments of the command (number of identifiers, then optionally BIN)
+ *
+ * \return         Reply to send
+ */
+std::string CONNECTION::ProcessGet(const std::string& Args)
+{
+  const char* Value = Args.c_str();
+  char* End = NULL;
+
+  long Count = strtol(Value, &End, 10);
+
+  if(End == Value || Count <= 0 || Count > GET_MAX_COUNT)
+  {
+    return "ERROR=invalid count\n";
+  }
+
+  while(*End == ' ' || *End == '\t')
+  {
+    End++;
+  }
+
+  bool Binary = (strncmp(End, GET_BINARY, sizeof(GET_BINARY) - 1) == 0);
+
+  if(Binary)
+  {
+    End += sizeof(GET_BINARY) - 1;
+  }
+
+  while(*End == ' ' || *End == '\t' || *End == '\r')
+  {
+    End++;
+  }
+
+  if(*End != '\0')
+  {
+    return "ERROR=invalid format\n";
+  }
+
+  // Identifiers already sent stay leased until RELEASE or the disconnection
+  if(_LeaseCount + Count > LEASE_MAX_COUNT)
+  {
+    return "ERROR=lease limit reached\n";
+  }
+
+  ID_RANGES Lease;
+
+  // A single allocator call, contiguous as long as the identifiers space is not fragmented
+  try
+  {
+    if(! _Manager.LeaseIds(_Namespace, Count, Lease))
+    {
+      return "ERROR=lease budget spent\n";
+    }
+  }
+
+  catch(EXCEPTION Exception)
+  {
+    return "ERROR=no identifier available\n";
+  }
+
+  _Lease.insert(_Lease.end(), Lease.begin(), Lease.end());
+
+  _LeaseCount += Count;
+
+  std::ostringstream Buffer;
+
+  if(Binary)
+  {
+    // "BIDS", number of ranges, then first identifier and length of each range (network order)
+    uint32_t Header = htonl(Lease.size());
+
+    Buffer.write("BIDS", 4);
+    Buffer.write((const char*)&Header, sizeof(Header));
+
+    for(size_t Range = 0; Range < Lease.size(); Range++)
+    {
+      uint32_t Fields[2] = { htonl(Lease[Range].first), htonl(Lease[Range].second) };
+
+      Buffer.write((const char*)Fields, sizeof(Fields));
+    }
+  }
+  else
+  {
+    // Ranges as "first-last", single identifiers alone
+    Buffer << "IDS=";
+
+    for(size_t Range = 0; Range < Lease.size(); Range++)
+    {
+      Buffer << (Range > 0 ? "," : "") << Lease[Range].first;
+
+      if(Lease[Range].second > 1)
+      {
+        Buffer << "-" << Lease[Range].first + Lease[Range].second - 1;
+      }
+    }
+
+    Buffer << std::endl;
+  }
+
+  return Buffer.str();
+}
+
+
+
+/**
+ * \brief          Processing of a request to resume a previous session
+ *
+ * \param  Args    Arguments of the command (token of the session)
+ *
+ * \return         Reply to send
+ */
+std::string CONNECTION::ProcessResume(const std::string& Args)
+{
+  const char* Value = Args.c_str();
+  char* End = NULL;
+
+  unsigned long long Session = strtoull(Value, &End, 16);
+
+  while(End != Value && (*End == ' ' || *End == '\t' || *End == '\r'))
+  {
+    End++;
+  }
+
+  if(End == Value || *End != '\0' || Session == 0)
+  {
+    return "ERROR=invalid token\n";
+  }
+
+  // The ID given at connection is released, the one of the session is taken back
+  if(! _Manager.Resume(_Namespace, _HostId, _Token, Session))
+  {
+    return "ERROR=unknown session\n";
+  }
+
+  std::ostringstream Buffer;
+
+  Buffer << "ID=" << _HostId << std::endl;
+
+  return Buffer.str();
+}
+
+
+
+/**
+ * \brief          Change of the tick interval
+ *
+ * \param  RateMs  Requested tick interval (in milliseconds, any value a client may send)
+ *
+ * \return         Applied tick interval (bounded by the parameters)
+ */
+int CONNECTION::SetRate(long RateMs)
+{
+  // Bounded before being narrowed, so that huge values are not seen as negative ones
+  if(RateMs < App().Param.GetRateMin())
+  {
+    RateMs = App().Param.GetRateMin();
+  }
+  else if(RateMs > App().Param.GetRateMax())
+  {
+    RateMs = App().Param.GetRateMax();
+  }
+
+  // The pending tick is simply moved, relatively to the last one sent
+  _RateMs = RateMs;
+
+  if(_NextTickMs != _LastTickMs)
+  {
+    _NextTickMs = _LastTickMs + RateMs;
+  }
+
+  return RateMs;
+}
@@ -15,13 +15,33 @@
 #include <fstream>
 #include <signal.h>
 #include <typeinfo>
-#include <time.h>
+#include <unistd.h>
+#include <fcntl.h>
+#include <errno.h>
+#include <stdio.h>
+#include <string.h>
+#include <sys/stat.h>
+#include <vector>
 
 // Project headers
 #include "console.h"
 #include "exception.h"
+#include "logring.h"
+#include "logsite.h"
+#include "logformat.h"
+#include "loglimit.h"
+#include "logfile.h"
+#include "thread.h"
+#include "clock.h"
 
 // Constant values
+#define LOG_RING_BYTES            (16384)
+#define LOG_IDLE_US               (1000)
+#define LOG_FATAL_WAIT_MS         (200)
+#define LOG_SUMMARY_MS            (1000)
+#define LOG_FLUSH_MS              (1000)
+#define LOG_FILE_MODE             (0644)
+#define NS_PER_SECOND             (1000000000LL)
 #define CODE_GRA                  "0"
 #define CODE_RED                  "1"
 #define CODE_GRE                  "2"
@@ -47,13 +67,29 @@
 
 
 
+// Static members
+__thread long CONSOLE::_StampSecond = -1;
+__thread char CONSOLE::_StampPrefix[LOG_STAMP_MAX];
+__thread int  CONSOLE::_StampLength = 0;
+
+
+
 /**
  * \brief          Console constructor
  */
 CONSOLE::CONSOLE()
-: _Stream(std::cout)
+: _Stream(std::cout), _Writer(NULL), _Async(false), _Running(false), _Drained(false), _Abandoned(false), _Dropped(0), _SummaryMs(0), _FlushMs(0), _File(NULL), _FilePath(), _FileSegment(0), _FilePeriod(0), _BinaryId(-1), _SitesPid(0), _SitesWritten(0)
 {
   pthread_mutex_init(&_Lock, NULL);
+  pthread_mutex_init(&_RingsLock, NULL);
+
+  pthread_key_create(&_RingKey, ReleaseRing);
+
+  // Logs given as text are records with a single argument in the binary log
+  for(int Type = 0; Type < LOG_TYPE_COUNT; Type++)
+  {
+    _TextSites[Type] = new LOGSITE(Type, "%s", "");
+  }
 }
 
 
@@ -63,6 +99,17 @@ CONSOLE::CONSOLE()
  */
 CONSOLE::~CONSOLE()
 {
+  // Rings may still be referenced by threads left to the end of the process
+  pthread_key_delete(_RingKey);
+
+  if(_BinaryId != -1)
+  {
+    close(_BinaryId);
+  }
+
+  delete _File;
+
+  pthread_mutex_destroy(&_RingsLock);
   pthread_mutex_destroy(&_Lock);
 }
 
@@ -104,6 +151,173 @@ void CONSOLE::SetFullPath(bool Enabled)
 
 
 
+/**
+ * \brief          Writes the logs to a binary file, formatted only when decoded
+ *
+ * \param Path     Path of the binary log (appended if it already exists)
+ */
+void CONSOLE::SetBinary(const std::string& Path)
+{
+  int FileId = open(Path.c_str(), O_WRONLY | O_CREAT | O_APPEND, LOG_FILE_MODE);
+
+  if(FileId == -1)
+  {
+    throw EXCEPTION("Error opening binary log file");
+  }
+
+  struct stat Status;
+
+  if(fstat(FileId, &Status) == 0 && Status.st_size == 0)
+  {
+    if(write(FileId, LOG_FILE_MAGIC, LOG_FILE_MAGIC_LENGTH) != LOG_FILE_MAGIC_LENGTH)
+    {
+      close(FileId);
+      throw EXCEPTION("Error writing binary log file");
+    }
+  }
+
+  _BinaryId = FileId;
+}
+
+
+
+/**
+ * \brief          Writes the log lines to a memory mapped file instead of the standard output
+ *
+ * \param Path     Path of the log file (an existing one is renamed first)
+ * \param SegmentBytes Size of the file before rotation (in bytes)
+ * \param PeriodSec Age of the file before rotation (in seconds, 0 for no limit)
+ */
+void CONSOLE::SetFile(const std::string& Path, size_t SegmentBytes, int PeriodSec)
+{
+  _File = new LOGFILE(Path, SegmentBytes, PeriodSec);
+
+  _FilePath = Path;
+  _FileSegment = SegmentBytes;
+  _FilePeriod = PeriodSec;
+}
+
+
+
+/**
+ * \brief          Starts a new log file at the next line (if lines are written to a file)
+ */
+void CONSOLE::Rotate()
+{
+  pthread_mutex_lock(&_Lock);
+
+  if(_File != NULL)
+  {
+    _File->Rotate();
+  }
+
+  pthread_mutex_unlock(&_Lock);
+}
+
+
+
+/**
+ * \brief          Starts writing the log lines asynchronously
+ *
+ * \note           Threads do not survive a fork : it is called by each process, once the worker processes are forked.
+ */
+void CONSOLE::Start()
+{
+  if(_Writer != NULL)
+  {
+    return;
+  }
+
+  // A worker process writes its own file : the mapping of the master is left to it
+  if(_File != NULL && _File->GetPid() != getpid())
+  {
+    std::ostringstream Path;
+
+    Path << _FilePath << "." << getpid();
+
+    _File->Abandon();
+
+    delete _File;
+
+    _File = new LOGFILE(Path.str(), _FileSegment, _FilePeriod);
+  }
+
+  _Running = true;
+  _Drained = false;
+
+  _Writer = new THREAD(RunWriter, this, true);
+
+  _Writer->Run();
+
+  _Async = true;
+}
+
+
+
+/**
+ * \brief          Writes the queued log lines and goes back to synchronous writes
+ */
+void CONSOLE::Stop()
+{
+  if(_Writer == NULL)
+  {
+    return;
+  }
+
+  // New lines are written at once, the writer only empties the rings
+  _Async = false;
+  _Running = false;
+
+  if(_Writer->IsCurrent())
+  {
+    // Fatal signal in the writer itself
+    std::string Batch;
+
+    Drain(Batch);
+    return;
+  }
+
+  _Writer->Join();
+
+  delete _Writer;
+
+  _Writer = NULL;
+}
+
+
+
+/**
+ * \brief          Gives the writer a bounded time to write the queued lines, on a fatal signal
+ *
+ * \note           Nothing is joined and no lock is waited for : the crashed thread may hold one.
+ */
+void CONSOLE::Abandon()
+{
+  _Abandoned = true;
+
+  if(_Writer == NULL)
+  {
+    return;
+  }
+
+  THREAD* Writer = _Writer;
+
+  // The lines of the crash are written at once, the writer empties the rings a last time
+  _Async = false;
+  _Running = false;
+
+  // Left to the end of the process, never joined
+  _Writer = NULL;
+
+  // A writer which has crashed itself, or is blocked by the crashed thread, loses the queued lines
+  for(int WaitedMs = 0; WaitedMs < LOG_FATAL_WAIT_MS && ! _Drained && ! Writer->IsCurrent(); WaitedMs++)
+  {
+    usleep(1000);
+  }
+}
+
+
+
 #ifdef DEBUG
 /**
  * \brief            Text log (debug only)
@@ -201,9 +415,9 @@ void CONSOLE::LogBlank()
  * \param Msg        Information message
  * \param Source     Source line from where the function is call
  */
-void CONSOLE::LogInfo(std::string Msg, std::string Source)
+void CONSOLE::LogInfo(const std::string& Msg, const std::string& Source)
 {
-  if(_Verbose)
+  if(LOG_INFO >= LOG_MIN_TYPE && _Verbose)
   {
     PrintLogLine(LOG_INFO, Msg, Source);
   }
@@ -217,7 +431,7 @@ void CONSOLE::LogInfo(std::string Msg, std::string Source)
  * \param Msg        Warning message
  * \param Source     Source line from where the function is call
  */
-void CONSOLE::LogWarn(std::string Msg, std::string Source)
+void CONSOLE::LogWarn(const std::string& Msg, const std::string& Source)
 {
   PrintLogLine(LOG_WARN, Msg, Source);
 }
@@ -230,7 +444,7 @@ void CONSOLE::LogWarn(std::string Msg, std::string Source)
  * \param Msg        Error message
  * \param Source     Source line from where the function is call
  */
-void CONSOLE::LogError(std::string Msg, std::string Source)
+void CONSOLE::LogError(const std::string& Msg, const std::string& Source)
 {
   PrintLogLine(LOG_ERROR, Msg, Source);
 }
@@ -279,6 +493,14 @@ void CONSOLE::LogSignal(int SigNum)
       Buffer << " (terminate)";
     break;
 
+    case SIGHUP:
+      Buffer << " (hangup)";
+    break;
+
+    case SIGCHLD:
+      Buffer << " (child)";
+    break;
+
     default:
     break;
   }
@@ -348,12 +570,42 @@ void CONSOLE::PrintHelp()
 
   _Buffer <<
   "Use :      seastar [-h] [-s] [-v] [-c] [-p portnum]              \n"
+  "                   [-m ratemin] [-M ratemax] [-b backlog]        \n"
+  "                   [-a acceptors] [-A] [-f fastopen] [-d defer]  \n"
+  "                   [-k idle,interval,count] [-u usertimeout]     \n"
+  "                   [-t deadline] [-U upgradepath] [-w workers]   \n"
+  "                   [-l localpath] [-S sharedpath] [-e port]...   \n"
+  "                   [-r sessionttl] [-B binarylog] [-T]           \n"
+  "                   [-L logfile] [-R size[,period]] [-P adminport]\n"
+  "                   [-X statspath]                                \n"
   "                                                                 \n"
   "Options :  -h  print help                                        \n"
   "           -s  display the splash screen at start                \n"
   "           -v  use the verbose mode                              \n"
   "           -c  use colored text in output                        \n"
   "           -p  set server port for listening (default is 1101)   \n"
+  "           -m  minimal tick interval in ms (default is 10)       \n"
+  "           -M  maximal tick interval in ms (default is 60000)    \n"
+  "           -b  length of the pending connections queue           \n"
+  "           -a  number of acceptors sharing the port (default 1)  \n"
+  "           -A  one acceptor per CPU, steering connections to theirs\n"
+  "           -f  TCP Fast Open queue length (default 0, disabled)  \n"
+  "           -d  defer accept until data, timeout in s (default 0) \n"
+  "           -k  keep alive probes : idle s, interval s and count  \n"
+  "           -u  TCP user timeout for unacknowledged data in ms    \n"
+  "           -t  maximal goodbye duration at shutdown in ms (1000) \n"
+  "           -U  Unix socket path to hand sockets over on upgrade  \n"
+  "           -w  number of worker processes (default 0, disabled)  \n"
+  "           -l  Unix socket path for clients on the same host     \n"
+  "           -S  shared memory file publishing count and IDs       \n"
+  "           -e  extra port, own IDs and count (can be repeated)   \n"
+  "           -r  session TTL in ms to resume an ID (default 0)     \n"
+  "           -B  binary log file, read with seastar-decode         \n"
+  "           -T  use the calibrated TSC as high resolution clock   \n"
+  "           -L  log file, memory mapped, instead of the output    \n"
+  "           -R  log file rotation : MB (64) and seconds (none)    \n"
+  "           -P  port exposing the metrics over HTTP (Prometheus)  \n"
+  "           -X  metrics in shared memory, read with seastar-stat  \n"
   ;
 
   ReleaseLogger();
@@ -370,9 +622,49 @@ void CONSOLE::PrintHelp()
  */
 void CONSOLE::PrintLogLine(LOG_TYPE Type, std::string LogData, std::string Source)
 {
-  InitLogger();
+  if(_BinaryId != -1)
+  {
+    Log(*_TextSites[Type], LogData);
+    return;
+  }
+
+  Emit(FormatLogLine(Type, LogData, Source));
+}
+
+
+
+/**
+ * \brief            Log with deferred formatting (use the LOG_LINE macro)
+ *
+ * \param Site       Call site of the log
+ */
+void CONSOLE::Log(const LOGSITE& Site)
+{
+  if(IsEnabled(Site))
+  {
+    char Record[LOG_RECORD_HEADER];
+
+    Write(Site, Record, LOG_RECORD_HEADER);
+  }
+}
+
+
+
+/**
+ * \brief            Formatting of a log line
+ *
+ * \param Type       Type of log
+ * \param LogData    Text of the log
+ * \param Source     Source line from where the function is call
+ *
+ * \return           Formatted line
+ */
+std::string CONSOLE::FormatLogLine(LOG_TYPE Type, const std::string& LogData, std::string Source)
+{
+  // Each thread formats its own lines, without any lock
+  std::ostringstream Buffer;
 
-  _Buffer << GetTimeStamp();
+  Buffer << GetTimeStamp();
 
   if(! _FullPath && Source != "")
   {
@@ -387,56 +679,524 @@ void CONSOLE::PrintLogLine(LOG_TYPE Type, std::string LogData, std::string Sourc
   switch(Type)
   {
     case LOG_CTOR:
-      _Buffer << ColCya() << "[" << "CTOR" << "]   " << ColStd();
-      _Buffer << "class " << ColWhi() << LogData << ColStd() << std::endl;
+      Buffer << ColCya() << "[" << "CTOR" << "]   " << ColStd();
+      Buffer << "class " << ColWhi() << LogData << ColStd() << std::endl;
     break;
 
     case LOG_DTOR:
-      _Buffer << ColCya() << "[" << "DTOR" << "]   " << ColStd();
-      _Buffer << "class " << ColWhi() << LogData << ColStd() << std::endl;
+      Buffer << ColCya() << "[" << "DTOR" << "]   " << ColStd();
+      Buffer << "class " << ColWhi() << LogData << ColStd() << std::endl;
     break;
 
     case LOG_DEBUG:
-      _Buffer << ColMag() << "[" << "DEBUG" << "]  " << ColStd();
-      _Buffer << "line " << ColWhi() << Source << ColStd() << " " << LogData << std::endl;
+      Buffer << ColMag() << "[" << "DEBUG" << "]  " << ColStd();
+      Buffer << "line " << ColWhi() << Source << ColStd() << " " << LogData << std::endl;
     break;
 
     case LOG_BLANK:
-      _Buffer << std::endl;
+      Buffer << std::endl;
     break;
 
     case LOG_INFO:
-      _Buffer << ColBlu() << "[" << "INFO" << "]   " << ColStd();
-      _Buffer << LogData << std::endl;
+      Buffer << ColBlu() << "[" << "INFO" << "]   " << ColStd();
+      Buffer << LogData << std::endl;
     break;
 
     case LOG_WARN:
-      _Buffer << ColYel() << "[" << "WARN" << "]   " << ColStd();
-      _Buffer << LogData << std::endl;
+      Buffer << ColYel() << "[" << "WARN" << "]   " << ColStd();
+      Buffer << LogData << std::endl;
     break;
 
     case LOG_ERROR:
-      _Buffer << ColRed() << "[" << "ERROR" << "]  " << ColStd();
-      _Buffer << LogData << std::endl;
+      Buffer << ColRed() << "[" << "ERROR" << "]  " << ColStd();
+      Buffer << LogData << std::endl;
     break;
 
     case LOG_EXCEPT:
-      _Buffer << ColGre() << "[" << "EXCEPT" << "] " << ColStd();
-      _Buffer << LogData << std::endl;
+      Buffer << ColGre() << "[" << "EXCEPT" << "] " << ColStd();
+      Buffer << LogData << std::endl;
     break;
 
     case LOG_SIGNAL:
-      _Buffer << ColGre() << "[" << "SIGNAL" << "] " << ColStd();
-      _Buffer << LogData << std::endl;
+      Buffer << ColGre() << "[" << "SIGNAL" << "] " << ColStd();
+      Buffer << LogData << std::endl;
     break;
 
     default:
-      _Buffer << ColGra() << "[" << "???" << "]    " << ColStd();
-      _Buffer << LogData << std::endl;
+      Buffer << ColGra() << "[" << "???" << "]    " << ColStd();
+      Buffer << LogData << std::endl;
     break;
   }
 
-  ReleaseLogger();
+  return Buffer.str();
+}
+
+
+
+/**
+ * \brief            Output of a formatted line (queued if the writer is running)
+ *
+ * \param Line       Formatted line
+ */
+void CONSOLE::Emit(const std::string& Line)
+{
+  Emit(Line.data(), Line.length());
+}
+
+
+
+/**
+ * \brief            Output of an encoded record or of a formatted line
+ *
+ * \param Data       Bytes of the record or of the line
+ * \param Length     Number of bytes
+ */
+void CONSOLE::Emit(const char* Data, size_t Length)
+{
+  if(_Async)
+  {
+    // A full ring drops the line (counted) rather than waiting for the writer
+    GetRing().Push(Data, Length);
+    return;
+  }
+
+  std::string Batch(Data, Length);
+
+  Output(Batch);
+}
+
+
+
+/**
+ * \brief            Tells if the logs of a call site are written
+ *
+ * \param Site       Call site of the log
+ *
+ * \return           \b true if the log has to be written
+ * \return           \b false if its type is filtered out
+ */
+bool CONSOLE::IsEnabled(const LOGSITE& Site) const
+{
+  return IsLogged((LOG_TYPE)Site.GetType());
+}
+
+
+
+/**
+ * \brief            Tells if a limited log is written (use the LOG_LINE_RATE and LOG_LINE_SAMPLE macros)
+ *
+ * \param Limit      Limit of the call site
+ *
+ * \return           \b true if the log has to be written
+ * \return           \b false if it is suppressed (counted for the summary)
+ */
+bool CONSOLE::Admit(LOGLIMIT& Limit)
+{
+  if(! Limit.Admit())
+  {
+    return false;
+  }
+
+  // Without the writer, the suppressed lines are reported ahead of the next written one
+  if(! _Async)
+  {
+    unsigned long Count = Limit.TakeSuppressed();
+
+    if(Count != 0)
+    {
+      std::string Batch;
+
+      AppendSummary(Batch, Limit, Count);
+
+      Output(Batch);
+    }
+  }
+
+  return true;
+}
+
+
+
+/**
+ * \brief            Output of a log with deferred formatting
+ *
+ * \param Site       Call site of the log
+ * \param Record     Record, its arguments following LOG_RECORD_HEADER bytes left for its header
+ * \param Length     Length of the record
+ */
+void CONSOLE::Write(const LOGSITE& Site, char* Record, size_t Length)
+{
+  if(_BinaryId != -1)
+  {
+    // Nothing is formatted : the decoder renders the line from the site and the arguments
+    LOGFORMAT::PutRecord(Record, Site.GetId(), CLOCK::GetRealtimeNs(), Length - LOG_RECORD_HEADER);
+
+    Emit(Record, Length);
+  }
+  else
+  {
+    std::string Text;
+
+    LOGFORMAT::Render(Site.GetFormat(), Record + LOG_RECORD_HEADER, Length - LOG_RECORD_HEADER, Text);
+
+    Emit(FormatLogLine((LOG_TYPE)Site.GetType(), Text, Site.GetSource()));
+  }
+}
+
+
+
+/**
+ * \brief            Adds a text to a batch, as a line or as a binary record
+ *
+ * \param Batch      Buffer the text is appended to
+ * \param Type       Type of log
+ * \param Text       Text of the log
+ */
+void CONSOLE::AppendText(std::string& Batch, LOG_TYPE Type, const std::string& Text)
+{
+  if(_BinaryId == -1)
+  {
+    Batch += FormatLogLine(Type, Text, "");
+    return;
+  }
+
+  char Record[LOG_RECORD_MAX];
+
+  size_t Length = LOG_RECORD_HEADER;
+
+  Length += LOGFORMAT::PutArg(Record + Length, sizeof(Record) - Length, Text);
+
+  LOGFORMAT::PutRecord(Record, _TextSites[Type]->GetId(), CLOCK::GetRealtimeNs(), Length - LOG_RECORD_HEADER);
+
+  Batch.append(Record, Length);
+}
+
+
+
+/**
+ * \brief            Writes a batch of lines or of records to the output
+ *
+ * \param Batch      Lines or records (cleared)
+ */
+void CONSOLE::Output(std::string& Batch)
+{
+  if(Batch.empty())
+  {
+    return;
+  }
+
+  // After a fatal signal, the lock may be held by the crashed thread : the lines are dropped rather than waited for
+  if(! _Abandoned)
+  {
+    pthread_mutex_lock(&_Lock);
+  }
+  else if(pthread_mutex_trylock(&_Lock) != 0)
+  {
+    Batch.clear();
+    return;
+  }
+
+  if(_BinaryId == -1)
+  {
+    // Without a segment to write to, lines still reach the standard output
+    if(_File == NULL || ! _File->Append(Batch.data(), Batch.length()))
+    {
+      _Stream.write(Batch.data(), Batch.length());
+      _Stream.flush();
+    }
+  }
+  else
+  {
+    std::string Content;
+
+    int Pid = getpid();
+
+    // A forked process has its own chunks : its sites are described again
+    if(Pid != _SitesPid)
+    {
+      _SitesPid = Pid;
+      _SitesWritten = 0;
+    }
+
+    // Sites are registered before their first record : read after the records, all of them are found
+    for(unsigned int Count = LOGSITE::GetCount(); _SitesWritten < Count; _SitesWritten++)
+    {
+      const LOGSITE* Site = LOGSITE::GetSite(_SitesWritten);
+
+      if(Site == NULL)
+      {
+        break;
+      }
+
+      LOGFORMAT::AppendSite(Content, Site->GetId(), Site->GetType(), Site->GetFormat(), Site->GetSource());
+    }
+
+    Content += Batch;
+
+    std::string Chunk;
+
+    LOGFORMAT::AppendChunk(Chunk, Pid, Content);
+
+    // A single write per chunk : chunks of several processes never mix
+    for(size_t Offset = 0; Offset < Chunk.length(); )
+    {
+      ssize_t Count = write(_BinaryId, Chunk.data() + Offset, Chunk.length() - Offset);
+
+      if(Count < 0 && errno != EINTR)
+      {
+        break;
+      }
+
+      Offset += (Count > 0 ? Count : 0);
+    }
+  }
+
+  pthread_mutex_unlock(&_Lock);
+
+  Batch.clear();
+}
+
+
+
+/**
+ * \brief            Getter for the ring of the calling thread
+ *
+ * \return           Ring of the thread (taken from the free rings or created on its first log)
+ */
+LOGRING& CONSOLE::GetRing()
+{
+  LOGRING* Ring = (LOGRING*)pthread_getspecific(_RingKey);
+
+  if(Ring != NULL)
+  {
+    return *Ring;
+  }
+
+  int CancelState;
+
+  // Threads may be cancelled asynchronously : never while holding the lock the writer needs
+  pthread_setcancelstate(PTHREAD_CANCEL_DISABLE, &CancelState);
+
+  pthread_mutex_lock(&_RingsLock);
+
+  if(_FreeRings.empty())
+  {
+    Ring = new LOGRING(LOG_RING_BYTES);
+  }
+  else
+  {
+    Ring = _FreeRings.back();
+    _FreeRings.pop_back();
+
+    Ring->Reopen();
+  }
+
+  _Rings.push_back(Ring);
+
+  pthread_mutex_unlock(&_RingsLock);
+
+  pthread_setspecific(_RingKey, Ring);
+
+  pthread_setcancelstate(CancelState, NULL);
+
+  return *Ring;
+}
+
+
+
+/**
+ * \brief            Gives up the ring of an ending thread
+ *
+ * \param Ring       Ring of the thread
+ */
+void CONSOLE::ReleaseRing(void* Ring)
+{
+  // Its last lines are still written, then the ring goes to another thread
+  ((LOGRING*)Ring)->Close();
+}
+
+
+
+/**
+ * \brief            Task of the writer thread
+ *
+ * \param Arg        Pointer to the console
+ *
+ * \return           NULL
+ */
+void* CONSOLE::RunWriter(void* Arg)
+{
+  CONSOLE& Console = *(CONSOLE*)Arg;
+
+  std::string Batch;
+
+  while(Console._Running)
+  {
+    if(Console.Drain(Batch) == 0)
+    {
+      usleep(LOG_IDLE_US);
+    }
+  }
+
+  // Lines queued before the stop
+  Console.Drain(Batch);
+
+  Console._Drained = true;
+
+  return NULL;
+}
+
+
+
+/**
+ * \brief            Writes the lines queued in all the rings
+ *
+ * \param Batch      Buffer for the lines (cleared)
+ *
+ * \return           Number of lines written
+ */
+size_t CONSOLE::Drain(std::string& Batch)
+{
+  size_t Count = 0;
+
+  unsigned long Dropped = 0;
+
+  pthread_mutex_lock(&_RingsLock);
+
+  for(size_t Index = 0; Index < _Rings.size(); )
+  {
+    LOGRING* Ring = _Rings[Index];
+
+    // Checked first : the lines of an ended thread are all queued by then
+    bool Closed = Ring->IsClosed();
+
+    Count += Ring->Pop(Batch);
+
+    Dropped += Ring->GetDropped();
+
+    if(Closed)
+    {
+      _Rings[Index] = _Rings.back();
+      _Rings.pop_back();
+
+      _FreeRings.push_back(Ring);
+    }
+    else
+    {
+      Index++;
+    }
+  }
+
+  for(size_t Index = 0; Index < _FreeRings.size(); Index++)
+  {
+    Dropped += _FreeRings[Index]->GetDropped();
+  }
+
+  pthread_mutex_unlock(&_RingsLock);
+
+  if(Dropped != _Dropped)
+  {
+    std::ostringstream Text;
+
+    Text << Dropped - _Dropped << " log lines dropped (rings full)";
+
+    AppendText(Batch, LOG_WARN, Text.str());
+
+    _Dropped = Dropped;
+  }
+
+  // Suppressed lines are reported periodically, and at last when stopping
+  long long Now = CLOCK::GetCoarseMs();
+
+  if(Now >= _SummaryMs || ! _Running)
+  {
+    Summarize(Batch);
+
+    _SummaryMs = Now + LOG_SUMMARY_MS;
+  }
+
+  // A single write for all the lines gathered
+  Output(Batch);
+
+  if(Now >= _FlushMs || ! _Running)
+  {
+    Flush();
+
+    _FlushMs = Now + LOG_FLUSH_MS;
+  }
+
+  return Count;
+}
+
+
+
+/**
+ * \brief            Asks for the lines written to the log file to be written back to the disk
+ */
+void CONSOLE::Flush()
+{
+  pthread_mutex_lock(&_Lock);
+
+  if(_File != NULL)
+  {
+    _File->Flush();
+  }
+
+  pthread_mutex_unlock(&_Lock);
+}
+
+
+
+/**
+ * \brief            Adds the summaries of the suppressed lines of all the limited call sites
+ *
+ * \param Batch      Buffer the summaries are appended to
+ */
+void CONSOLE::Summarize(std::string& Batch)
+{
+  for(unsigned int Id = 0; Id < LOGLIMIT::GetCount(); Id++)
+  {
+    LOGLIMIT* Limit = LOGLIMIT::GetLimit(Id);
+
+    if(Limit == NULL)
+    {
+      continue;
+    }
+
+    unsigned long Count = Limit->TakeSuppressed();
+
+    if(Count != 0)
+    {
+      AppendSummary(Batch, *Limit, Count);
+    }
+  }
+}
+
+
+
+/**
+ * \brief            Adds the summary of the suppressed lines of a call site
+ *
+ * \param Batch      Buffer the summary is appended to
+ * \param Limit      Limit of the call site
+ * \param Count      Number of suppressed lines
+ */
+void CONSOLE::AppendSummary(std::string& Batch, const LOGLIMIT& Limit, unsigned long Count)
+{
+  std::string Source = Limit.GetSite().GetSource();
+
+  size_t LastSlashPosition = Source.rfind('/');
+
+  if(! _FullPath && LastSlashPosition != Source.npos)
+  {
+    Source = Source.substr(LastSlashPosition + 1);
+  }
+
+  std::ostringstream Text;
+
+  Text << Count << " similar messages suppressed (" << Source << ")";
+
+  AppendText(Batch, (LOG_TYPE)Limit.GetSite().GetType(), Text.str());
 }
 
 
@@ -489,19 +1249,42 @@ std::string CONSOLE::FixLenght(std::string Text, int Lenght)
  */
 std::string CONSOLE::GetTimeStamp()
 {
-  struct timespec TimeValue;
+  long long Now = CLOCK::GetRealtimeNs();
 
-  std::ostringstream Timestamp;
+  long Second = Now / NS_PER_SECOND;
+  long Nanosecond = Now % NS_PER_SECOND;
 
-  clock_gettime(CLOCK_REALTIME, &TimeValue);
+  // The seconds are only formatted once per second by each thread
+  if(Second != _StampSecond)
+  {
+    _StampLength = snprintf(_StampPrefix, sizeof(_StampPrefix), "T:%ld.", Second);
+    _StampSecond = Second;
+  }
+
+  char Stamp[LOG_STAMP_MAX + 16];
+  char Digits[16];
+
+  int DigitCount = 0;
+
+  do
+  {
+    Digits[DigitCount++] = '0' + Nanosecond % 10;
+    Nanosecond /= 10;
+  }
+  while(Nanosecond != 0);
+
+  memcpy(Stamp, _StampPrefix, _StampLength);
+
+  int Length = _StampLength;
+
+  while(DigitCount > 0)
+  {
+    Stamp[Length++] = Digits[--DigitCount];
+  }
 
-  Timestamp << "T:";
-  Timestamp << TimeValue.tv_sec;
-  Timestamp << ".";
-  Timestamp << TimeValue.tv_nsec;
-  Timestamp << " ";
+  Stamp[Length++] = ' ';
 
-  return Timestamp.str();
+  return std::string(Stamp, Length);
 }
 
 
@@ -0,0 +1,282 @@
+/**
+ * \file decoder.cpp
+ *
+ * \brief Module containing the main() function of the binary log decoder
+ *
+ * \author Olivier de BLIC
+ */
+
+
+
+// Standard headers
+#include <stdlib.h>
+#include <stdint.h>
+#include <string.h>
+#include <string>
+#include <vector>
+#include <map>
+#include <iostream>
+#include <fstream>
+#include <sstream>
+
+// Project headers
+#include "console.h"
+#include "logformat.h"
+
+// Constant values
+
+
+
+/// Call site described in the binary log
+typedef struct
+{
+  /// Type of log
+  int          Type;
+
+  /// Format of the lines
+  std::string  Format;
+
+  /// Source line of the call site
+  std::string  Source;
+} SITE_INFO;
+
+/// Call sites of a process, by identifier
+typedef std::map<unsigned int, SITE_INFO> SITE_TABLE;
+
+
+
+/**
+ * \brief   Reading of a value from a chunk
+ *
+ * \param   Cursor    Position in the chunk (moved after the value)
+ * \param   End       End of the chunk
+ * \param   Value     Read value
+ * \param   Length    Size of the value
+ *
+ * \return            \b true if the value has been read
+ * \return            \b false if the chunk is truncated
+ */
+static bool Read(const char*& Cursor, const char* End, void* Value, size_t Length)
+{
+  if((size_t)(End - Cursor) < Length)
+  {
+    return false;
+  }
+
+  memcpy(Value, Cursor, Length);
+
+  Cursor += Length;
+
+  return true;
+}
+
+
+
+/**
+ * \brief   Printing of a record, as the console of the server does
+ *
+ * \param   Site      Call site of the record
+ * \param   TimeNs    Time of the log (in nanoseconds)
+ * \param   Text      Rendered text
+ */
+static void PrintLine(const SITE_INFO& Site, uint64_t TimeNs, const std::string& Text)
+{
+  std::ostringstream Line;
+
+  Line << "T:" << TimeNs / 1000000000 << "." << TimeNs % 1000000000 << " ";
+
+  switch(Site.Type)
+  {
+    case LOG_CTOR:   Line << "[CTOR]   class " << Text;                  break;
+    case LOG_DTOR:   Line << "[DTOR]   class " << Text;                  break;
+    case LOG_DEBUG:  Line << "[DEBUG]  line " << Site.Source << " " << Text; break;
+    case LOG_BLANK:                                                      break;
+    case LOG_INFO:   Line << "[INFO]   " << Text;                        break;
+    case LOG_WARN:   Line << "[WARN]   " << Text;                        break;
+    case LOG_ERROR:  Line << "[ERROR]  " << Text;                        break;
+    case LOG_EXCEPT: Line << "[EXCEPT] " << Text;                        break;
+    case LOG_SIGNAL: Line << "[SIGNAL] " << Text;                        break;
+    default:         Line << "[???]    " << Text;                        break;
+  }
+
+  std::cout << Line.str() << std::endl;
+}
+
+
+
+/**
+ * \brief   Decoding of a chunk
+ *
+ * \param   Cursor    Beginning of the content of the chunk
+ * \param   End       End of the chunk
+ * \param   Sites     Call sites of the process which has written the chunk
+ *
+ * \return            \b true if the chunk is valid
+ * \return            \b false if the chunk is corrupted
+ */
+static bool DecodeChunk(const char* Cursor, const char* End, SITE_TABLE& Sites)
+{
+  while(Cursor < End)
+  {
+    char Kind = *Cursor++;
+
+    uint32_t Id;
+
+    if(Kind == LOG_SITE)
+    {
+      uint8_t Type;
+      uint16_t Length;
+
+      SITE_INFO Site;
+
+      if(! Read(Cursor, End, &Id, sizeof(Id)) || ! Read(Cursor, End, &Type, sizeof(Type)) ||
+         ! Read(Cursor, End, &Length, sizeof(Length)) || End - Cursor < Length)
+      {
+        return false;
+      }
+
+      Site.Type = Type;
+      Site.Format.assign(Cursor, Length);
+      Cursor += Length;
+
+      if(! Read(Cursor, End, &Length, sizeof(Length)) || End - Cursor < Length)
+      {
+        return false;
+      }
+
+      Site.Source.assign(Cursor, Length);
+      Cursor += Length;
+
+      Sites[Id] = Site;
+    }
+    else if(Kind == LOG_RECORD)
+    {
+      uint64_t TimeNs;
+      uint16_t Length;
+
+      if(! Read(Cursor, End, &Id, sizeof(Id)) || ! Read(Cursor, End, &TimeNs, sizeof(TimeNs)) ||
+         ! Read(Cursor, End, &Length, sizeof(Length)) || End - Cursor < Length)
+      {
+        return false;
+      }
+
+      SITE_TABLE::const_iterator it = Sites.find(Id);
+
+      std::string Text;
+
+      if(it != Sites.end())
+      {
+        LOGFORMAT::Render(it->second.Format.c_str(), Cursor, Length, Text);
+
+        PrintLine(it->second, TimeNs, Text);
+      }
+      else
+      {
+        SITE_INFO Unknown;
+
+        Unknown.Type = LOG_TYPE_COUNT;
+
+        std::ostringstream Description;
+
+        Description << "record of unknown call site " << Id;
+
+        PrintLine(Unknown, TimeNs, Description.str());
+      }
+
+      Cursor += Length;
+    }
+    else
+    {
+      return false;
+    }
+  }
+
+  return true;
+}
+
+
+
+/**
+ * \brief   Decoding of a binary log
+ *
+ * \param   Input     Stream of the binary log
+ * \param   Name      Name of the log (for errors)
+ *
+ * \return            \b true if the whole log has been decoded
+ * \return            \b false if it is not a binary log or if it is corrupted
+ */
+static bool Decode(std::istream& Input, const std::string& Name)
+{
+  std::string Data((std::istreambuf_iterator<char>(Input)), std::istreambuf_iterator<char>());
+
+  if(Data.compare(0, LOG_FILE_MAGIC_LENGTH, LOG_FILE_MAGIC, LOG_FILE_MAGIC_LENGTH) != 0)
+  {
+    std::cerr << Name << " : not a binary log" << std::endl;
+    return false;
+  }
+
+  // Call sites are described by each process for its own chunks
+  std::map<uint32_t, SITE_TABLE> Processes;
+
+  const char* Cursor = Data.data() + LOG_FILE_MAGIC_LENGTH;
+  const char* End = Data.data() + Data.length();
+
+  while(Cursor < End)
+  {
+    uint32_t Pid;
+    uint32_t Length;
+
+    if(*Cursor++ != LOG_CHUNK || ! Read(Cursor, End, &Pid, sizeof(Pid)) ||
+       ! Read(Cursor, End, &Length, sizeof(Length)) || (size_t)(End - Cursor) < Length)
+    {
+      std::cerr << Name << " : truncated or corrupted chunk" << std::endl;
+      return false;
+    }
+
+    if(! DecodeChunk(Cursor, Cursor + Length, Processes[Pid]))
+    {
+      std::cerr << Name << " : corrupted chunk of process " << Pid << std::endl;
+    }
+
+    Cursor += Length;
+  }
+
+  return true;
+}
+
+
+
+/**
+ * \brief   Entry point of the decoder
+ *
+ * \param   argc      Number of arguments
+ * \param   argv      Values of arguments (binary logs, the standard input if none)
+ *
+ * \return            EXIT_SUCCESS if all the logs have been decoded
+ * \return            EXIT_FAILURE if an error occurred
+ */
+int main(int argc, char *argv[])
+{
+  bool Success = true;
+
+  if(argc < 2)
+  {
+    return (Decode(std::cin, "<stdin>") ? EXIT_SUCCESS : EXIT_FAILURE);
+  }
+
+  for(int Index = 1; Index < argc; Index++)
+  {
+    std::ifstream Input(argv[Index], std::ios::binary);
+
+    if(! Input)
+    {
+      std::cerr << argv[Index] << " : cannot be opened" << std::endl;
+      Success = false;
+      continue;
+    }
+
+    Success = Decode(Input, argv[Index]) && Success;
+  }
+
+  return (Success ? EXIT_SUCCESS : EXIT_FAILURE);
+}
@@ -0,0 +1,196 @@
+/**
+ * \file histogram.cpp
+ *
+ * \brief Module for latency histograms
+ *
+ * \author Olivier de BLIC
+ */
+
+
+
+// Standard headers
+#include <string.h>
+
+// Project headers
+#include "histogram.h"
+
+// Constant values
+#define SUB_BUCKETS             (1ULL << HISTOGRAM_SUB_BITS)
+
+
+
+/**
+ * \brief          Histogram constructor
+ */
+HISTOGRAM::HISTOGRAM()
+{
+  memset((void*)_Shards, 0, sizeof(_Shards));
+}
+
+
+
+/**
+ * \brief          Records a value
+ *
+ * \param Value    Value to record (higher values are counted in the last bucket)
+ */
+void HISTOGRAM::Record(unsigned long long Value)
+{
+  // Threads are spread over the shards in turn
+  if(_Shard == -1)
+  {
+    _Shard = __sync_fetch_and_add(&_Threads, 1) % HISTOGRAM_SHARDS;
+  }
+
+  SHARD& Shard = _Shards[_Shard];
+
+  __sync_fetch_and_add(&Shard.Counts[GetBucket(Value)], 1);
+  __sync_fetch_and_add(&Shard.Count, 1);
+  __sync_fetch_and_add(&Shard.Sum, Value);
+
+  unsigned long long Max = Shard.Max;
+
+  while(Value > Max)
+  {
+    unsigned long long Seen = __sync_val_compare_and_swap(&Shard.Max, Max, Value);
+
+    if(Seen == Max)
+    {
+      break;
+    }
+
+    Max = Seen;
+  }
+}
+
+
+
+/**
+ * \brief          Merges the shards of the histogram
+ *
+ * \param Data     Merged values (cleared first)
+ */
+void HISTOGRAM::Merge(HISTOGRAM_DATA& Data) const
+{
+  memset(&Data, 0, sizeof(Data));
+
+  for(int Index = 0; Index < HISTOGRAM_SHARDS; Index++)
+  {
+    const SHARD& Shard = _Shards[Index];
+
+    for(int Bucket = 0; Bucket < HISTOGRAM_BUCKETS; Bucket++)
+    {
+      Data.Counts[Bucket] += Shard.Counts[Bucket];
+    }
+
+    Data.Count += Shard.Count;
+    Data.Sum += Shard.Sum;
+
+    if(Shard.Max > Data.Max)
+    {
+      Data.Max = Shard.Max;
+    }
+  }
+}
+
+
+
+/**
+ * \brief          Value below which a part of the values are
+ *
+ * \param Data     Merged values
+ * \param Quantile Part of the values (from 0 to 1)
+ *
+ * \return         Highest value of the bucket of the quantile (0 if there is no value)
+ */
+unsigned long long HISTOGRAM::GetPercentile(const HISTOGRAM_DATA& Data, double Quantile)
+{
+  unsigned long long Total = 0;
+
+  // Buckets are read one by one while being recorded : their sum is used rather than the count
+  for(int Bucket = 0; Bucket < HISTOGRAM_BUCKETS; Bucket++)
+  {
+    Total += Data.Counts[Bucket];
+  }
+
+  if(Total == 0)
+  {
+    return 0;
+  }
+
+  unsigned long long Rank = (unsigned long long)(Quantile * Total + 0.5);
+
+  if(Rank < 1)
+  {
+    Rank = 1;
+  }
+
+  unsigned long long Seen = 0;
+
+  for(unsigned int Bucket = 0; Bucket < HISTOGRAM_BUCKETS; Bucket++)
+  {
+    Seen += Data.Counts[Bucket];
+
+    if(Seen >= Rank)
+    {
+      unsigned long long Highest = (Bucket + 1 < HISTOGRAM_BUCKETS ? GetLowest(Bucket + 1) - 1 : Data.Max);
+
+      return (Highest < Data.Max ? Highest : Data.Max);
+    }
+  }
+
+  return Data.Max;
+}
+
+
+
+/**
+ * \brief          Bucket of a value
+ *
+ * \param Value    Value
+ *
+ * \return         Index of its bucket
+ */
+unsigned int HISTOGRAM::GetBucket(unsigned long long Value)
+{
+  if(Value < SUB_BUCKETS)
+  {
+    return Value;
+  }
+
+  // Power of two of the value, then its HISTOGRAM_SUB_BITS following bits
+  unsigned int Shift = 63 - __builtin_clzll(Value) - HISTOGRAM_SUB_BITS;
+
+  unsigned long long Bucket = Shift * SUB_BUCKETS + (Value >> Shift);
+
+  return (Bucket < HISTOGRAM_BUCKETS ? Bucket : HISTOGRAM_BUCKETS - 1);
+}
+
+
+
+/**
+ * \brief          Lowest value of a bucket
+ *
+ * \param Bucket   Index of the bucket
+ *
+ * \return         Lowest value counted in the bucket
+ */
+unsigned long long HISTOGRAM::GetLowest(unsigned int Bucket)
+{
+  if(Bucket < 2 * SUB_BUCKETS)
+  {
+    return Bucket;
+  }
+
+  unsigned int Shift = Bucket / SUB_BUCKETS - 1;
+
+  return (Bucket - Shift * SUB_BUCKETS) << Shift;
+}
+
+
+
+/// Shard of each thread
+__thread int HISTOGRAM::_Shard = -1;
+
+/// Number of threads given a shard
+volatile unsigned int HISTOGRAM::_Threads = 0;
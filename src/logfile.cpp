@@ -0,0 +1,286 @@
+/**
+ * \file logfile.cpp
+ *
+ * \brief Module for the memory mapped log file
+ *
+ * \author Olivier de BLIC
+ */
+
+
+
+// Standard headers
+#include <stddef.h>
+#include <stdio.h>
+#include <string.h>
+#include <string>
+#include <time.h>
+#include <unistd.h>
+#include <fcntl.h>
+#include <sys/mman.h>
+#include <sys/stat.h>
+
+// Project headers
+#include "logfile.h"
+#include "clock.h"
+#include "exception.h"
+
+// Constant values
+#define LOG_FILE_MODE           (0644)
+#define MS_PER_SECOND           (1000LL)
+#define ARCHIVE_SUFFIX_LENGTH   (64)
+
+
+
+/**
+ * \brief          Log file constructor (an existing file is rotated first)
+ *
+ * \param Path     Path of the log file
+ * \param SegmentBytes Size of a segment (in bytes)
+ * \param PeriodSec Maximal age of a segment (in seconds, 0 for no limit)
+ */
+LOGFILE::LOGFILE(const std::string& Path, size_t SegmentBytes, int PeriodSec)
+: _Path(Path), _SegmentBytes(SegmentBytes), _PeriodMs(PeriodSec * MS_PER_SECOND), _Pid(getpid()), _FileId(-1), _Map(NULL), _Used(0), _Flushed(0), _OpenedMs(0), _Rotate(false), _Archived(0)
+{
+  struct stat Status;
+
+  // The lines of a previous run are kept aside (a process being upgraded goes on writing its renamed file)
+  if(stat(_Path.c_str(), &Status) == 0 && Status.st_size > 0)
+  {
+    Archive();
+  }
+
+  if(! Open())
+  {
+    throw EXCEPTION("Error opening log file");
+  }
+}
+
+
+
+/**
+ * \brief          Log file destructor (the file is cut to its used length)
+ */
+LOGFILE::~LOGFILE()
+{
+  Close();
+}
+
+
+
+/**
+ * \brief          Appends data to the segment, rotating it if needed
+ *
+ * \param Data     Data to append
+ * \param Length   Length of the data
+ *
+ * \return         \b true if the data is written
+ * \return         \b false if no segment could be opened (the data is not written)
+ */
+bool LOGFILE::Append(const char* Data, size_t Length)
+{
+  // Data is never split over two segments, unless it is larger than a segment
+  bool Full = (_Used > 0 && _Used + Length > _SegmentBytes);
+  bool Old = (_PeriodMs > 0 && CLOCK::GetCoarseMs() - _OpenedMs >= _PeriodMs);
+
+  if(_Map != NULL && (Full || Old || _Rotate))
+  {
+    Archive();
+    Close();
+  }
+
+  _Rotate = false;
+
+  while(Length > 0)
+  {
+    if(_Map == NULL && ! Open())
+    {
+      return false;
+    }
+
+    size_t Count = _SegmentBytes - _Used;
+
+    if(Count > Length)
+    {
+      Count = Length;
+    }
+
+    memcpy(_Map + _Used, Data, Count);
+
+    _Used += Count;
+    Data += Count;
+    Length -= Count;
+
+    if(Length > 0)
+    {
+      Archive();
+      Close();
+    }
+  }
+
+  return true;
+}
+
+
+
+/**
+ * \brief          Asks the kernel to write the modified pages back (without waiting)
+ */
+void LOGFILE::Flush()
+{
+  if(_Map == NULL || _Used == _Flushed)
+  {
+    return;
+  }
+
+  size_t PageMask = sysconf(_SC_PAGESIZE) - 1;
+
+  size_t Begin = _Flushed & ~PageMask;
+
+  msync(_Map + Begin, _Used - Begin, MS_ASYNC);
+
+  _Flushed = _Used;
+}
+
+
+
+/**
+ * \brief          Starts a new segment at the next append
+ */
+void LOGFILE::Rotate()
+{
+  _Rotate = true;
+}
+
+
+
+/**
+ * \brief          Gives the segment up without cutting the file (mapping inherited from the parent process)
+ */
+void LOGFILE::Abandon()
+{
+  if(_Map == NULL)
+  {
+    return;
+  }
+
+  munmap(_Map, _SegmentBytes);
+
+  close(_FileId);
+
+  _Map = NULL;
+  _FileId = -1;
+}
+
+
+
+/**
+ * \brief          Getter for the process which has opened the file
+ *
+ * \return         Process identifier
+ */
+int LOGFILE::GetPid() const
+{
+  return _Pid;
+}
+
+
+
+/**
+ * \brief          Opens and maps a new segment
+ *
+ * \return         \b true if the segment is mapped
+ * \return         \b false if the file could not be created or mapped
+ */
+bool LOGFILE::Open()
+{
+  // The name may be taken by the process this one is upgrading : its file is left untouched
+  int FileId = open(_Path.c_str(), O_RDWR | O_CREAT | O_EXCL | O_CLOEXEC, LOG_FILE_MODE);
+
+  if(FileId == -1)
+  {
+    return false;
+  }
+
+  // Blocks are reserved at once : no allocation (nor SIGBUS on a full disk) when pages are first written
+  if(posix_fallocate(FileId, 0, _SegmentBytes) != 0)
+  {
+    // A sparse segment would fault once the disk is full : the file is given up instead
+    close(FileId);
+    unlink(_Path.c_str());
+    return false;
+  }
+
+  void* Map = mmap(NULL, _SegmentBytes, PROT_READ | PROT_WRITE, MAP_SHARED, FileId, 0);
+
+  if(Map == MAP_FAILED)
+  {
+    close(FileId);
+    return false;
+  }
+
+  _FileId = FileId;
+  _Map = (char*)Map;
+  _Used = 0;
+  _Flushed = 0;
+  _OpenedMs = CLOCK::GetCoarseMs();
+
+  return true;
+}
+
+
+
+/**
+ * \brief          Unmaps the segment and cuts the file to its used length
+ */
+void LOGFILE::Close()
+{
+  if(_Map == NULL)
+  {
+    return;
+  }
+
+  munmap(_Map, _SegmentBytes);
+
+  // Readers do not see the zeros of the unused part
+  if(ftruncate(_FileId, _Used) != 0)
+  {
+    // The file keeps its allocated size
+  }
+
+  close(_FileId);
+
+  _Map = NULL;
+  _FileId = -1;
+}
+
+
+
+/**
+ * \brief          Renames the file of the segment with a time stamp (unless another process has already)
+ */
+void LOGFILE::Archive()
+{
+  struct stat Segment;
+  struct stat Named;
+
+  // Once archived by a new process, the name is not the one of the segment anymore
+  if(_FileId != -1 && (fstat(_FileId, &Segment) != 0 || stat(_Path.c_str(), &Named) != 0 ||
+                       Segment.st_dev != Named.st_dev || Segment.st_ino != Named.st_ino))
+  {
+    return;
+  }
+
+  time_t Now = time(NULL);
+
+  struct tm Date;
+
+  localtime_r(&Now, &Date);
+
+  char Suffix[ARCHIVE_SUFFIX_LENGTH];
+
+  size_t Length = strftime(Suffix, sizeof(Suffix), ".%Y%m%d-%H%M%S", &Date);
+
+  snprintf(Suffix + Length, sizeof(Suffix) - Length, "-%d-%u", _Pid, _Archived++);
+
+  rename(_Path.c_str(), (_Path + Suffix).c_str());
+}
@@ -0,0 +1,283 @@
+/**
+ * \file logformat.cpp
+ *
+ * \brief Module for binary log encoding
+ *
+ * \author Olivier de BLIC
+ */
+
+
+
+// Standard headers
+#include <stddef.h>
+#include <stdint.h>
+#include <string.h>
+#include <string>
+#include <sstream>
+
+// Project headers
+#include "logformat.h"
+
+// Constant values
+#define STRING_MAX_LENGTH       (65535)
+
+
+
+/**
+ * \brief          Encoding of an argument
+ *
+ * \param Buffer   Buffer the argument is written to
+ * \param Room     Space left in the buffer
+ * \param Value    Value of the argument
+ *
+ * \return         Number of bytes written (0 if there is no room left)
+ */
+size_t LOGFORMAT::PutArg(char* Buffer, size_t Room, int Value)
+{
+  return PutInteger(Buffer, Room, LOG_ARG_SIGNED, (long long)Value);
+}
+
+size_t LOGFORMAT::PutArg(char* Buffer, size_t Room, unsigned int Value)
+{
+  return PutInteger(Buffer, Room, LOG_ARG_UNSIGNED, Value);
+}
+
+size_t LOGFORMAT::PutArg(char* Buffer, size_t Room, long Value)
+{
+  return PutInteger(Buffer, Room, LOG_ARG_SIGNED, (long long)Value);
+}
+
+size_t LOGFORMAT::PutArg(char* Buffer, size_t Room, unsigned long Value)
+{
+  return PutInteger(Buffer, Room, LOG_ARG_UNSIGNED, Value);
+}
+
+size_t LOGFORMAT::PutArg(char* Buffer, size_t Room, long long Value)
+{
+  return PutInteger(Buffer, Room, LOG_ARG_SIGNED, Value);
+}
+
+size_t LOGFORMAT::PutArg(char* Buffer, size_t Room, unsigned long long Value)
+{
+  return PutInteger(Buffer, Room, LOG_ARG_UNSIGNED, Value);
+}
+
+size_t LOGFORMAT::PutArg(char* Buffer, size_t Room, const char* Value)
+{
+  return PutString(Buffer, Room, Value, strlen(Value));
+}
+
+size_t LOGFORMAT::PutArg(char* Buffer, size_t Room, const std::string& Value)
+{
+  return PutString(Buffer, Room, Value.data(), Value.length());
+}
+
+
+
+/**
+ * \brief          Encoding of the header of a record (its arguments follow it)
+ *
+ * \param Buffer   Buffer of LOG_RECORD_HEADER bytes at least
+ * \param Id       Identifier of the call site
+ * \param TimeNs   Time of the log (in nanoseconds)
+ * \param Length   Length of the arguments
+ */
+void LOGFORMAT::PutRecord(char* Buffer, unsigned int Id, unsigned long long TimeNs, size_t Length)
+{
+  uint32_t SiteId = Id;
+  uint64_t Time = TimeNs;
+  uint16_t ArgsLength = Length;
+
+  Buffer[0] = LOG_RECORD;
+  memcpy(Buffer + 1, &SiteId, sizeof(SiteId));
+  memcpy(Buffer + 5, &Time, sizeof(Time));
+  memcpy(Buffer + 13, &ArgsLength, sizeof(ArgsLength));
+}
+
+
+
+/**
+ * \brief          Encoding of a call site definition
+ *
+ * \param Output   Buffer the definition is appended to
+ * \param Id       Identifier of the call site
+ * \param Type     Type of log
+ * \param Format   Format of the lines, arguments being given by '%' and a letter
+ * \param Source   Source line of the call site
+ */
+void LOGFORMAT::AppendSite(std::string& Output, unsigned int Id, int Type, const char* Format, const char* Source)
+{
+  uint32_t SiteId = Id;
+  uint8_t LogType = Type;
+  uint16_t FormatLength = strlen(Format);
+  uint16_t SourceLength = strlen(Source);
+
+  Output += LOG_SITE;
+  Output.append((const char*)&SiteId, sizeof(SiteId));
+  Output.append((const char*)&LogType, sizeof(LogType));
+  Output.append((const char*)&FormatLength, sizeof(FormatLength));
+  Output.append(Format, FormatLength);
+  Output.append((const char*)&SourceLength, sizeof(SourceLength));
+  Output.append(Source, SourceLength);
+}
+
+
+
+/**
+ * \brief          Encoding of a chunk
+ *
+ * \param Output   Buffer the chunk is appended to
+ * \param Pid      Process identifier
+ * \param Content  Definitions and records of the chunk
+ */
+void LOGFORMAT::AppendChunk(std::string& Output, unsigned int Pid, const std::string& Content)
+{
+  uint32_t ProcessId = Pid;
+  uint32_t Length = Content.length();
+
+  Output += LOG_CHUNK;
+  Output.append((const char*)&ProcessId, sizeof(ProcessId));
+  Output.append((const char*)&Length, sizeof(Length));
+  Output += Content;
+}
+
+
+
+/**
+ * \brief          Rendering of a line from its format and arguments
+ *
+ * \param Format   Format of the line
+ * \param Args     Encoded arguments
+ * \param Length   Length of the arguments
+ * \param Text     Buffer the line is appended to
+ */
+void LOGFORMAT::Render(const char* Format, const char* Args, size_t Length, std::string& Text)
+{
+  const char* End = Args + Length;
+
+  for(const char* Cursor = Format; *Cursor != '\0'; Cursor++)
+  {
+    if(*Cursor != '%' || Cursor[1] == '\0')
+    {
+      Text += *Cursor;
+      continue;
+    }
+
+    // Letter of the argument (its actual type is the encoded one)
+    Cursor++;
+
+    if(*Cursor == '%')
+    {
+      Text += '%';
+      continue;
+    }
+
+    std::ostringstream Value;
+
+    if(Args < End && (*Args == LOG_ARG_SIGNED || *Args == LOG_ARG_UNSIGNED) && End - Args >= 9)
+    {
+      uint64_t Bits;
+
+      memcpy(&Bits, Args + 1, sizeof(Bits));
+
+      if(*Args == LOG_ARG_SIGNED)
+      {
+        Value << (long long)Bits;
+      }
+      else
+      {
+        Value << (unsigned long long)Bits;
+      }
+
+      Args += 9;
+    }
+    else if(Args < End && *Args == LOG_ARG_STRING && End - Args >= 3)
+    {
+      uint16_t StringLength;
+
+      memcpy(&StringLength, Args + 1, sizeof(StringLength));
+
+      if(End - Args - 3 < StringLength)
+      {
+        StringLength = End - Args - 3;
+      }
+
+      Value.write(Args + 3, StringLength);
+
+      Args += 3 + StringLength;
+    }
+    else
+    {
+      // Missing argument (truncated record)
+      Value << "?";
+      Args = End;
+    }
+
+    Text += Value.str();
+  }
+}
+
+
+
+/**
+ * \brief          Encoding of an integer argument
+ *
+ * \param Buffer   Buffer the argument is written to
+ * \param Room     Space left in the buffer
+ * \param Tag      Type of the argument
+ * \param Value    Bits of the value
+ *
+ * \return         Number of bytes written (0 if there is no room left)
+ */
+size_t LOGFORMAT::PutInteger(char* Buffer, size_t Room, char Tag, unsigned long long Value)
+{
+  uint64_t Bits = Value;
+
+  if(Room < 1 + sizeof(Bits))
+  {
+    return 0;
+  }
+
+  Buffer[0] = Tag;
+  memcpy(Buffer + 1, &Bits, sizeof(Bits));
+
+  return 1 + sizeof(Bits);
+}
+
+
+
+/**
+ * \brief          Encoding of a string argument
+ *
+ * \param Buffer   Buffer the argument is written to
+ * \param Room     Space left in the buffer
+ * \param Value    Characters of the string
+ * \param Length   Length of the string (truncated if there is not enough room)
+ *
+ * \return         Number of bytes written (0 if there is no room left)
+ */
+size_t LOGFORMAT::PutString(char* Buffer, size_t Room, const char* Value, size_t Length)
+{
+  if(Room < 3)
+  {
+    return 0;
+  }
+
+  if(Length > Room - 3)
+  {
+    Length = Room - 3;
+  }
+
+  if(Length > STRING_MAX_LENGTH)
+  {
+    Length = STRING_MAX_LENGTH;
+  }
+
+  uint16_t StringLength = Length;
+
+  Buffer[0] = LOG_ARG_STRING;
+  memcpy(Buffer + 1, &StringLength, sizeof(StringLength));
+  memcpy(Buffer + 3, Value, Length);
+
+  return 3 + Length;
+}
@@ -0,0 +1,159 @@
+/**
+ * \file loglimit.cpp
+ *
+ * \brief Module for log call sites limiting
+ *
+ * \author Olivier de BLIC
+ */
+
+
+
+// Standard headers
+#include <stddef.h>
+
+// Project headers
+#include "loglimit.h"
+#include "clock.h"
+
+// Constant values
+#define US_PER_SECOND           (1000000LL)
+#define US_PER_MS               (1000LL)
+
+
+
+/**
+ * \brief          Limit constructor (registers the limit)
+ *
+ * \param Site     Call site of the limited log
+ * \param Rate     Number of lines per second (0 if sampled)
+ * \param Burst    Number of lines allowed at once above the rate
+ * \param Every    One line is written out of this number (1 if rate limited)
+ */
+LOGLIMIT::LOGLIMIT(const LOGSITE& Site, int Rate, int Burst, int Every)
+: _Site(Site), _IntervalUs(Rate > 0 ? US_PER_SECOND / Rate : 0), _ToleranceUs(Rate > 0 && Burst > 1 ? (US_PER_SECOND / Rate) * (Burst - 1) : 0), _Every(Every > 1 ? Every : 1), _ArrivalUs(0), _Calls(0), _Suppressed(0)
+{
+  unsigned int Id = __sync_fetch_and_add(&_Count, 1);
+
+  if(Id < LOG_LIMIT_MAX)
+  {
+    // Published once complete : the writer then reports its suppressed lines
+    __sync_synchronize();
+
+    _Limits[Id] = this;
+  }
+}
+
+
+
+/**
+ * \brief          Tells if a line can be written, and counts it as suppressed if not
+ *
+ * \return         \b true if the line has to be written
+ * \return         \b false if it is suppressed
+ */
+bool LOGLIMIT::Admit()
+{
+  bool Admitted = true;
+
+  if(_Every > 1)
+  {
+    Admitted = (__sync_fetch_and_add(&_Calls, 1) % _Every == 0);
+  }
+  else if(_IntervalUs > 0)
+  {
+    // The coarse clock is precise enough for rates up to a few hundred lines per second
+    long long Now = CLOCK::GetCoarseMs() * US_PER_MS;
+
+    long long Arrival = _ArrivalUs;
+
+    while(true)
+    {
+      long long Next = (Arrival > Now ? Arrival : Now);
+
+      if(Next - Now > _ToleranceUs)
+      {
+        Admitted = false;
+        break;
+      }
+
+      long long Seen = __sync_val_compare_and_swap(&_ArrivalUs, Arrival, Next + _IntervalUs);
+
+      if(Seen == Arrival)
+      {
+        break;
+      }
+
+      Arrival = Seen;
+    }
+  }
+
+  if(! Admitted)
+  {
+    __sync_fetch_and_add(&_Suppressed, 1);
+  }
+
+  return Admitted;
+}
+
+
+
+/**
+ * \brief          Takes the number of lines suppressed since the last call
+ *
+ * \return         Number of suppressed lines (reset to 0)
+ */
+unsigned long LOGLIMIT::TakeSuppressed()
+{
+  if(_Suppressed == 0)
+  {
+    return 0;
+  }
+
+  return __sync_lock_test_and_set(&_Suppressed, 0);
+}
+
+
+
+/**
+ * \brief          Getter for the call site
+ *
+ * \return         Call site of the limited log
+ */
+const LOGSITE& LOGLIMIT::GetSite() const
+{
+  return _Site;
+}
+
+
+
+/**
+ * \brief          Getter for the number of registered limits
+ *
+ * \return         Number of limits
+ */
+unsigned int LOGLIMIT::GetCount()
+{
+  return (_Count < LOG_LIMIT_MAX ? _Count : LOG_LIMIT_MAX);
+}
+
+
+
+/**
+ * \brief          Getter for a registered limit
+ *
+ * \param Id       Index of the limit
+ *
+ * \return         Pointer to the limit (NULL if it is still being registered)
+ */
+LOGLIMIT* LOGLIMIT::GetLimit(unsigned int Id)
+{
+  return (Id < LOG_LIMIT_MAX ? _Limits[Id] : NULL);
+}
+
+
+
+/// Number of registered limits
+volatile unsigned int LOGLIMIT::_Count = 0;
+
+/// Registered limits
+LOGLIMIT* volatile LOGLIMIT::_Limits[LOG_LIMIT_MAX];
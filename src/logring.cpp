@@ -0,0 +1,212 @@
+/**
+ * \file logring.cpp
+ *
+ * \brief Module for log lines queuing
+ *
+ * \author Olivier de BLIC
+ */
+
+
+
+// Standard headers
+#include <stddef.h>
+#include <stdint.h>
+#include <string.h>
+#include <string>
+
+// Project headers
+#include "logring.h"
+
+// Constant values
+
+
+
+/**
+ * \brief          Ring constructor
+ *
+ * \param Capacity Size of the ring (in bytes, power of 2)
+ */
+LOGRING::LOGRING(size_t Capacity)
+: _Data(new char[Capacity]), _Mask(Capacity - 1), _Tail(0), _Dropped(0), _Head(0), _Closed(false)
+{
+}
+
+
+
+/**
+ * \brief          Ring destructor
+ */
+LOGRING::~LOGRING()
+{
+  delete[] _Data;
+}
+
+
+
+/**
+ * \brief          Queues a line (producer side)
+ *
+ * \param Line     Text of the line
+ * \param Length   Length of the text
+ *
+ * \return         \b true if the line is queued
+ * \return         \b false if the ring is full (the line is dropped)
+ */
+bool LOGRING::Push(const char* Line, size_t Length)
+{
+  uint32_t Header = Length;
+
+  unsigned long Tail = _Tail;
+
+  if(sizeof(Header) + Length > _Mask + 1 - (Tail - _Head))
+  {
+    _Dropped++;
+    return false;
+  }
+
+  CopyIn(Tail, &Header, sizeof(Header));
+  CopyIn(Tail + sizeof(Header), Line, Length);
+
+  // The line is complete before the consumer can see it
+  __sync_synchronize();
+
+  _Tail = Tail + sizeof(Header) + Length;
+
+  return true;
+}
+
+
+
+/**
+ * \brief          Takes all the queued lines (consumer side)
+ *
+ * \param Batch    Buffer the lines are appended to
+ *
+ * \return         Number of lines taken
+ */
+size_t LOGRING::Pop(std::string& Batch)
+{
+  unsigned long Head = _Head;
+  unsigned long Tail = _Tail;
+
+  size_t Count = 0;
+
+  // The lines up to the tail read are complete
+  __sync_synchronize();
+
+  while(Head != Tail)
+  {
+    uint32_t Header;
+
+    CopyOut(Head, &Header, sizeof(Header));
+
+    size_t Offset = Batch.length();
+
+    Batch.resize(Offset + Header);
+
+    CopyOut(Head + sizeof(Header), &Batch[Offset], Header);
+
+    Head += sizeof(Header) + Header;
+    Count++;
+  }
+
+  // The lines are copied before the producer can overwrite them
+  __sync_synchronize();
+
+  _Head = Head;
+
+  return Count;
+}
+
+
+
+/**
+ * \brief          Getter for the number of dropped lines (consumer side)
+ *
+ * \return         Number of lines dropped since the ring creation
+ */
+unsigned long LOGRING::GetDropped() const
+{
+  return _Dropped;
+}
+
+
+
+/**
+ * \brief          Marks the ring as given up by its thread (it is then reused once empty)
+ */
+void LOGRING::Close()
+{
+  __sync_synchronize();
+
+  _Closed = true;
+}
+
+
+
+/**
+ * \brief          Tells if the ring has been given up by its thread
+ *
+ * \return         \b true if the thread has ended
+ * \return         \b false if the thread may still write lines
+ */
+bool LOGRING::IsClosed() const
+{
+  return _Closed;
+}
+
+
+
+/**
+ * \brief          Gives the ring to a new thread
+ */
+void LOGRING::Reopen()
+{
+  _Closed = false;
+}
+
+
+
+/**
+ * \brief          Copy to the ring, wrapping at its end
+ *
+ * \param Position Counter of the first byte
+ * \param Data     Data to copy
+ * \param Length   Length of the data
+ */
+void LOGRING::CopyIn(unsigned long Position, const void* Data, size_t Length)
+{
+  size_t Offset = Position & _Mask;
+  size_t First = _Mask + 1 - Offset;
+
+  if(First > Length)
+  {
+    First = Length;
+  }
+
+  memcpy(_Data + Offset, Data, First);
+  memcpy(_Data, (const char*)Data + First, Length - First);
+}
+
+
+
+/**
+ * \brief          Copy from the ring, wrapping at its end
+ *
+ * \param Position Counter of the first byte
+ * \param Data     Buffer the data is copied to
+ * \param Length   Length of the data
+ */
+void LOGRING::CopyOut(unsigned long Position, void* Data, size_t Length) const
+{
+  size_t Offset = Position & _Mask;
+  size_t First = _Mask + 1 - Offset;
+
+  if(First > Length)
+  {
+    First = Length;
+  }
+
+  memcpy(Data, _Data + Offset, First);
+  memcpy((char*)Data + First, _Data, Length - First);
+}
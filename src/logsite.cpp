@@ -0,0 +1,126 @@
+/**
+ * \file logsite.cpp
+ *
+ * \brief Module for log call sites
+ *
+ * \author Olivier de BLIC
+ */
+
+
+
+// Standard headers
+#include <stddef.h>
+
+// Project headers
+#include "logsite.h"
+
+// Constant values
+
+
+
+/**
+ * \brief          Call site constructor (registers the site)
+ *
+ * \param Type     Type of log (LOG_TYPE)
+ * \param Format   Format of the lines, arguments being given by '%' and a letter
+ * \param Source   Source line of the call site
+ */
+LOGSITE::LOGSITE(int Type, const char* Format, const char* Source)
+: _Type(Type), _Format(Format), _Source(Source)
+{
+  _Id = __sync_fetch_and_add(&_Count, 1);
+
+  if(_Id < LOG_SITE_MAX)
+  {
+    // Published once complete : the writer then describes the site before its first record
+    __sync_synchronize();
+
+    _Sites[_Id] = this;
+  }
+  else
+  {
+    _Id = LOG_SITE_MAX;
+  }
+}
+
+
+
+/**
+ * \brief          Getter for the site identifier
+ *
+ * \return         Identifier of the site (LOG_SITE_MAX if there are too many sites)
+ */
+unsigned int LOGSITE::GetId() const
+{
+  return _Id;
+}
+
+
+
+/**
+ * \brief          Getter for the log type
+ *
+ * \return         Type of log (LOG_TYPE)
+ */
+int LOGSITE::GetType() const
+{
+  return _Type;
+}
+
+
+
+/**
+ * \brief          Getter for the format
+ *
+ * \return         Format of the lines
+ */
+const char* LOGSITE::GetFormat() const
+{
+  return _Format;
+}
+
+
+
+/**
+ * \brief          Getter for the source line
+ *
+ * \return         Source line of the call site
+ */
+const char* LOGSITE::GetSource() const
+{
+  return _Source;
+}
+
+
+
+/**
+ * \brief          Getter for the number of registered sites
+ *
+ * \return         Number of sites (their identifiers are below it)
+ */
+unsigned int LOGSITE::GetCount()
+{
+  return (_Count < LOG_SITE_MAX ? _Count : LOG_SITE_MAX);
+}
+
+
+
+/**
+ * \brief          Getter for a registered site
+ *
+ * \param Id       Identifier of the site
+ *
+ * \return         Pointer to the site (NULL if it is still being registered)
+ */
+const LOGSITE* LOGSITE::GetSite(unsigned int Id)
+{
+  return (Id < LOG_SITE_MAX ? _Sites[Id] : NULL);
+}
+
+
+
+/// Number of registered sites
+volatile unsigned int LOGSITE::_Count = 0;
+
+/// Registered sites, by identifier
+const LOGSITE* volatile LOGSITE::_Sites[LOG_SITE_MAX];
@@ -122,6 +122,8 @@ int main(int argc, char *argv[])
 *           \par
 *           Use the make command to generate the available targets which are :
 *           \li \b all       debug or release version (release by default)
+*           \li \b decoder   seastar-decode, which renders the binary logs written with the option -B
+*           \li \b stat      seastar-stat, which prints the metrics mirrored with the option -X
 *           \li \b dep       dependencies generation
 *           \li \b tarball   backup of the whole project in a tarball
 *           \li \b clean     cleanup of the project directory
@@ -151,6 +153,21 @@ int main(int argc, char *argv[])
 *           \par
 *           Use \b netcat to connect to the server as host :
 *           \li nc localhost 1101
+*           \par
+*           Each extra port given with -e has its own identifiers and its own count of clients,
+*           as if it was served by another server :
+*           \li seastar -e 1102 -e 1103
+*           \par
+*           Once connected, the host can send the following lines :
+*           \li an empty line (or any unknown one) to get the number of connected clients
+*           \li RATE \b ms to change its tick interval (bounded by the options -m and -M)
+*           \li GET \b n to lease n more unique identifiers, replied as IDS=first-last,... ranges
+*               (GET \b n BIN replies BIDS, the number of ranges, then the first identifier and
+*               the length of each range, as 32 bits integers in network order); the lease ends
+*               with the next GET or the disconnection
+*           \li RESUME \b token to take back the ID of a previous connection : with the option -r,
+*               the first ID comes with a TOKEN= line, and the ID of a client that leaves is kept
+*               for the given time in case it comes back (the ID given at connection is released)
 *
 * \section  SECTION_PICTURE_HELP Screenshot of built-in help
 *
@@ -10,7 +10,14 @@
 
 // Standard headers
 #include <set>
+#include <vector>
 #include <pthread.h>
+#include <unistd.h>
+#include <errno.h>
+#include <sys/ioctl.h>
+#include <sys/eventfd.h>
+#include <sys/socket.h>
+#include <linux/sockios.h>
 
 // Project headers
 #include "manager.h"
@@ -18,8 +25,19 @@
 #include "connection.h"
 #include "socket.h"
 #include "console.h"
+#include "thread.h"
+#include "workers.h"
+#include "publisher.h"
+#include "sessions.h"
+#include "clock.h"
+#include "metrics.h"
 
 // Constant values
+#define GOODBYE                 "Bye\n"
+#define FAN_OUT_MIN_SLICE       (1024)
+#define FAN_OUT_ROUND_US        (1000)
+#define HOST_ID_CAPACITY        (1 << 20)
+#define LEASE_BUDGET            (HOST_ID_CAPACITY / 2)
 
 
 
@@ -27,9 +45,16 @@
  * \brief          Manager constructor
  */
 MANAGER::MANAGER()
-: OBJECT("MANAGER")
+: OBJECT("MANAGER"), _Workers(NULL), _Publisher(NULL), _Sessions(NULL), _Closing(false), _WakeId(eventfd(0, EFD_NONBLOCK | EFD_CLOEXEC))
 {
+  if(_WakeId == -1)
+  {
+    throw EXCEPTION("Error creating wake up descriptor");
+  }
+
   pthread_mutex_init(&_Lock, NULL);
+
+  SetNamespaces(1);
 }
 
 
@@ -39,65 +64,405 @@ MANAGER::MANAGER()
  */
 MANAGER::~MANAGER()
 {
-  CONTAINER::iterator it;
+  // After a shutdown, the connections are left to the end of the process
+  if(! _Closing)
+  {
+    CONTAINER::iterator it;
+
+    for(it = _Container.begin(); it != _Container.end(); it++)
+    {
+      delete (*it);
+    }
 
-  for(it = _Container.begin(); it != _Container.end(); it++)
+    _Container.clear();
+  }
+  else
   {
-    delete (*it);
-    _Container.erase(it);
+    bool Running = false;
+
+    pthread_mutex_lock(&_Lock);
+
+    for(CONTAINER::iterator it = _Container.begin(); it != _Container.end(); it++)
+    {
+      Running = Running || ! (*it)->_Stopped;
+    }
+
+    pthread_mutex_unlock(&_Lock);
+
+    // Threads given up at the deadline may still destroy their connection : the lock and the identifiers stay
+    if(Running)
+    {
+      return;
+    }
+  }
+
+  close(_WakeId);
+
+  for(size_t Index = 0; Index < _Allocators.size(); Index++)
+  {
+    delete _Allocators[Index];
   }
 
+  delete _Sessions;
+
   pthread_mutex_destroy(&_Lock);
 }
 
 
 
+/**
+ * \brief          Sets the number of identifiers namespaces (before any connection)
+ *
+ * \param  Count   Number of namespaces, each with its own identifiers and connections count
+ */
+void MANAGER::SetNamespaces(int Count)
+{
+  while((int)_Allocators.size() < Count)
+  {
+    _Allocators.push_back(new ALLOCATOR(HOST_ID_CAPACITY));
+  }
+
+  _Ids = _Allocators;
+
+  _Ids.resize(Count);
+
+  _Counts.assign(Count, 0);
+}
+
+
+
+/**
+ * \brief          Keeps the host identifiers of disconnected clients for a while
+ *
+ * \param  TtlMs   Time a disconnected client may resume its session (in milliseconds)
+ */
+void MANAGER::EnableSessions(int TtlMs)
+{
+  _Sessions = new SESSIONS(TtlMs);
+}
+
+
+
 /**
  * \brief          Creation of new connection
  *
- * \param  Socket  Socket already opened
+ * \param  Socket    Socket already opened
+ * \param  Namespace Identifiers namespace of the connection
  *
  * \return         Host identifier of newly created connection
  */
-int MANAGER::Create(SOCKET& Socket)
+int MANAGER::Create(SOCKET& Socket, int Namespace)
 {
-  // Actually, new ID generator reuses socket ID
-  int HostId = Socket.GetId();
+  // The master process only accepts : connections are run by the workers
+  if(_Workers != NULL && _Workers->IsMaster())
+  {
+    _Workers->Dispatch(Socket.GetId(), Namespace);
+
+    delete &Socket;
+
+    return -1;
+  }
+
+  unsigned long long Token = 0;
+
+  if(_Sessions != NULL)
+  {
+    // Identifiers of the expired sessions are available again
+    ExpireSessions();
+
+    Token = _Sessions->NewToken();
+  }
+
+  int HostId = NewHostID(Namespace);
 
-  // In the future, possible use of a dedicated ID generator
-  //int HostId = NewHostID();
+  CONNECTION* Connection;
 
-  CONNECTION* Connection = new CONNECTION(*this, Socket, HostId);
+  try
+  {
+    Connection = new CONNECTION(*this, Socket, Namespace, HostId, Token);
+  }
+
+  catch(EXCEPTION Exception)
+  {
+    FreeHostID(Namespace, HostId);
+    throw;
+  }
 
   Add(Connection);
 
+  // The thread may destroy the connection at once : it only runs once the connection is in the container
+  try
+  {
+    Connection->Start();
+  }
+
+  catch(EXCEPTION Exception)
+  {
+    Destroy(*Connection);
+    throw;
+  }
+
   return HostId;
 }
 
 
 
 /**
- * \brief          Destruction of a connection
+ * \brief          Creation of a connection taken over from another process
  *
- * \param  HostId  Host identifier of connection to destroy
+ * \param  Socket  Socket already opened
+ * \param  State   State of the connection in the previous process
+ * \param  Lease   Identifiers the client still holds from its GET commands
  */
-void MANAGER::Destroy(int HostId)
+void MANAGER::Adopt(SOCKET& Socket, const HANDOVER& State, const ID_RANGES& Lease)
 {
-  CONTAINER::iterator it;
+  ALLOCATOR& Allocator = GetAllocator(State.Namespace);
 
-  for(it = _Container.begin(); it != _Container.end(); it++)
+  if(! Allocator.Reserve(State.HostId))
   {
-    CONNECTION& Connection = *(CONNECTION*)(*it);
+    throw EXCEPTION("Host identifier of adopted connection already in use");
+  }
+
+  ID_RANGES Reserved;
+
+  unsigned int Count = 0;
 
-    if(Connection.GetHostID() == HostId)
+  // Identifiers the client holds stay its own : they are never handed out again by this process
+  for(size_t Range = 0; Range < Lease.size(); Range++)
+  {
+    for(unsigned int Id = Lease[Range].first; Id < Lease[Range].first + Lease[Range].second; Id++, Count++)
     {
-      Remove(&Connection);
-      delete &Connection;
-      return;
+      if(! Allocator.Reserve(Id))
+      {
+        Allocator.Release(Reserved);
+
+        FreeHostID(State.Namespace, State.HostId);
+
+        throw EXCEPTION("Leased identifier of adopted connection already in use");
+      }
+
+      if(! Reserved.empty() && Reserved.back().first + Reserved.back().second == Id)
+      {
+        Reserved.back().second++;
+      }
+      else
+      {
+        Reserved.push_back(std::make_pair(Id, 1U));
+      }
     }
   }
 
-  throw EXCEPTION("Object not removed (ID not found)");
+  // Counted whatever the budget : it was already granted by the previous process
+  Allocator.AddLeased(Count, ~0U);
+
+  CONNECTION* Connection;
+
+  try
+  {
+    Connection = new CONNECTION(*this, Socket, State.Namespace, State.HostId, State.Token, State.RateMs, State.DelayMs);
+  }
+
+  catch(EXCEPTION Exception)
+  {
+    ReleaseIds(State.Namespace, Reserved);
+    FreeHostID(State.Namespace, State.HostId);
+    throw;
+  }
+
+  Connection->_Lease.swap(Reserved);
+  Connection->_LeaseCount = Count;
+
+  Add(Connection);
+
+  // The thread may destroy the connection at once : it only runs once the connection is in the container
+  try
+  {
+    Connection->Start();
+  }
+
+  catch(EXCEPTION Exception)
+  {
+    Destroy(*Connection);
+    throw;
+  }
+}
+
+
+
+/**
+ * \brief          Destruction of a connection, by its thread when it ends
+ *
+ * \param  Connection Connection to destroy (only marked as stopped during a shutdown or a handover)
+ */
+void MANAGER::Destroy(CONNECTION& Connection)
+{
+  int Namespace = Connection.GetNamespace();
+  int HostId = Connection.GetHostID();
+  unsigned long long Token = Connection.GetToken();
+
+  bool Removed = false;
+
+  pthread_mutex_lock(&_Lock);
+
+  bool Stopped = _Closing;
+
+  // During the shutdown, connections are closed all together once all their threads have stopped
+  if(Stopped)
+  {
+    Connection._Stopped = true;
+  }
+  // Taken out under the same lock, so that a shutdown starting now never sees it
+  else
+  {
+    Removed = Remove(&Connection);
+  }
+
+  pthread_mutex_unlock(&_Lock);
+
+  // The connection belongs to the shutdown or to the handover now
+  if(Stopped)
+  {
+    return;
+  }
+
+  if(! Removed)
+  {
+    throw EXCEPTION("Object not removed (ID not found)");
+  }
+
+  if(_Workers != NULL)
+  {
+    _Workers->Update(Namespace, -1);
+  }
+
+  if(_Publisher != NULL)
+  {
+    _Publisher->Update(-1);
+  }
+
+  METRICS::Add(METRIC_CONNECTIONS, -1);
+
+  LOG_LINE_RATE(LOG_INFO, LOG_HOT_RATE, LOG_HOT_BURST, "Object removed");
+
+  delete &Connection;
+
+  // The identifier stays allocated while the client may come back
+  if(_Sessions != NULL && Token != 0)
+  {
+    _Sessions->Park(Token, Namespace, HostId);
+  }
+  else
+  {
+    FreeHostID(Namespace, HostId);
+  }
+}
+
+
+
+/**
+ * \brief          Gives back to a reconnected client the host identifier of its session
+ *
+ * \param  Namespace Identifiers namespace of the connection
+ * \param  HostId  Host identifier of the connection (replaced by the one of the session)
+ * \param  Token   Token of the connection (replaced by the one of the session)
+ * \param  Session Token presented by the client
+ *
+ * \return         \b true if the session has been resumed
+ * \return         \b false if the session is unknown or has expired
+ */
+bool MANAGER::Resume(int Namespace, int& HostId, unsigned long long& Token, unsigned long long Session)
+{
+  if(_Sessions == NULL)
+  {
+    return false;
+  }
+
+  int Previous = HostId;
+  int Resumed;
+
+  pthread_mutex_lock(&_Lock);
+
+  // Replaced under the lock, so that a handover never sees a released identifier
+  Resumed = (_Closing ? -1 : _Sessions->Resume(Session, Namespace));
+
+  if(Resumed != -1)
+  {
+    HostId = Resumed;
+    Token = Session;
+  }
+
+  pthread_mutex_unlock(&_Lock);
+
+  if(Resumed == -1)
+  {
+    return false;
+  }
+
+  // The identifier given at connection is not needed anymore
+  FreeHostID(Namespace, Previous);
+
+  METRICS::Add(METRIC_RESUMED);
+
+  return true;
+}
+
+
+
+/**
+ * \brief          Leases unique identifiers to a client, besides its host identifier
+ *
+ * \param  Namespace Identifiers namespace of the client
+ * \param  Count   Number of identifiers
+ * \param  Ranges  Leased ranges (as contiguous as possible)
+ *
+ * \return         \b true if the identifiers are leased
+ * \return         \b false if the leases of the whole server have reached their budget
+ */
+bool MANAGER::LeaseIds(int Namespace, unsigned int Count, ID_RANGES& Ranges)
+{
+  ALLOCATOR& Allocator = GetAllocator(Namespace);
+
+  // Leases never take the identifiers kept for the connections, whatever the number of clients
+  if(! Allocator.AddLeased(Count, LEASE_BUDGET))
+  {
+    return false;
+  }
+
+  try
+  {
+    Allocator.Allocate(Count, Ranges);
+  }
+
+  catch(EXCEPTION Exception)
+  {
+    Allocator.RemoveLeased(Count);
+    throw;
+  }
+
+  return true;
+}
+
+
+
+/**
+ * \brief          Ends a lease of identifiers
+ *
+ * \param  Namespace Identifiers namespace of the client
+ * \param  Ranges  Leased ranges (cleared)
+ */
+void MANAGER::ReleaseIds(int Namespace, ID_RANGES& Ranges)
+{
+  unsigned int Count = 0;
+
+  for(size_t Range = 0; Range < Ranges.size(); Range++)
+  {
+    Count += Ranges[Range].second;
+  }
+
+  GetAllocator(Namespace).Release(Ranges);
+  GetAllocator(Namespace).RemoveLeased(Count);
+
+  Ranges.clear();
 }
 
 
@@ -109,12 +474,19 @@ void MANAGER::Destroy(int HostId)
  */
 void MANAGER::Add(CONNECTION* Connection)
 {
-  App().Console.LogInfo("Adding object", SOURCE_LINE);
+  LOG_LINE_RATE(LOG_INFO, LOG_HOT_RATE, LOG_HOT_BURST, "Adding object");
 
   std::pair<CONTAINER::iterator, bool> Ret;
 
   pthread_mutex_lock(&_Lock);
+
   Ret = _Container.insert(Connection);
+
+  if(Ret.second)
+  {
+    _Counts[Connection->GetNamespace()]++;
+  }
+
   pthread_mutex_unlock(&_Lock);
 
   if(! Ret.second)
@@ -122,48 +494,504 @@ void MANAGER::Add(CONNECTION* Connection)
     throw EXCEPTION("Object not added (ID already exists)");
   }
 
-  App().Console.LogInfo("Object added", SOURCE_LINE);
+  if(_Workers != NULL)
+  {
+    _Workers->Update(Connection->GetNamespace(), 1);
+  }
+
+  if(_Publisher != NULL)
+  {
+    _Publisher->Update(1);
+  }
+
+  METRICS::Add(METRIC_CONNECTIONS);
+
+  LOG_LINE_RATE(LOG_INFO, LOG_HOT_RATE, LOG_HOT_BURST, "Object added");
 }
 
 
 
 /**
- * \brief          Remove a connection from the container
+ * \brief          Remove a connection from the container (the lock being held)
  *
  * \param Connection Pointer to the connection
+ *
+ * \return         \b true if the connection has been removed
+ * \return         \b false if it was not in the container
+ */
+bool MANAGER::Remove(CONNECTION* Connection)
+{
+  if(_Container.erase(Connection) == 0)
+  {
+    return false;
+  }
+
+  _Counts[Connection->GetNamespace()]--;
+
+  return true;
+}
+
+
+
+/**
+ * \brief          Stops the threads of all the connections, so that their sockets are not used anymore
+ *
+ * \param  DeadlineMs Monotonic time after which the threads still running are given up (in milliseconds)
+ * \param  Stopped Connections whose thread has stopped
+ *
+ * \return         Number of connections
  */
-void MANAGER::Remove(CONNECTION* Connection)
+size_t MANAGER::StopAll(long long DeadlineMs, std::vector<CONNECTION*>& Stopped)
 {
-  App().Console.LogInfo("Removing object", SOURCE_LINE);
+  pthread_mutex_lock(&_Lock);
+
+  _Closing = true;
+
+  size_t Total = _Container.size();
 
-  CONTAINER::iterator it;
+  pthread_mutex_unlock(&_Lock);
 
-  it = _Container.find(Connection);
+  // Threads waiting for their socket are woken up (the descriptor stays readable)
+  eventfd_write(_WakeId, 1);
 
-  if(it != _Container.end())
+  while(true)
   {
+    Stopped.clear();
+
     pthread_mutex_lock(&_Lock);
-    _Container.erase(it);
+
+    for(CONTAINER::iterator it = _Container.begin(); it != _Container.end(); it++)
+    {
+      if((*it)->_Stopped)
+      {
+        Stopped.push_back(*it);
+      }
+    }
+
     pthread_mutex_unlock(&_Lock);
+
+    if(Stopped.size() == Total || CLOCK::GetMonotonicMs() >= DeadlineMs)
+    {
+      return Total;
+    }
+
+    usleep(FAN_OUT_ROUND_US);
   }
-  else
+}
+
+
+
+/**
+ * \brief          Getter for the current number of connections
+ *
+ * \param  Namespace Identifiers namespace
+ *
+ * \return         Number of connections of the namespace
+ */
+int MANAGER::Count(int Namespace) const
+{
+  // In prefork mode, the count is the one of the whole server
+  if(_Workers != NULL)
   {
-    throw EXCEPTION("Object not removed (ID not found)");
+    return _Workers->GetCount(Namespace);
   }
 
-  App().Console.LogInfo("Object removed", SOURCE_LINE);
+  return _Counts[Namespace];
 }
 
 
 
 /**
- * \brief          Getter for the current number of connections
+ * \brief          Says goodbye to all the clients and closes the connections
+ *
+ * \param DeadlineMs Maximal duration of the goodbye (in milliseconds)
+ *
+ * \post           The sockets of all the connections are closed, the process has to exit.
+ */
+void MANAGER::Shutdown(int DeadlineMs)
+{
+  long long Deadline = CLOCK::GetMonotonicMs() + DeadlineMs;
+
+  std::vector<CONNECTION*> Stopped;
+
+  // Nothing else sends to a socket nor closes it once its thread has stopped
+  size_t Total = StopAll(Deadline, Stopped);
+
+  if(Stopped.size() < Total)
+  {
+    LOG_LINE(LOG_WARN, "%u connection(s) still running at the deadline, left to the end of the process", Total - Stopped.size());
+  }
+
+  // One worker per processor, unless there are too few connections to share
+  size_t WorkerCount = sysconf(_SC_NPROCESSORS_ONLN);
+
+  if(WorkerCount > Stopped.size() / FAN_OUT_MIN_SLICE)
+  {
+    WorkerCount = Stopped.size() / FAN_OUT_MIN_SLICE;
+  }
+
+  if(WorkerCount < 1)
+  {
+    WorkerCount = 1;
+  }
+
+  std::vector<FAN_OUT> Slices(WorkerCount);
+  std::vector<THREAD*> Workers;
+
+  for(size_t Index = 0; Index < Stopped.size(); Index++)
+  {
+    FAN_OUT& Slice = Slices[Index % WorkerCount];
+
+    Slice.SocketIds.push_back(Stopped[Index]->GetSocketId());
+    Slice.Frames.push_back(std::string());
+
+    // A frame partly sent by the thread is completed before the goodbye
+    if(Stopped[Index]->_Connected)
+    {
+      Stopped[Index]->_Scheduler.TakeUnsent(Slice.Frames.back());
+
+      Slice.Frames.back() += GOODBYE;
+    }
+  }
+
+  for(size_t Index = 0; Index < WorkerCount; Index++)
+  {
+    Slices[Index].DeadlineMs = Deadline;
+    Slices[Index].Delivered = 0;
+  }
+
+  // The current thread processes the first part itself
+  for(size_t Index = 1; Index < WorkerCount; Index++)
+  {
+    THREAD* Worker = new THREAD(RunFanOut, (void*)&Slices[Index], true);
+
+    Worker->Run();
+
+    Workers.push_back(Worker);
+  }
+
+  RunFanOut(&Slices[0]);
+
+  int Delivered = Slices[0].Delivered;
+
+  for(size_t Index = 0; Index < Workers.size(); Index++)
+  {
+    Workers[Index]->Join();
+
+    delete Workers[Index];
+
+    Delivered += Slices[Index + 1].Delivered;
+  }
+
+  LOG_LINE(LOG_INFO, "Goodbye delivered to %d client(s) out of %u", Delivered, Total);
+}
+
+
+
+/**
+ * \brief          Tells if the connections are being shut down
+ *
+ * \return         \b true if the shutdown has started
+ * \return         \b false otherwise
+ */
+bool MANAGER::IsClosing() const
+{
+  return _Closing;
+}
+
+
+
+/**
+ * \brief          Getter for the descriptor waking the connection threads up at a shutdown or a handover
+ *
+ * \return         Descriptor readable once the connections are closing
+ */
+int MANAGER::GetWakeId() const
+{
+  return _WakeId;
+}
+
+
+
+/**
+ * \brief          Stops all the connections without closing them, to hand them over
+ *
+ * \param  States  States of the connections handed over
+ * \param  Leases  Identifiers leased by each connection handed over (in the order of the states)
+ * \param  DeadlineMs Maximal duration of the stop, unsent frames included (in milliseconds)
+ *
+ * \post           Connection threads neither send nor receive anymore, the process has to exit.
+ */
+void MANAGER::Freeze(std::vector<HANDOVER>& States, std::vector<ID_RANGES>& Leases, int DeadlineMs)
+{
+  long long Deadline = CLOCK::GetMonotonicMs() + DeadlineMs;
+
+  std::vector<CONNECTION*> Stopped;
+
+  size_t Total = StopAll(Deadline, Stopped);
+
+  if(Stopped.size() < Total)
+  {
+    LOG_LINE(LOG_WARN, "%u connection(s) still running at the deadline, not handed over", Total - Stopped.size());
+  }
+
+  // Frames left by the threads are sent first, so that the new process starts on a line boundary
+  std::vector<std::string> Unsent(Stopped.size());
+
+  size_t Waiting = 0;
+
+  for(size_t Index = 0; Index < Stopped.size(); Index++)
+  {
+    if(Stopped[Index]->_Connected)
+    {
+      Stopped[Index]->_Scheduler.TakeUnsent(Unsent[Index]);
+    }
+
+    Waiting += (Unsent[Index].empty() ? 0 : 1);
+  }
+
+  while(Waiting > 0)
+  {
+    for(size_t Index = 0; Index < Stopped.size(); Index++)
+    {
+      if(Unsent[Index].empty())
+      {
+        continue;
+      }
+
+      ssize_t Count = send(Stopped[Index]->GetSocketId(), Unsent[Index].data(), Unsent[Index].length(), MSG_DONTWAIT | MSG_NOSIGNAL);
+
+      if(Count > 0)
+      {
+        Unsent[Index].erase(0, Count);
+      }
+      // The client is already gone : the new process sees it too
+      else if(Count < 0 && errno != EAGAIN && errno != EWOULDBLOCK && errno != EINTR)
+      {
+        Unsent[Index].clear();
+      }
+
+      Waiting -= (Unsent[Index].empty() ? 1 : 0);
+    }
+
+    if(Waiting == 0 || CLOCK::GetMonotonicMs() >= Deadline)
+    {
+      break;
+    }
+
+    usleep(FAN_OUT_ROUND_US);
+  }
+
+  // A client which would read a torn line is reset instead : it reconnects to the new process
+  struct linger Linger = {1, 0};
+
+  for(size_t Index = 0; Index < Stopped.size(); Index++)
+  {
+    CONNECTION& Connection = *Stopped[Index];
+
+    if(! Unsent[Index].empty())
+    {
+      setsockopt(Connection.GetSocketId(), SOL_SOCKET, SO_LINGER, &Linger, sizeof(Linger));
+
+      close(Connection.GetSocketId());
+
+      // Out of the container, so that a shutdown after a failed handover never uses the descriptor again
+      pthread_mutex_lock(&_Lock);
+
+      Remove(&Connection);
+
+      pthread_mutex_unlock(&_Lock);
+
+      if(_Workers != NULL)
+      {
+        _Workers->Update(Connection.GetNamespace(), -1);
+      }
+
+      if(_Publisher != NULL)
+      {
+        _Publisher->Update(-1);
+      }
+
+      METRICS::Add(METRIC_CONNECTIONS, -1);
+
+      // The object itself is left to the end of the process, as the ones handed over
+      ReleaseIds(Connection.GetNamespace(), Connection._Lease);
+
+      FreeHostID(Connection.GetNamespace(), Connection.GetHostID());
+
+      continue;
+    }
+
+    HANDOVER State;
+
+    State.SocketId = Connection.GetSocketId();
+    State.Namespace = Connection.GetNamespace();
+    State.HostId = Connection.GetHostID();
+    State.Token = Connection.GetToken();
+    State.RateMs = Connection.GetRate();
+    State.DelayMs = Connection.GetTickDelay();
+
+    States.push_back(State);
+
+    Leases.push_back(Connection._Lease);
+  }
+
+  if(Waiting > 0)
+  {
+    LOG_LINE(LOG_WARN, "%u slow client(s) reset, their frames could not be completed", Waiting);
+  }
+}
+
+
+
+/**
+ * \brief          Shares the connections count and the host identifiers with worker processes
+ *
+ * \param  Workers Pool of worker processes (the master process only dispatches the connections)
+ */
+void MANAGER::Attach(WORKERS& Workers)
+{
+  _Workers = &Workers;
+
+  // A shutdown only wakes up the connections of its own process (the descriptor is inherited by the fork)
+  close(_WakeId);
+
+  _WakeId = eventfd(0, EFD_NONBLOCK | EFD_CLOEXEC);
+
+  if(_WakeId == -1)
+  {
+    throw EXCEPTION("Error creating wake up descriptor");
+  }
+
+  // Identifiers published to local clients stay the ones in use
+  for(size_t Namespace = (_Publisher == NULL ? 0 : 1); Namespace < _Ids.size(); Namespace++)
+  {
+    _Ids[Namespace] = &Workers.GetAllocator(Namespace);
+  }
+}
+
+
+
+/**
+ * \brief          Publishes the connections count and the host identifiers in a shared page
  *
- * \return         Number of connections in the container
+ * \param  Publisher Page read by local clients (its identifiers are then the ones in use)
  */
-int MANAGER::Count() const
+void MANAGER::Publish(PUBLISHER& Publisher)
 {
-  return _Container.size();
+  _Publisher = &Publisher;
+
+  // Only the first namespace is published
+  _Ids[0] = &Publisher.GetAllocator();
+}
+
+
+
+/**
+ * \brief          Getter for the capacity of host identifiers
+ *
+ * \return         Maximal number of host identifiers
+ */
+unsigned int MANAGER::GetIdCapacity()
+{
+  return HOST_ID_CAPACITY;
+}
+
+
+
+/**
+ * \brief          Task of a shutdown worker
+ *
+ * \param  Arg     Pointer to the part of the connections to process
+ *
+ * \return         NULL
+ */
+void* MANAGER::RunFanOut(void* Arg)
+{
+  FAN_OUT& Slice = *(FAN_OUT*)Arg;
+
+  // Bytes still to send to each connection
+  std::vector<size_t> Remaining(Slice.SocketIds.size());
+
+  std::vector<bool> Done(Slice.SocketIds.size(), false);
+
+  size_t DoneCount = 0;
+
+  for(size_t Index = 0; Index < Slice.SocketIds.size(); Index++)
+  {
+    Remaining[Index] = Slice.Frames[Index].length();
+
+    // The client is already gone : its socket is only closed
+    if(Remaining[Index] == 0)
+    {
+      Done[Index] = true;
+      DoneCount++;
+    }
+  }
+
+  while(DoneCount < Slice.SocketIds.size())
+  {
+    for(size_t Index = 0; Index < Slice.SocketIds.size(); Index++)
+    {
+      if(Done[Index])
+      {
+        continue;
+      }
+
+      int SocketId = Slice.SocketIds[Index];
+
+      const std::string& Frames = Slice.Frames[Index];
+
+      if(Remaining[Index] > 0)
+      {
+        ssize_t Count = send(SocketId, Frames.data() + Frames.length() - Remaining[Index], Remaining[Index], MSG_DONTWAIT | MSG_NOSIGNAL);
+
+        if(Count > 0)
+        {
+          Remaining[Index] -= Count;
+        }
+        else if(Count < 0 && errno != EAGAIN && errno != EWOULDBLOCK && errno != EINTR)
+        {
+          // The client is already gone
+          Done[Index] = true;
+          DoneCount++;
+          continue;
+        }
+      }
+
+      int Unacknowledged = 0;
+
+      // The goodbye is delivered once the client has acknowledged all the sent data
+      if(Remaining[Index] == 0 && ioctl(SocketId, SIOCOUTQ, &Unacknowledged) == 0 && Unacknowledged == 0)
+      {
+        Done[Index] = true;
+        DoneCount++;
+        Slice.Delivered++;
+      }
+    }
+
+    if(CLOCK::GetMonotonicMs() >= Slice.DeadlineMs)
+    {
+      break;
+    }
+
+    if(DoneCount < Slice.SocketIds.size())
+    {
+      usleep(FAN_OUT_ROUND_US);
+    }
+  }
+
+  // Connections are reset : no lingering data and no TIME_WAIT left behind
+  struct linger Linger = {1, 0};
+
+  for(size_t Index = 0; Index < Slice.SocketIds.size(); Index++)
+  {
+    setsockopt(Slice.SocketIds[Index], SOL_SOCKET, SO_LINGER, &Linger, sizeof(Linger));
+
+    close(Slice.SocketIds[Index]);
+  }
+
+  return NULL;
 }
 
 
@@ -171,26 +999,60 @@ int MANAGER::Count() const
 /**
  * \brief          Generator for new host identifer
  *
+ * \param  Namespace Identifiers namespace
+ *
  * \return         New host identifer
  */
-int MANAGER::NewHostID()
+int MANAGER::NewHostID(int Namespace)
+{
+  return GetAllocator(Namespace).Allocate();
+}
+
+
+
+/**
+ * \brief          Release of a host identifier
+ *
+ * \param  Namespace Identifiers namespace
+ * \param  HostId  Host identifier no longer used
+ */
+void MANAGER::FreeHostID(int Namespace, int HostId)
+{
+  GetAllocator(Namespace).Release(HostId);
+}
+
+
+
+/**
+ * \brief          Release of the host identifiers of the expired sessions
+ */
+void MANAGER::ExpireSessions()
 {
-  /*
-  static int CurrentHostId = 0;
+  std::vector<SESSION> Expired;
+
+  _Sessions->Expire(Expired);
 
-  if(CurrentHostId <= 1000)
+  for(size_t Index = 0; Index < Expired.size(); Index++)
   {
-    Debug("CurrentHostId");
-    CurrentHostId++;
-    //_HostId = CurrentHostId;
+    FreeHostID(Expired[Index].Namespace, Expired[Index].HostId);
   }
-  else
+}
+
+
+
+/**
+ * \brief          Getter for the allocator of host identifiers in use
+ *
+ * \param  Namespace Identifiers namespace
+ *
+ * \return         Allocator of the published page, of the workers or of the manager itself
+ */
+ALLOCATOR& MANAGER::GetAllocator(int Namespace)
+{
+  if(Namespace < 0 || Namespace >= (int)_Ids.size())
   {
-    Debug("too many hosts");
-    throw "too many hosts";
-    // Vérifier si un client a libéré de la place
+    throw EXCEPTION("Unknown identifiers namespace");
   }
-  */
 
-  throw EXCEPTION("Should not be called because not implemented");
+  return *_Ids[Namespace];
 }
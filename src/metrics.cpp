@@ -0,0 +1,241 @@
+/**
+ * \file metrics.cpp
+ *
+ * \brief Module for metrics
+ *
+ * \author Olivier de BLIC
+ */
+
+
+
+// Standard headers
+#include <stdlib.h>
+#include <string.h>
+#include <pthread.h>
+
+// Project headers
+#include "metrics.h"
+#include "exception.h"
+
+// Constant values
+#define SHARD_ALIGNMENT         (64)
+
+
+
+/**
+ * \brief          Reads a metric
+ *
+ * \param Id       Metric
+ *
+ * \return         Sum of the values of all the shards
+ */
+long long METRICS::Read(METRIC_ID Id)
+{
+  long long Value = 0;
+
+  for(METRICS_SHARD* Shard = _Shards; Shard != NULL; Shard = Shard->Next)
+  {
+    Value += Shard->Values[Id];
+  }
+
+  return Value;
+}
+
+
+
+/**
+ * \brief          Reads all the metrics
+ *
+ * \param Values   Sums of the values of all the shards, by metric
+ */
+void METRICS::ReadAll(long long Values[METRIC_ID_COUNT])
+{
+  memset(Values, 0, sizeof(long long) * METRIC_ID_COUNT);
+
+  // Each value is read at once, but the shards are not read at the same time
+  for(METRICS_SHARD* Shard = _Shards; Shard != NULL; Shard = Shard->Next)
+  {
+    for(int Id = 0; Id < METRIC_ID_COUNT; Id++)
+    {
+      Values[Id] += Shard->Values[Id];
+    }
+  }
+}
+
+
+
+/**
+ * \brief          Getter for the description of a metric
+ *
+ * \param Id       Metric
+ *
+ * \return         Description of the metric
+ */
+const METRIC_INFO& METRICS::GetInfo(METRIC_ID Id)
+{
+  return _Infos[Id];
+}
+
+
+
+/**
+ * \brief          Reads a histogram
+ *
+ * \param Id       Histogram
+ * \param Data     Values merged from all the shards
+ */
+void METRICS::ReadHistogram(HISTOGRAM_ID Id, HISTOGRAM_DATA& Data)
+{
+  _Histograms[Id].Merge(Data);
+}
+
+
+
+/**
+ * \brief          Getter for the description of a histogram
+ *
+ * \param Id       Histogram
+ *
+ * \return         Description of the histogram
+ */
+const METRIC_INFO& METRICS::GetInfo(HISTOGRAM_ID Id)
+{
+  return _HistogramInfos[Id];
+}
+
+
+
+/**
+ * \brief          Getter for the shard of the calling thread, on its first update
+ *
+ * \return         Shard of the thread (taken from the free shards or created)
+ */
+METRICS_SHARD& METRICS::GetShard()
+{
+  pthread_once(&_KeyOnce, CreateKey);
+
+  int CancelState;
+
+  // Threads may be cancelled asynchronously : never while holding the lock
+  pthread_setcancelstate(PTHREAD_CANCEL_DISABLE, &CancelState);
+
+  pthread_mutex_lock(&_Lock);
+
+  METRICS_SHARD* Shard = _FreeShards;
+
+  if(Shard != NULL)
+  {
+    _FreeShards = Shard->NextFree;
+  }
+
+  pthread_mutex_unlock(&_Lock);
+
+  pthread_setcancelstate(CancelState, NULL);
+
+  if(Shard == NULL)
+  {
+    void* Memory;
+
+    if(posix_memalign(&Memory, SHARD_ALIGNMENT, sizeof(METRICS_SHARD)) != 0)
+    {
+      throw EXCEPTION("Error allocating metrics shard");
+    }
+
+    Shard = (METRICS_SHARD*)Memory;
+
+    memset(Memory, 0, sizeof(METRICS_SHARD));
+
+    // Published once complete : readers may then walk through it
+    METRICS_SHARD* Head;
+
+    do
+    {
+      Head = _Shards;
+      Shard->Next = Head;
+    }
+    while(! __sync_bool_compare_and_swap(&_Shards, Head, Shard));
+  }
+
+  pthread_setspecific(_Key, Shard);
+
+  _Shard = Shard;
+
+  return *Shard;
+}
+
+
+
+/**
+ * \brief          Gives up the shard of an ending thread
+ *
+ * \param Shard    Shard of the thread
+ */
+void METRICS::ReleaseShard(void* Shard)
+{
+  // Its values are kept : the next thread goes on adding to them
+  pthread_mutex_lock(&_Lock);
+
+  ((METRICS_SHARD*)Shard)->NextFree = _FreeShards;
+  _FreeShards = (METRICS_SHARD*)Shard;
+
+  pthread_mutex_unlock(&_Lock);
+
+  _Shard = NULL;
+}
+
+
+
+/**
+ * \brief          Creation of the key of the shards (once)
+ */
+void METRICS::CreateKey()
+{
+  pthread_key_create(&_Key, ReleaseShard);
+}
+
+
+
+/// Shard of each thread
+__thread METRICS_SHARD* METRICS::_Shard = NULL;
+
+/// List of all the shards
+METRICS_SHARD* volatile METRICS::_Shards = NULL;
+
+/// Shards of ended threads
+METRICS_SHARD* METRICS::_FreeShards = NULL;
+
+/// Mutex protecting the free shards
+pthread_mutex_t METRICS::_Lock = PTHREAD_MUTEX_INITIALIZER;
+
+/// Key giving back the shard of an ending thread
+pthread_key_t METRICS::_Key;
+
+/// Creation of the key
+pthread_once_t METRICS::_KeyOnce = PTHREAD_ONCE_INIT;
+
+/// Descriptions of the metrics (names and help texts of the Prometheus exposition format)
+const METRIC_INFO METRICS::_Infos[METRIC_ID_COUNT] =
+{
+  { "seastar_accepted_total",          "Connections accepted",                        METRIC_COUNTER },
+  { "seastar_accept_errors_total",     "Connections dropped while being accepted",    METRIC_COUNTER },
+  { "seastar_accept_overflows_total",  "Accept queue found full",                     METRIC_COUNTER },
+  { "seastar_connections",             "Connections open",                            METRIC_GAUGE   },
+  { "seastar_disconnected_total",      "Connections closed",                          METRIC_COUNTER },
+  { "seastar_bytes_sent_total",        "Bytes sent to clients",                       METRIC_COUNTER },
+  { "seastar_bytes_received_total",    "Bytes received from clients",                 METRIC_COUNTER },
+  { "seastar_send_errors_total",       "Errors sending to clients",                   METRIC_COUNTER },
+  { "seastar_ticks_sent_total",        "Host IDs sent on ticks",                      METRIC_COUNTER },
+  { "seastar_count_requests_total",    "Requests answered with the client count",     METRIC_COUNTER },
+  { "seastar_get_requests_total",      "Requests for leased IDs",                     METRIC_COUNTER },
+  { "seastar_resumed_total",           "Sessions resumed",                            METRIC_COUNTER }
+};
+
+/// Histograms
+HISTOGRAM METRICS::_Histograms[HISTOGRAM_ID_COUNT];
+
+/// Descriptions of the histograms
+const METRIC_INFO METRICS::_HistogramInfos[HISTOGRAM_ID_COUNT] =
+{
+  { "seastar_tick_lateness_us",        "Delay of the host ID sendings after their schedule",  METRIC_SUMMARY },
+  { "seastar_count_latency_us",        "Time from a request reception to its count reply",    METRIC_SUMMARY }
+};
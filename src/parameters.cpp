@@ -10,8 +10,11 @@
 
 // Standard headers
 #include <stdlib.h>
+#include <stdio.h>
 #include <unistd.h>
 #include <iostream>
+#include <vector>
+#include <sys/socket.h>
 
 // Project headers
 #include "parameters.h"
@@ -20,6 +23,12 @@
 
 // Constant values
 #define DEFLT_SERV_PORT  1101
+#define DEFLT_RATE_MIN   10
+#define DEFLT_RATE_MAX   60000
+#define DEFLT_BACKLOG    SOMAXCONN
+#define DEFLT_SHUTDOWN   1000
+#define DEFLT_LOG_SEGMENT 64
+#define LOG_SEGMENT_MAX  1024
 
 
 
@@ -27,7 +36,7 @@
  * \brief          Parameters constructor
  */
 PARAMETERS::PARAMETERS()
-: _AlreadyParsed(false), _Splashscreen(false), _Colors(false), _Help(false), _Verbose(false), _PortNum(DEFLT_SERV_PORT)
+: _AlreadyParsed(false), _Splashscreen(false), _Colors(false), _Help(false), _Verbose(false), _PortNum(DEFLT_SERV_PORT), _RateMinMs(DEFLT_RATE_MIN), _RateMaxMs(DEFLT_RATE_MAX), _Backlog(DEFLT_BACKLOG), _Acceptors(1), _Steering(false), _FastOpen(0), _DeferAccept(0), _KeepIdle(0), _KeepInterval(0), _KeepCount(0), _UserTimeout(0), _ShutdownMs(DEFLT_SHUTDOWN), _UpgradePath(), _Workers(0), _LocalPath(), _SharedPath(), _Endpoints(), _SessionTtlMs(0), _BinaryLog(), _Tsc(false), _LogFile(), _LogSegmentMb(DEFLT_LOG_SEGMENT), _LogPeriodSec(0), _AdminPort(0), _StatsPath()
 {
 }
 
@@ -66,7 +75,7 @@ void PARAMETERS::Parse(int ArgCnt, char *ArgVal[])
   {
     /// @todo Modify the option to disable colors
 
-    Character = getopt(ArgCnt, ArgVal, ":schvp:");
+    Character = getopt(ArgCnt, ArgVal, ":schvp:m:M:b:a:Af:d:k:u:t:U:w:l:S:e:r:B:TL:R:P:X:");
 
     switch(Character)
     {
@@ -101,6 +110,222 @@ void PARAMETERS::Parse(int ArgCnt, char *ArgVal[])
       }
       break;
 
+      case 'P':
+      {
+        int Port = atoi(optarg);
+
+        if(Port > 0 && Port <= 65535)
+        {
+          _AdminPort = Port;
+        }
+        else
+        {
+          throw EXCEPTION("Admin port number is out of range");
+        }
+      }
+      break;
+
+      case 'e':
+      {
+        int Port = atoi(optarg);
+
+        if(Port > 0 && Port <= 65535)
+        {
+          _Endpoints.push_back(Port);
+        }
+        else
+        {
+          throw EXCEPTION("Port number is out of range");
+        }
+      }
+      break;
+
+      case 'm':
+      case 'M':
+      {
+        int Rate = atoi(optarg);
+
+        if(Rate <= 0)
+        {
+          throw EXCEPTION("Tick interval bound is out of range");
+        }
+
+        if(Character == 'm')
+        {
+          _RateMinMs = Rate;
+        }
+        else
+        {
+          _RateMaxMs = Rate;
+        }
+      }
+      break;
+
+      case 'b':
+      {
+        int Backlog = atoi(optarg);
+
+        if(Backlog > 0)
+        {
+          _Backlog = Backlog;
+        }
+        else
+        {
+          throw EXCEPTION("Listening backlog is out of range");
+        }
+      }
+      break;
+
+      case 'a':
+      {
+        int Acceptors = atoi(optarg);
+
+        if(Acceptors > 0)
+        {
+          _Acceptors = Acceptors;
+        }
+        else
+        {
+          throw EXCEPTION("Number of acceptors is out of range");
+        }
+      }
+      break;
+
+      case 'A':
+        _Steering = true;
+      break;
+
+      case 'f':
+      case 'd':
+      {
+        int Value = atoi(optarg);
+
+        if(Value < 0)
+        {
+          throw EXCEPTION("Listening option is out of range");
+        }
+
+        if(Character == 'f')
+        {
+          _FastOpen = Value;
+        }
+        else
+        {
+          _DeferAccept = Value;
+        }
+      }
+      break;
+
+      case 'k':
+      {
+        if(sscanf(optarg, "%d,%d,%d", &_KeepIdle, &_KeepInterval, &_KeepCount) != 3 ||
+           _KeepIdle <= 0 || _KeepInterval <= 0 || _KeepCount <= 0)
+        {
+          throw EXCEPTION("Keep alive setting is invalid (expected idle,interval,count)");
+        }
+      }
+      break;
+
+      case 'u':
+      {
+        int Timeout = atoi(optarg);
+
+        if(Timeout > 0)
+        {
+          _UserTimeout = Timeout;
+        }
+        else
+        {
+          throw EXCEPTION("User timeout is out of range");
+        }
+      }
+      break;
+
+      case 't':
+      {
+        int Deadline = atoi(optarg);
+
+        if(Deadline >= 0)
+        {
+          _ShutdownMs = Deadline;
+        }
+        else
+        {
+          throw EXCEPTION("Shutdown deadline is out of range");
+        }
+      }
+      break;
+
+      case 'U':
+        _UpgradePath = optarg;
+      break;
+
+      case 'S':
+        _SharedPath = optarg;
+      break;
+
+      case 'l':
+        _LocalPath = optarg;
+      break;
+
+      case 'X':
+        _StatsPath = optarg;
+      break;
+
+      case 'B':
+        _BinaryLog = optarg;
+      break;
+
+      case 'T':
+        _Tsc = true;
+      break;
+
+      case 'L':
+        _LogFile = optarg;
+      break;
+
+      case 'R':
+      {
+        _LogPeriodSec = 0;
+
+        if(sscanf(optarg, "%d,%d", &_LogSegmentMb, &_LogPeriodSec) < 1 ||
+           _LogSegmentMb <= 0 || _LogSegmentMb > LOG_SEGMENT_MAX || _LogPeriodSec < 0)
+        {
+          throw EXCEPTION("Log rotation setting is invalid (expected size[,period])");
+        }
+      }
+      break;
+
+      case 'r':
+      {
+        int Ttl = atoi(optarg);
+
+        if(Ttl > 0)
+        {
+          _SessionTtlMs = Ttl;
+        }
+        else
+        {
+          throw EXCEPTION("Session TTL is out of range");
+        }
+      }
+      break;
+
+      case 'w':
+      {
+        int Workers = atoi(optarg);
+
+        if(Workers > 0)
+        {
+          _Workers = Workers;
+        }
+        else
+        {
+          throw EXCEPTION("Number of workers is out of range");
+        }
+      }
+      break;
+
       case '?':
         throw EXCEPTION("Unknow option in command line");
       break;
@@ -121,6 +346,21 @@ void PARAMETERS::Parse(int ArgCnt, char *ArgVal[])
   }
   while(Character != -1);
 
+  if(_RateMinMs > _RateMaxMs)
+  {
+    throw EXCEPTION("Minimal tick interval is greater than maximal one");
+  }
+
+  if(_Workers > 0 && ! _UpgradePath.empty())
+  {
+    throw EXCEPTION("Hot upgrade is not available with worker processes");
+  }
+
+  if(_Workers > 0 && _AdminPort != 0 && _StatsPath.empty())
+  {
+    throw EXCEPTION("Metrics of worker processes are only exposed along with a stats page");
+  }
+
   _AlreadyParsed = true;
 }
 
@@ -187,3 +427,280 @@ unsigned short PARAMETERS::GetServerPort() const
 {
   return _PortNum;
 }
+
+
+
+/**
+ * \brief          Getter for the minimal tick interval a client may request
+ *
+ * \return         Minimal tick interval (in milliseconds)
+ */
+int PARAMETERS::GetRateMin() const
+{
+  return _RateMinMs;
+}
+
+
+
+/**
+ * \brief          Getter for the maximal tick interval a client may request
+ *
+ * \return         Maximal tick interval (in milliseconds)
+ */
+int PARAMETERS::GetRateMax() const
+{
+  return _RateMaxMs;
+}
+
+
+
+/**
+ * \brief          Getter for the length of the queue of pending connections
+ *
+ * \return         Listening backlog
+ */
+int PARAMETERS::GetBacklog() const
+{
+  return _Backlog;
+}
+
+
+
+/**
+ * \brief          Getter for the number of acceptors listening on the server port
+ *
+ * \return         Number of acceptors
+ */
+int PARAMETERS::GetAcceptors() const
+{
+  return _Acceptors;
+}
+
+
+
+/**
+ * \brief          Getter for steering of connections to the acceptor of the receiving processor
+ *
+ * \return         \b true if enabled
+ * \return         \b false if disabled
+ */
+bool PARAMETERS::GetSteering() const
+{
+  return _Steering;
+}
+
+
+
+/**
+ * \brief          Getter for the TCP Fast Open queue length
+ *
+ * \return         Queue length (0 if disabled)
+ */
+int PARAMETERS::GetFastOpen() const
+{
+  return _FastOpen;
+}
+
+
+
+/**
+ * \brief          Getter for the deferred accept timeout
+ *
+ * \return         Maximal waiting time for the first data in seconds (0 if disabled)
+ */
+int PARAMETERS::GetDeferAccept() const
+{
+  return _DeferAccept;
+}
+
+
+
+/**
+ * \brief          Getter for the keep alive probes setting
+ *
+ * \param Idle     Idle time before the first probe (in seconds)
+ * \param Interval Time between two probes (in seconds)
+ * \param Count    Number of unanswered probes before dropping the connection
+ *
+ * \return         \b true if set
+ * \return         \b false if the system defaults apply
+ */
+bool PARAMETERS::GetKeepAlive(int& Idle, int& Interval, int& Count) const
+{
+  Idle = _KeepIdle;
+  Interval = _KeepInterval;
+  Count = _KeepCount;
+
+  return (_KeepIdle > 0);
+}
+
+
+
+/**
+ * \brief          Getter for the TCP user timeout
+ *
+ * \return         Maximal time sent data may stay unacknowledged in ms (0 for the system default)
+ */
+int PARAMETERS::GetUserTimeout() const
+{
+  return _UserTimeout;
+}
+
+
+
+/**
+ * \brief          Getter for the maximal duration of the goodbye to clients at shutdown
+ *
+ * \return         Shutdown deadline (in milliseconds)
+ */
+int PARAMETERS::GetShutdownDeadline() const
+{
+  return _ShutdownMs;
+}
+
+
+
+/**
+ * \brief          Getter for the path of the upgrade socket
+ *
+ * \return         Path of the Unix socket sockets are handed over through (empty if disabled)
+ */
+const std::string& PARAMETERS::GetUpgradePath() const
+{
+  return _UpgradePath;
+}
+
+
+
+/**
+ * \brief          Getter for the number of worker processes
+ *
+ * \return         Number of worker processes (0 if connections are run by a single process)
+ */
+int PARAMETERS::GetWorkers() const
+{
+  return _Workers;
+}
+
+
+
+/**
+ * \brief          Getter for the path of the Unix domain listening socket
+ *
+ * \return         Path of the socket for clients on the same host (empty if disabled)
+ */
+const std::string& PARAMETERS::GetLocalPath() const
+{
+  return _LocalPath;
+}
+
+
+
+/**
+ * \brief          Getter for the path of the page publishing the server state
+ *
+ * \return         Path of the shared memory file read by local clients (empty if disabled)
+ */
+const std::string& PARAMETERS::GetSharedPath() const
+{
+  return _SharedPath;
+}
+
+
+
+/**
+ * \brief          Getter for the ports of the additional endpoints
+ *
+ * \return         Port numbers, each endpoint having its own identifiers and connections count
+ */
+const std::vector<unsigned short>& PARAMETERS::GetEndpoints() const
+{
+  return _Endpoints;
+}
+
+
+
+/**
+ * \brief          Getter for the time a disconnected client may resume its session
+ *
+ * \return         Session TTL (in milliseconds, 0 if sessions are disabled)
+ */
+int PARAMETERS::GetSessionTtl() const
+{
+  return _SessionTtlMs;
+}
+
+
+
+/**
+ * \brief          Getter for the path of the binary log
+ *
+ * \return         Path of the file logs are written to, formatted only when decoded (empty if disabled)
+ */
+const std::string& PARAMETERS::GetBinaryLog() const
+{
+  return _BinaryLog;
+}
+
+
+
+/**
+ * \brief          Getter for the time stamp counter flag
+ *
+ * \return         \b true if the high resolution clock has to read the calibrated counter
+ * \return         \b false if it has to read the kernel clock
+ */
+bool PARAMETERS::GetTsc() const
+{
+  return _Tsc;
+}
+
+
+
+/**
+ * \brief          Getter for the path of the log file
+ *
+ * \return         Path of the memory mapped file lines are written to (empty if they go to the standard output)
+ */
+const std::string& PARAMETERS::GetLogFile() const
+{
+  return _LogFile;
+}
+
+
+
+/**
+ * \brief          Getter for the log file rotation
+ *
+ * \param SegmentMb Size of the file before rotation (in MB)
+ * \param PeriodSec Age of the file before rotation (in seconds, 0 for no limit)
+ */
+void PARAMETERS::GetLogRotation(int& SegmentMb, int& PeriodSec) const
+{
+  SegmentMb = _LogSegmentMb;
+  PeriodSec = _LogPeriodSec;
+}
+
+
+
+/**
+ * \brief          Getter for the administration port
+ *
+ * \return         Port the metrics are exposed on (0 if disabled)
+ */
+unsigned short PARAMETERS::GetAdminPort() const
+{
+  return _AdminPort;
+}
+
+
+
+/**
+ * \brief          Getter for the path of the page mirroring the metrics
+ *
+ * \return         Path of the shared memory file read by seastar-stat (empty if disabled)
+ */
+const std::string& PARAMETERS::GetStatsPath() const
+{
+  return _StatsPath;
+}
@@ -0,0 +1,313 @@
+/**
+ * \file publisher.cpp
+ *
+ * \brief Module for server state published in shared memory
+ *
+ * \author Olivier de BLIC
+ */
+
+
+
+// Standard headers
+#include <string>
+#include <vector>
+#include <stdio.h>
+#include <string.h>
+#include <unistd.h>
+#include <fcntl.h>
+#include <sys/mman.h>
+#include <sys/stat.h>
+
+// Project headers
+#include "publisher.h"
+#include "application.h"
+#include "exception.h"
+
+// Constant values
+#define PAGE_MAGIC              (0x53454132)
+#define CACHE_LINE_SIZE         (64)
+#define ALIGN_LINE(SIZE)        (((SIZE) + CACHE_LINE_SIZE - 1) / CACHE_LINE_SIZE * CACHE_LINE_SIZE)
+
+
+
+/**
+ * \brief          Publisher constructor (server side, creates the page)
+ *
+ * \param Path       Path of the published file
+ * \param ShardCount Number of shards
+ * \param IdCapacity Number of host identifiers
+ */
+PUBLISHER::PUBLISHER(const std::string& Path, int ShardCount, unsigned int IdCapacity)
+: OBJECT("PUBLISHER"), _FileId(-1), _Size(0), _Header(NULL), _Shard(0), _Allocator(NULL)
+{
+  pthread_mutex_init(&_Lock, NULL);
+
+  size_t IdOffset = ALIGN_LINE(sizeof(PAGE_HEADER)) + ShardCount * sizeof(PAGE_SHARD);
+
+  // The page is built aside, so that a running server keeps its own one until it stops
+  std::string Building = Path + ".new";
+
+  _FileId = open(Building.c_str(), O_RDWR | O_CREAT | O_TRUNC | O_CLOEXEC, 0644);
+
+  if(_FileId == -1 || ftruncate(_FileId, IdOffset + ALLOCATOR::GetMemorySize(IdCapacity)) == -1)
+  {
+    throw EXCEPTION("Error creating published page");
+  }
+
+  Map(IdOffset + ALLOCATOR::GetMemorySize(IdCapacity));
+
+  _Header->ShardCount = ShardCount;
+  _Header->IdCapacity = IdCapacity;
+  _Header->IdOffset = IdOffset;
+  _Header->Pid = getpid();
+
+  _Allocator = new ALLOCATOR(IdCapacity, (char*)_Header + IdOffset, true);
+
+  // Readers check the format last
+  __sync_synchronize();
+
+  _Header->Magic = PAGE_MAGIC;
+
+  if(rename(Building.c_str(), Path.c_str()) == -1)
+  {
+    throw EXCEPTION("Error publishing page");
+  }
+  else
+  {
+    LOG_LINE(LOG_INFO, "Server state now published in %s", Path);
+  }
+}
+
+
+
+/**
+ * \brief          Publisher constructor (reader side, maps an existing page)
+ *
+ * \param Path     Path of the published file
+ */
+PUBLISHER::PUBLISHER(const std::string& Path)
+: OBJECT("PUBLISHER"), _FileId(-1), _Size(0), _Header(NULL), _Shard(-1), _Allocator(NULL)
+{
+  pthread_mutex_init(&_Lock, NULL);
+
+  struct stat Status;
+
+  _FileId = open(Path.c_str(), O_RDWR | O_CLOEXEC);
+
+  if(_FileId == -1 || fstat(_FileId, &Status) == -1 || (size_t)Status.st_size < sizeof(PAGE_HEADER))
+  {
+    throw EXCEPTION("Error opening published page");
+  }
+
+  Map(Status.st_size);
+
+  if(_Header->Magic != PAGE_MAGIC ||
+     _Header->IdOffset < ALIGN_LINE(sizeof(PAGE_HEADER)) + _Header->ShardCount * sizeof(PAGE_SHARD) ||
+     _Header->IdOffset + ALLOCATOR::GetMemorySize(_Header->IdCapacity) > _Size)
+  {
+    throw EXCEPTION("Published page has an unknown format");
+  }
+
+  _Allocator = new ALLOCATOR(_Header->IdCapacity, (char*)_Header + _Header->IdOffset, false);
+}
+
+
+
+/**
+ * \brief          Publisher destructor
+ */
+PUBLISHER::~PUBLISHER()
+{
+  delete _Allocator;
+
+  if(_Header != NULL)
+  {
+    // Only the process which has created the page marks it as stopped (not its workers)
+    if(_Shard != -1 && _Header->Pid == getpid())
+    {
+      _Header->Pid = 0;
+    }
+
+    munmap(_Header, _Size);
+  }
+
+  if(_FileId != -1)
+  {
+    close(_FileId);
+  }
+
+  pthread_mutex_destroy(&_Lock);
+}
+
+
+
+/**
+ * \brief          Selects the shard updated by the current process (server side)
+ *
+ * \param Shard    Index of the shard
+ */
+void PUBLISHER::SetShard(int Shard)
+{
+  if(Shard < 0 || Shard >= (int)_Header->ShardCount)
+  {
+    throw EXCEPTION("Shard index is out of range");
+  }
+
+  _Shard = Shard;
+}
+
+
+
+/**
+ * \brief          Updates the number of connections of the current shard (server side)
+ *
+ * \param Delta    Number of connections added (negative if removed)
+ */
+void PUBLISHER::Update(int Delta)
+{
+  PAGE_SHARD* Shard = GetShard(_Shard);
+
+  // Only the threads of this process write this shard
+  pthread_mutex_lock(&_Lock);
+
+  __sync_fetch_and_add(&Shard->Sequence, 1);
+
+  Shard->Stats.Active += Delta;
+
+  if(Delta > 0)
+  {
+    Shard->Stats.Created += Delta;
+  }
+
+  if(Shard->Stats.Active > Shard->Stats.Peak)
+  {
+    Shard->Stats.Peak = Shard->Stats.Active;
+  }
+
+  __sync_fetch_and_add(&Shard->Sequence, 1);
+
+  pthread_mutex_unlock(&_Lock);
+}
+
+
+
+/**
+ * \brief          Clears a shard whose connections have been lost (server side)
+ *
+ * Only called once the process of the shard has been reaped : it is then the
+ * single writer of the shard.
+ *
+ * \param Shard    Index of the shard
+ */
+void PUBLISHER::ResetShard(int Shard)
+{
+  PAGE_SHARD* Lost = GetShard(Shard);
+
+  // The process may have died in the middle of an update : its values are kept as they are
+  if(Lost->Sequence & 1)
+  {
+    __sync_fetch_and_add(&Lost->Sequence, 1);
+  }
+
+  __sync_fetch_and_add(&Lost->Sequence, 1);
+
+  Lost->Stats.Active = 0;
+
+  __sync_fetch_and_add(&Lost->Sequence, 1);
+}
+
+
+
+/**
+ * \brief          Reads a consistent copy of the published state (no system call)
+ *
+ * \param Count    Number of connections of the whole server
+ * \param Shards   Statistics of each shard
+ */
+void PUBLISHER::Snapshot(int& Count, std::vector<SHARD_STATS>& Shards) const
+{
+  Shards.resize(_Header->ShardCount);
+
+  Count = 0;
+
+  // Each shard is consistent on its own, the sum is the one of the shards read
+  for(size_t Index = 0; Index < Shards.size(); Index++)
+  {
+    const PAGE_SHARD* Source = GetShard(Index);
+
+    unsigned Sequence;
+
+    do
+    {
+      Sequence = Source->Sequence;
+
+      __sync_synchronize();
+
+      memcpy(&Shards[Index], (const void*)&Source->Stats, sizeof(SHARD_STATS));
+
+      __sync_synchronize();
+    }
+    while((Sequence & 1) || Sequence != Source->Sequence);
+
+    Count += Shards[Index].Active;
+  }
+}
+
+
+
+/**
+ * \brief          Tells if the server publishing the page is still running
+ *
+ * \return         \b true if the page is alive
+ * \return         \b false if the server has stopped (the path may hold a newer page)
+ */
+bool PUBLISHER::IsAlive() const
+{
+  return (_Header->Pid != 0);
+}
+
+
+
+/**
+ * \brief          Getter for the host identifiers allocator of the page
+ *
+ * \return         Reference to the allocator
+ */
+ALLOCATOR& PUBLISHER::GetAllocator()
+{
+  return *_Allocator;
+}
+
+
+
+/**
+ * \brief          Maps the page file
+ *
+ * \param Size     Size of the file (in bytes)
+ */
+void PUBLISHER::Map(size_t Size)
+{
+  void* Memory = mmap(NULL, Size, PROT_READ | PROT_WRITE, MAP_SHARED, _FileId, 0);
+
+  if(Memory == MAP_FAILED)
+  {
+    throw EXCEPTION("Error mapping published page");
+  }
+
+  _Header = (PAGE_HEADER*)Memory;
+  _Size = Size;
+}
+
+
+
+/**
+ * \brief          Getter for a shard of the page
+ *
+ * \param Shard    Index of the shard
+ *
+ * \return         Shard in the page
+ */
+PAGE_SHARD* PUBLISHER::GetShard(int Shard) const
+{
+  return (PAGE_SHARD*)((char*)_Header + ALIGN_LINE(sizeof(PAGE_HEADER))) + Shard;
+}
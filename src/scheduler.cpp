@@ -0,0 +1,231 @@
+/**
+ * \file scheduler.cpp
+ *
+ * \brief Module for priority-aware sendings
+ *
+ * \author Olivier de BLIC
+ */
+
+
+
+// Standard headers
+#include <string>
+#include <deque>
+
+// Project headers
+#include "scheduler.h"
+#include "socket.h"
+#include "exception.h"
+
+// Constant values
+#define QUANTUM_BYTES           (64)
+#define BATCH_MAX_BYTES         (1024)
+#define QUEUE_MAX_FRAMES        (256)
+
+// Weights of the sending classes (same order as SEND_CLASS)
+#define WEIGHT_INTERACTIVE      (4)
+#define WEIGHT_TICK             (1)
+
+
+
+/**
+ * \brief          Scheduler constructor
+ *
+ * \param Socket   Reference to the socket frames are sent to
+ */
+SCHEDULER::SCHEDULER(SOCKET& Socket)
+: OBJECT("SCHEDULER"), _Socket(Socket), _Round(SEND_INTERACTIVE), _Credited(false), _Offset(0), _Coalesced(0)
+{
+  for(int Class = 0; Class < SEND_CLASS_COUNT; Class++)
+  {
+    _Deficit[Class] = 0;
+  }
+}
+
+
+
+/**
+ * \brief          Scheduler destructor
+ */
+SCHEDULER::~SCHEDULER()
+{
+}
+
+
+
+/**
+ * \brief          Queue a frame to send
+ *
+ * \param Class    Sending class of the frame
+ * \param Frame    Data to send
+ */
+void SCHEDULER::Push(SEND_CLASS Class, const std::string& Frame)
+{
+  std::deque<std::string>& Queue = _Queues[Class];
+
+  if(Class == SEND_TICK && ! Queue.empty())
+  {
+    // Only the latest tick is worth sending
+    Queue.back() = Frame;
+    _Coalesced++;
+  }
+  else if(Queue.size() >= QUEUE_MAX_FRAMES)
+  {
+    throw EXCEPTION("Send queue overflow (client does not read)");
+  }
+  else
+  {
+    Queue.push_back(Frame);
+  }
+}
+
+
+
+/**
+ * \brief          Send as many queued frames as the socket accepts without blocking
+ *
+ * \return         \b true if all the frames are sent
+ * \return         \b false if some frames are still waiting
+ */
+bool SCHEDULER::Flush()
+{
+  while(_Offset < _Batch.length() || SelectNext())
+  {
+    size_t Count = _Socket.TrySend(_Batch, _Offset);
+
+    if(Count == 0)
+    {
+      // The socket is full, the remaining frames wait for the next call
+      return false;
+    }
+
+    _Offset += Count;
+
+    if(_Offset == _Batch.length())
+    {
+      _Batch.clear();
+      _Offset = 0;
+    }
+  }
+
+  return true;
+}
+
+
+
+/**
+ * \brief          Tells if frames are waiting to be sent
+ *
+ * \return         \b true if frames are waiting
+ * \return         \b false if nothing is waiting
+ */
+bool SCHEDULER::IsPending() const
+{
+  return (_Offset < _Batch.length() || IsQueued());
+}
+
+
+
+/**
+ * \brief          Takes the data not sent yet, once nothing sends to the socket anymore
+ *
+ * \param Unsent   Buffer the end of the batch being sent, then the queued frames, are appended to
+ */
+void SCHEDULER::TakeUnsent(std::string& Unsent)
+{
+  // The frame partly sent comes first, so that the client still reads whole lines
+  Unsent.append(_Batch, _Offset, _Batch.npos);
+
+  _Batch.clear();
+  _Offset = 0;
+
+  for(int Class = 0; Class < SEND_CLASS_COUNT; Class++)
+  {
+    for(size_t Index = 0; Index < _Queues[Class].size(); Index++)
+    {
+      Unsent += _Queues[Class][Index];
+    }
+
+    _Queues[Class].clear();
+  }
+}
+
+
+
+/**
+ * \brief          Getter for the number of coalesced ticks
+ *
+ * \return         Number of ticks merged with an already waiting one
+ */
+unsigned long SCHEDULER::GetCoalesced() const
+{
+  return _Coalesced;
+}
+
+
+
+/**
+ * \brief          Tells if frames are waiting in the queues
+ *
+ * \return         \b true if at least one queue is not empty
+ * \return         \b false if all the queues are empty
+ */
+bool SCHEDULER::IsQueued() const
+{
+  for(int Class = 0; Class < SEND_CLASS_COUNT; Class++)
+  {
+    if(! _Queues[Class].empty())
+    {
+      return true;
+    }
+  }
+
+  return false;
+}
+
+
+
+/**
+ * \brief          Move the next frames to send in the batch, according to the weights
+ *
+ * \return         \b true if at least one frame has been moved
+ * \return         \b false if all the queues are empty
+ */
+bool SCHEDULER::SelectNext()
+{
+  static const int Weights[SEND_CLASS_COUNT] = { WEIGHT_INTERACTIVE, WEIGHT_TICK };
+
+  // Several frames are gathered so that a single system call sends them
+  while(_Batch.length() < BATCH_MAX_BYTES && IsQueued())
+  {
+    std::deque<std::string>& Queue = _Queues[_Round];
+
+    if(Queue.empty())
+    {
+      // An idle class does not keep its credit
+      _Deficit[_Round] = 0;
+    }
+    else
+    {
+      if(! _Credited)
+      {
+        _Deficit[_Round] += Weights[_Round] * QUANTUM_BYTES;
+        _Credited = true;
+      }
+
+      if((int)Queue.front().length() <= _Deficit[_Round])
+      {
+        _Deficit[_Round] -= Queue.front().length();
+        _Batch += Queue.front();
+        Queue.pop_front();
+        continue;
+      }
+    }
+
+    // Next class in the round
+    _Round = (_Round + 1) % SEND_CLASS_COUNT;
+    _Credited = false;
+  }
+
+  return (_Offset < _Batch.length());
+}
@@ -0,0 +1,173 @@
+/**
+ * \file sessions.cpp
+ *
+ * \brief Module for resumable sessions
+ *
+ * \author Olivier de BLIC
+ */
+
+
+
+// Standard headers
+#include <deque>
+#include <vector>
+#include <utility>
+#include <pthread.h>
+#include <errno.h>
+#include <sys/random.h>
+
+// Project headers
+#include "sessions.h"
+#include "exception.h"
+#include "clock.h"
+
+
+
+/**
+ * \brief          Sessions table constructor
+ *
+ * \param TtlMs    Time a disconnected client may resume its session (in milliseconds)
+ */
+SESSIONS::SESSIONS(int TtlMs)
+: OBJECT("SESSIONS"), _TtlMs(TtlMs)
+{
+  pthread_mutex_init(&_Lock, NULL);
+}
+
+
+
+/**
+ * \brief          Sessions table destructor
+ */
+SESSIONS::~SESSIONS()
+{
+  pthread_mutex_destroy(&_Lock);
+}
+
+
+
+/**
+ * \brief          Generator for a new session token
+ *
+ * \return         Random token, unknown to the table (never 0)
+ */
+unsigned long long SESSIONS::NewToken()
+{
+  unsigned long long Token = 0;
+
+  bool Taken = true;
+
+  // Nothing links a token to the other ones : a client cannot derive them from its own
+  while(Taken)
+  {
+    ssize_t Count = getrandom(&Token, sizeof(Token), 0);
+
+    if(Count == -1 && errno == EINTR)
+    {
+      continue;
+    }
+
+    if(Count != sizeof(Token))
+    {
+      throw EXCEPTION("Error drawing session token");
+    }
+
+    pthread_mutex_lock(&_Lock);
+
+    Taken = (Token == 0 || _Table.find(Token) != _Table.end());
+
+    pthread_mutex_unlock(&_Lock);
+  }
+
+  return Token;
+}
+
+
+
+/**
+ * \brief          Keeps the host identifier of a disconnected client
+ *
+ * \param Token    Token of the session
+ * \param Namespace Identifiers namespace of the client
+ * \param HostId   Host identifier, left allocated until it is resumed or expires
+ */
+void SESSIONS::Park(unsigned long long Token, int Namespace, int HostId)
+{
+  SESSION Session;
+
+  Session.Namespace = Namespace;
+  Session.HostId = HostId;
+  Session.ExpiryMs = CLOCK::GetCoarseMs() + _TtlMs;
+
+  pthread_mutex_lock(&_Lock);
+
+  _Table[Token] = Session;
+  _Expiries.push_back(std::make_pair(Session.ExpiryMs, Token));
+
+  pthread_mutex_unlock(&_Lock);
+}
+
+
+
+/**
+ * \brief          Gives back the host identifier of a session to a reconnected client
+ *
+ * \param Token    Token presented by the client
+ * \param Namespace Identifiers namespace of the new connection
+ *
+ * \return         Host identifier of the session (removed from the table)
+ * \return         -1 if the token is unknown, expired or from another namespace
+ */
+int SESSIONS::Resume(unsigned long long Token, int Namespace)
+{
+  int HostId = -1;
+
+  long long Now = CLOCK::GetCoarseMs();
+
+  pthread_mutex_lock(&_Lock);
+
+  TABLE::iterator it = _Table.find(Token);
+
+  // An expired session is left to Expire(), which releases its identifier
+  if(it != _Table.end() && it->second.Namespace == Namespace && it->second.ExpiryMs > Now)
+  {
+    HostId = it->second.HostId;
+
+    // Its entry in the queue is skipped when popped
+    _Table.erase(it);
+  }
+
+  pthread_mutex_unlock(&_Lock);
+
+  return HostId;
+}
+
+
+
+/**
+ * \brief          Removes the expired sessions
+ *
+ * \param Expired  Sessions whose host identifiers have to be released (appended)
+ */
+void SESSIONS::Expire(std::vector<SESSION>& Expired)
+{
+  long long Now = CLOCK::GetCoarseMs();
+
+  pthread_mutex_lock(&_Lock);
+
+  while(! _Expiries.empty() && _Expiries.front().first <= Now)
+  {
+    TABLE::iterator it = _Table.find(_Expiries.front().second);
+
+    // Resumed sessions are gone, and a session parked again has a later expiry
+    if(it != _Table.end() && it->second.ExpiryMs == _Expiries.front().first)
+    {
+      Expired.push_back(it->second);
+      _Table.erase(it);
+    }
+
+    _Expiries.pop_front();
+  }
+
+  pthread_mutex_unlock(&_Lock);
+}
@@ -12,12 +12,19 @@
 #include <socket.h>
 #include <poll.h>
 #include <string.h>
+#include <errno.h>
+#include <fcntl.h>
+#include <sys/un.h>
+#include <netinet/in.h>
+#include <netinet/tcp.h>
+#include <linux/filter.h>
 #include <sstream>
 
 // Project headers
 #include "socket.h"
 #include "application.h"
 #include "exception.h"
+#include "metrics.h"
 
 // Constant values
 
@@ -25,15 +32,17 @@
 
 /**
  * \brief          Socket constructor
+ *
+ * \param Domain   TCP socket or Unix domain stream socket (for clients on the same host)
  */
-SOCKET::SOCKET()
-: OBJECT("SOCKET")
+SOCKET::SOCKET(SOCKET_DOMAIN Domain)
+: OBJECT("SOCKET"), _ReserveId(-1)
 {
 #ifdef DEBUG
   App().Console.LogCtor(_ObjName);
 #endif
 
-  _SocketId = socket(AF_INET, SOCK_STREAM, 0);
+  _SocketId = socket(Domain == SOCKET_LOCAL ? AF_UNIX : AF_INET, SOCK_STREAM, 0);
 
   if(_SocketId == -1)
   {
@@ -41,7 +50,13 @@ SOCKET::SOCKET()
   }
   else
   {
-    App().Console.LogInfo("Socket now created");
+    LOG_LINE_RATE(LOG_INFO, LOG_HOT_RATE, LOG_HOT_BURST, "Socket now created");
+  }
+
+  // Addresses and keep alive only make sense for TCP
+  if(Domain == SOCKET_LOCAL)
+  {
+    return;
   }
 
   int SockOption = 1;
@@ -53,28 +68,23 @@ SOCKET::SOCKET()
   }
   else
   {
-    App().Console.LogInfo("Socket options set");
+    LOG_LINE_RATE(LOG_INFO, LOG_HOT_RATE, LOG_HOT_BURST, "Socket options set");
   }
 }
 
 
 
 /**
- * \brief          Socket constructor (reserved for accept method)
+ * \brief          Socket constructor (wrapper of an already opened socket)
  *
- * \param SocketId Already existing socket identifier (opened with accept)
+ * \param SocketId Already existing socket identifier (opened with accept or received from another process)
  */
 SOCKET::SOCKET(int SocketId)
-: OBJECT("MANAGER"), _SocketId(SocketId)
+: OBJECT("MANAGER"), _SocketId(SocketId), _ReserveId(-1)
 {
 #ifdef DEBUG
   App().Console.LogDtor(_ObjName);
 #endif
-
-  if(! IsConnected())
-  {
-    throw EXCEPTION("Error creating accepted socket");
-  }
 }
 
 
@@ -90,6 +100,11 @@ SOCKET::~SOCKET()
   /// @todo Use the function shutdown() instead of close()
 
   close(_SocketId);
+
+  if(_ReserveId != -1)
+  {
+    close(_ReserveId);
+  }
 }
 
 
@@ -103,15 +118,22 @@ std::string SOCKET::GetLocalAddr() const
 {
   std::ostringstream Buffer;
 
-  sockaddr_in SockAddr;
-  socklen_t SockAddrLen = sizeof(sockaddr_in);
+  sockaddr_storage SockAddr;
+  socklen_t SockAddrLen = sizeof(SockAddr);
 
   if(getsockname(_SocketId, (sockaddr*)&SockAddr, &SockAddrLen) != 0)
   {
     throw EXCEPTION("Error reading socket local address");
   }
 
-  Buffer << inet_ntoa(SockAddr.sin_addr) << ":" << SockAddr.sin_port;
+  if(SockAddr.ss_family == AF_UNIX)
+  {
+    Buffer << "unix:" << ((sockaddr_un*)&SockAddr)->sun_path;
+  }
+  else
+  {
+    Buffer << inet_ntoa(((sockaddr_in*)&SockAddr)->sin_addr) << ":" << ((sockaddr_in*)&SockAddr)->sin_port;
+  }
 
   return Buffer.str();
 }
@@ -127,15 +149,22 @@ std::string SOCKET::GetRemoteAddr() const
 {
   std::ostringstream Buffer;
 
-  sockaddr_in SockAddr;
-  socklen_t SockAddrLen = sizeof(sockaddr_in);
+  sockaddr_storage SockAddr;
+  socklen_t SockAddrLen = sizeof(SockAddr);
 
   if(getpeername(_SocketId, (sockaddr*)&SockAddr, &SockAddrLen) != 0)
   {
     throw EXCEPTION("Error reading socket remote address");
   }
 
-  Buffer << inet_ntoa(SockAddr.sin_addr) << ":" << SockAddr.sin_port;
+  if(SockAddr.ss_family == AF_UNIX)
+  {
+    Buffer << "unix:" << ((sockaddr_un*)&SockAddr)->sun_path;
+  }
+  else
+  {
+    Buffer << inet_ntoa(((sockaddr_in*)&SockAddr)->sin_addr) << ":" << ((sockaddr_in*)&SockAddr)->sin_port;
+  }
 
   return Buffer.str();
 }
@@ -170,7 +199,41 @@ void SOCKET::Bind(unsigned short int PortNum)
   }
   else
   {
-    App().Console.LogInfo("Socket now bound");
+    LOG_LINE(LOG_INFO, "Socket now bound");
+  }
+}
+
+
+
+/**
+ * \brief          Binds the socket to a file system path (Unix domain server mode)
+ *
+ * \param Path     Path of the socket (a stale socket file is replaced)
+ */
+void SOCKET::Bind(const std::string& Path)
+{
+  struct sockaddr_un LocalAddr;
+
+  if(Path.empty() || Path.length() >= sizeof(LocalAddr.sun_path))
+  {
+    throw EXCEPTION("Socket path is empty or too long");
+  }
+
+  memset(&LocalAddr, 0, sizeof(LocalAddr));
+
+  LocalAddr.sun_family = AF_UNIX;
+  strcpy(LocalAddr.sun_path, Path.c_str());
+
+  // The file left by a previous run would make the binding fail
+  unlink(Path.c_str());
+
+  if(bind(_SocketId, (sockaddr*)&LocalAddr, sizeof(LocalAddr)) == -1 )
+  {
+    throw EXCEPTION("Error binding socket");
+  }
+  else
+  {
+    LOG_LINE(LOG_INFO, "Socket now bound to %s", Path);
   }
 }
 
@@ -178,16 +241,24 @@ void SOCKET::Bind(unsigned short int PortNum)
 
 /**
  * \brief          Listens the socket (server mode)
+ *
+ * \param Backlog  Maximal length of the queue of pending connections
  */
-void SOCKET::Listen()
+void SOCKET::Listen(int Backlog)
 {
-  if(listen(_SocketId, 5) == -1 )
+  if(listen(_SocketId, Backlog) == -1 )
   {
     throw EXCEPTION("Impossible to listen");
   }
   else
   {
-    App().Console.LogInfo("Socket now listening");
+    LOG_LINE(LOG_INFO, "Socket now listening");
+  }
+
+  // The reserved descriptor is released only when descriptors are exhausted
+  if(_ReserveId == -1)
+  {
+    _ReserveId = open("/dev/null", O_RDONLY | O_CLOEXEC);
   }
 }
 
@@ -237,13 +308,248 @@ SOCKET& SOCKET::Accept()
   // Wrap the accepted socket in a new socket object
   SOCKET* AcceptedSocket = new SOCKET(AcceptedSocketId);
 
-  App().Console.LogInfo("Socket accepted");
+  LOG_LINE_RATE(LOG_INFO, LOG_HOT_RATE, LOG_HOT_BURST, "Socket accepted");
 
   return *AcceptedSocket;
 }
 
 
 
+/**
+ * \brief          Accepts a connection without blocking (server mode)
+ *
+ * \return         Pointer to the accepted socket
+ * \return         NULL if no connection is pending
+ *
+ * \note           When the process runs out of file descriptors, the pending connection is
+ *                 accepted on a reserved descriptor and immediately closed, so that the queue
+ *                 does not stay readable forever.
+ */
+SOCKET* SOCKET::TryAccept()
+{
+  int AcceptedSocketId = accept4(_SocketId, NULL, NULL, SOCK_CLOEXEC);
+
+  if(AcceptedSocketId == -1)
+  {
+    switch(errno)
+    {
+      case EAGAIN:
+      case EINTR:
+      case ECONNABORTED:
+        return NULL;
+
+      case EMFILE:
+      case ENFILE:
+        if(_ReserveId != -1)
+        {
+          close(_ReserveId);
+
+          AcceptedSocketId = accept(_SocketId, NULL, NULL);
+
+          if(AcceptedSocketId != -1)
+          {
+            close(AcceptedSocketId);
+          }
+
+          _ReserveId = open("/dev/null", O_RDONLY | O_CLOEXEC);
+        }
+        throw EXCEPTION("Connection dropped (too many open files)");
+
+      default:
+        throw EXCEPTION("Error accepting socket");
+    }
+  }
+
+  // Wrap the accepted socket in a new socket object
+  return new SOCKET(AcceptedSocketId);
+}
+
+
+
+/**
+ * \brief          Getter for the accept queue state (server mode)
+ *
+ * \param Length   Number of connections waiting to be accepted
+ * \param Backlog  Maximal length of the queue
+ *
+ * \note           Both are 0 for a Unix domain socket, which does not report them.
+ */
+void SOCKET::GetAcceptQueue(int& Length, int& Backlog) const
+{
+  struct tcp_info Info;
+  socklen_t InfoLen = sizeof(Info);
+
+  int Domain = AF_INET;
+  socklen_t DomainLen = sizeof(Domain);
+
+  getsockopt(_SocketId, SOL_SOCKET, SO_DOMAIN, &Domain, &DomainLen);
+
+  // A Unix domain socket does not report its queue
+  if(Domain == AF_UNIX)
+  {
+    Length = 0;
+    Backlog = 0;
+    return;
+  }
+
+  if(getsockopt(_SocketId, IPPROTO_TCP, TCP_INFO, &Info, &InfoLen) != 0)
+  {
+    throw EXCEPTION("Error reading socket accept queue");
+  }
+
+  // For a listening socket, the kernel reports the queue in these fields
+  Length = Info.tcpi_unacked;
+  Backlog = Info.tcpi_sacked;
+}
+
+
+
+/**
+ * \brief          Switches the socket to the non-blocking mode
+ */
+void SOCKET::SetNonBlocking()
+{
+  int Flags = fcntl(_SocketId, F_GETFL, 0);
+
+  if(Flags == -1 || fcntl(_SocketId, F_SETFL, Flags | O_NONBLOCK) == -1)
+  {
+    throw EXCEPTION("Error setting socket non-blocking");
+  }
+}
+
+
+
+/**
+ * \brief          Allows several sockets to listen on the same port (before binding)
+ */
+void SOCKET::SetReusePort()
+{
+  int SockOption = 1;
+
+  if(setsockopt(_SocketId, SOL_SOCKET, SO_REUSEPORT, (char*)&SockOption, sizeof(SockOption)) == -1)
+  {
+    throw EXCEPTION("Error setting socket port reuse");
+  }
+}
+
+
+
+/**
+ * \brief          Steers new connections to the listener of the receiving processor (server mode)
+ *
+ * \param Count    Number of sockets in the reuse port group
+ *
+ * \note           The connection received by the processor N goes to the listener
+ *                 bound in position N modulo Count in the group.
+ */
+void SOCKET::SetCpuSteering(int Count)
+{
+  // Index of the listener = processor which has received the packet (modulo the group size)
+  struct sock_filter Code[] =
+  {
+    { BPF_LD  | BPF_W   | BPF_ABS, 0, 0, (__u32)(SKF_AD_OFF + SKF_AD_CPU) },
+    { BPF_ALU | BPF_MOD | BPF_K,   0, 0, (__u32)Count },
+    { BPF_RET | BPF_A,             0, 0, 0 },
+  };
+
+  struct sock_fprog Program = { sizeof(Code) / sizeof(Code[0]), Code };
+
+  if(setsockopt(_SocketId, SOL_SOCKET, SO_ATTACH_REUSEPORT_CBPF, &Program, sizeof(Program)) == -1)
+  {
+    throw EXCEPTION("Error attaching the processor steering program");
+  }
+  else
+  {
+    LOG_LINE(LOG_INFO, "Processor steering program attached");
+  }
+}
+
+
+
+/**
+ * \brief          Enables TCP Fast Open on a listening socket (server mode)
+ *
+ * \param QueueLen Maximal number of pending Fast Open requests
+ */
+void SOCKET::SetFastOpen(int QueueLen)
+{
+  if(setsockopt(_SocketId, IPPROTO_TCP, TCP_FASTOPEN, (char*)&QueueLen, sizeof(QueueLen)) == -1)
+  {
+    throw EXCEPTION("Error setting socket fast open");
+  }
+  else
+  {
+    LOG_LINE(LOG_INFO, "Socket fast open enabled");
+  }
+}
+
+
+
+/**
+ * \brief          Defers accept until the client sends data (server mode)
+ *
+ * \param Seconds  Maximal waiting time for the first data
+ */
+void SOCKET::SetDeferAccept(int Seconds)
+{
+  if(setsockopt(_SocketId, IPPROTO_TCP, TCP_DEFER_ACCEPT, (char*)&Seconds, sizeof(Seconds)) == -1)
+  {
+    throw EXCEPTION("Error setting socket deferred accept");
+  }
+  else
+  {
+    LOG_LINE(LOG_INFO, "Socket deferred accept enabled");
+  }
+}
+
+
+
+/**
+ * \brief          Tunes the keep alive probes detecting dead peers
+ *
+ * \param Idle     Idle time before the first probe (in seconds)
+ * \param Interval Time between two probes (in seconds)
+ * \param Count    Number of unanswered probes before dropping the connection
+ *
+ * \note           Accepted sockets inherit the setting of the listening socket.
+ */
+void SOCKET::SetKeepAlive(int Idle, int Interval, int Count)
+{
+  if((setsockopt(_SocketId, IPPROTO_TCP, TCP_KEEPIDLE,  (char*)&Idle,     sizeof(Idle))     == -1 ) ||
+     (setsockopt(_SocketId, IPPROTO_TCP, TCP_KEEPINTVL, (char*)&Interval, sizeof(Interval)) == -1 ) ||
+     (setsockopt(_SocketId, IPPROTO_TCP, TCP_KEEPCNT,   (char*)&Count,    sizeof(Count))    == -1 ) )
+  {
+    throw EXCEPTION("Error setting socket keep alive");
+  }
+  else
+  {
+    LOG_LINE(LOG_INFO, "Socket keep alive set");
+  }
+}
+
+
+
+/**
+ * \brief          Bounds the time sent data may stay unacknowledged
+ *
+ * \param TimeoutMs Maximal time before dropping the connection (in milliseconds)
+ *
+ * \note           Accepted sockets inherit the setting of the listening socket.
+ */
+void SOCKET::SetUserTimeout(int TimeoutMs)
+{
+  if(setsockopt(_SocketId, IPPROTO_TCP, TCP_USER_TIMEOUT, (char*)&TimeoutMs, sizeof(TimeoutMs)) == -1)
+  {
+    throw EXCEPTION("Error setting socket user timeout");
+  }
+  else
+  {
+    LOG_LINE(LOG_INFO, "Socket user timeout set");
+  }
+}
+
+
+
 /**
  * \brief          Tells if the socket is connected
  *
@@ -300,51 +606,45 @@ bool SOCKET::IsDataWaiting()
 
 
 
-bool SOCKET::WaitData()
+/**
+ * \brief          Waits for incoming data until a timeout
+ *
+ * \param TimeoutMs Maximal waiting time (in milliseconds)
+ * \param WakeOnWrite Also wakes up when data can be sent without blocking
+ * \param WakeId   Descriptor which ends the wait once readable (-1 for none)
+ *
+ * \return         \b true if data is waiting
+ * \return         \b false if timed out (or only writable, or woken up)
+ */
+bool SOCKET::WaitData(int TimeoutMs, bool WakeOnWrite, int WakeId)
 {
-  //struct fd_set Checker = {_SocketId, POLLIN | POLLHUP, 0};
-  struct pollfd Checker = {_SocketId, POLLIN | POLLHUP, 0};
-  struct timespec Timer = {1, 0};
+  // A half-closed connection is reported as readable : the reception then returns no data
+  short Events = POLLIN | POLLRDHUP;
 
-  // Within one second, scan the reception buffer to get a possible new line character
-  //while(Timer.tv_sec > 0 || Timer.tv_nsec > 0)
+  if(WakeOnWrite)
   {
-    //printf(" > Looping...  s=%d, ns=%d\n", (int)(Timer.tv_sec), (int)(Timer.tv_nsec));
+    Events |= POLLOUT;
+  }
 
-    int Ret = ppoll(&Checker, 1, &Timer, NULL);
+  // A negative descriptor is ignored by the poll
+  struct pollfd Checkers[2] = { {_SocketId, Events, 0}, {WakeId, POLLIN, 0} };
 
-    // Check if error
-    if(Ret < 0)
-    {
-      throw EXCEPTION("Error on ppoll");
-    }
-    // Check if timed out
-    else if(Ret == 0)
-    {
-      App().Console.LogInfo("Time out on ppoll", SOURCE_LINE);
-      return false;
-    }
-    // Check if client has hangup
-    else if(Checker.revents & POLLHUP)
-    {
-      throw EXCEPTION("Hangup on ppoll");
-    }
-    // Check if client sent data
-    else if(Checker.revents & POLLIN)
-    {
-      App().Console.LogInfo("Data on ppoll", SOURCE_LINE);
-      return true;
-    }
-    else
-    {
-      App().Console.LogInfo("Else", SOURCE_LINE);
-    }
-  }
+  struct pollfd& Checker = Checkers[0];
 
-  struct timespec Time = {1, 0};
-  pthread_cond_timedwait(NULL, NULL, &Time);
+  int Ret = poll(Checkers, 2, TimeoutMs);
 
-  return false;
+  // Check if error (a signal interruption is handled as a timeout)
+  if(Ret < 0 && errno != EINTR)
+  {
+    throw EXCEPTION("Error on poll");
+  }
+  // Check if client has hangup
+  else if(Ret > 0 && (Checker.revents & (POLLHUP | POLLERR)) && ! (Checker.revents & (POLLIN | POLLRDHUP)))
+  {
+    throw EXCEPTION("Hangup on poll");
+  }
+
+  return (Ret > 0 && (Checker.revents & (POLLIN | POLLRDHUP)));
 }
 
 
@@ -356,20 +656,63 @@ bool SOCKET::WaitData()
  */
 void SOCKET::Send(const std::string& Data)
 {
-  ssize_t Count = send(_SocketId, Data.c_str(), Data.length(), 0);
+  ssize_t Count = send(_SocketId, Data.c_str(), Data.length(), MSG_NOSIGNAL);
 
   if(Count < 0)
   {
+    METRICS::Add(METRIC_SEND_ERRORS);
+
     throw EXCEPTION("Error sending data to socket");
   }
-  else if(Count < Data.length())
+
+  METRICS::Add(METRIC_BYTES_SENT, Count);
+
+  if(Count < Data.length())
   {
+    METRICS::Add(METRIC_SEND_ERRORS);
+
     throw EXCEPTION("Sending uncomplete data to socket");
   }
   else
   {
-    App().Console.LogInfo("All data sent to socket");
+    LOG_LINE_RATE(LOG_INFO, LOG_HOT_RATE, LOG_HOT_BURST, "All data sent to socket");
+  }
+}
+
+
+
+/**
+ * \brief          Sends data to socket without blocking
+ *
+ * \param Data     Data to send
+ * \param Offset   Position of the first byte to send in data
+ *
+ * \return         Number of bytes actually sent (0 if the socket would block)
+ */
+size_t SOCKET::TrySend(const std::string& Data, size_t Offset)
+{
+  ssize_t Count = send(_SocketId, Data.c_str() + Offset, Data.length() - Offset, MSG_NOSIGNAL | MSG_DONTWAIT);
+
+  if(Count < 0)
+  {
+    if(errno == EAGAIN || errno == EWOULDBLOCK || errno == EINTR)
+    {
+      return 0;
+    }
+
+    METRICS::Add(METRIC_SEND_ERRORS);
+
+    throw EXCEPTION("Error sending data to socket");
+  }
+
+  METRICS::Add(METRIC_BYTES_SENT, Count);
+
+  if(Offset + Count == Data.length())
+  {
+    LOG_LINE_RATE(LOG_INFO, LOG_HOT_RATE, LOG_HOT_BURST, "All data sent to socket");
   }
+
+  return Count;
 }
 
 
@@ -389,13 +732,16 @@ std::string SOCKET::Receive()
   {
     throw EXCEPTION("Error receiving data from socket");
   }
-  else if(Count < sizeof(Buffer))
+
+  METRICS::Add(METRIC_BYTES_RECEIVED, Count);
+
+  if(Count < sizeof(Buffer))
   {
-    App().Console.LogInfo("Few data received from socket");
+    LOG_LINE_RATE(LOG_INFO, LOG_HOT_RATE, LOG_HOT_BURST, "Few data received from socket (%d bytes)", (int)Count);
   }
   else
   {
-    App().Console.LogInfo("All data received from socket");
+    LOG_LINE_RATE(LOG_INFO, LOG_HOT_RATE, LOG_HOT_BURST, "All data received from socket");
   }
 
   return std::string((const char*)Buffer, Count);
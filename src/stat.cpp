@@ -0,0 +1,279 @@
+/**
+ * \file stat.cpp
+ *
+ * \brief Module containing the main() function of the metrics reader
+ *
+ * \author Olivier de BLIC
+ */
+
+
+
+// Standard headers
+#include <stdlib.h>
+#include <string.h>
+#include <time.h>
+#include <string>
+#include <vector>
+#include <iostream>
+#include <iomanip>
+#include <sstream>
+
+// Project headers
+#include "statpage.h"
+#include "metrics.h"
+#include "histogram.h"
+#include "exception.h"
+
+// Constant values
+#define DEFLT_INTERVAL_MS       (1000)
+#define NAME_WIDTH              (36)
+#define VALUE_WIDTH             (14)
+
+
+
+/**
+ * \brief   Difference of two copies of a slot
+ *
+ * \param   Previous  Older copy
+ * \param   Current   Newer copy
+ *
+ * \return            Time elapsed between the copies (in seconds, 0 if they are not comparable)
+ */
+static double GetElapsed(const STAT_SNAPSHOT& Previous, const STAT_SNAPSHOT& Current)
+{
+  // A slot taken over by another process starts from zero again
+  if(Previous.Pid != Current.Pid || Current.Pid == 0 || Current.TimeNs <= Previous.TimeNs)
+  {
+    return 0;
+  }
+
+  return (Current.TimeNs - Previous.TimeNs) / 1e9;
+}
+
+
+
+/**
+ * \brief   Printing of the metrics of all the slots
+ *
+ * \param   Page      Stats page
+ * \param   Previous  Copies of the slots at the previous interval (empty if none)
+ * \param   Current   Copies of the slots now
+ */
+static void Print(const STATPAGE& Page, const std::vector<STAT_SNAPSHOT>& Previous, const std::vector<STAT_SNAPSHOT>& Current)
+{
+  std::ostringstream Text;
+
+  Text << std::fixed << std::setprecision(1);
+
+  int Running = 0;
+
+  for(size_t Slot = 0; Slot < Current.size(); Slot++)
+  {
+    Running += (Current[Slot].Pid != 0 ? 1 : 0);
+  }
+
+  Text << "-- " << Running << " process(es)" << std::endl;
+
+  for(int Id = 0; Id < Page.GetMetricCount(); Id++)
+  {
+    const STAT_NAME& Name = Page.GetName(Id);
+
+    long long Total = 0;
+    double Rate = 0;
+
+    for(size_t Slot = 0; Slot < Current.size(); Slot++)
+    {
+      Total += Current[Slot].Values[Id];
+
+      double Elapsed = (Previous.empty() ? 0 : GetElapsed(Previous[Slot], Current[Slot]));
+
+      if(Elapsed > 0)
+      {
+        Rate += (Current[Slot].Values[Id] - Previous[Slot].Values[Id]) / Elapsed;
+      }
+    }
+
+    Text << "   " << std::left << std::setw(NAME_WIDTH) << Name.Name << std::right << std::setw(VALUE_WIDTH) << Total;
+
+    if(Name.Kind == METRIC_COUNTER && ! Previous.empty())
+    {
+      Text << std::setw(VALUE_WIDTH) << Rate << "/s";
+    }
+
+    Text << std::endl;
+  }
+
+  for(int Id = 0; Id < Page.GetHistogramCount(); Id++)
+  {
+    const STAT_NAME& Name = Page.GetName(Page.GetMetricCount() + Id);
+
+    // Only the values recorded during the interval, when there is a previous one
+    HISTOGRAM_DATA Interval;
+
+    memset(&Interval, 0, sizeof(Interval));
+
+    double Rate = 0;
+
+    for(size_t Slot = 0; Slot < Current.size(); Slot++)
+    {
+      const HISTOGRAM_DATA& Data = Current[Slot].Histograms[Id];
+
+      double Elapsed = (Previous.empty() ? 0 : GetElapsed(Previous[Slot], Current[Slot]));
+
+      const HISTOGRAM_DATA* Base = (Elapsed > 0 ? &Previous[Slot].Histograms[Id] : NULL);
+
+      if(Base == NULL && ! Previous.empty())
+      {
+        continue;
+      }
+
+      for(int Bucket = 0; Bucket < HISTOGRAM_BUCKETS; Bucket++)
+      {
+        Interval.Counts[Bucket] += Data.Counts[Bucket] - (Base != NULL ? Base->Counts[Bucket] : 0);
+      }
+
+      Interval.Count += Data.Count - (Base != NULL ? Base->Count : 0);
+      Interval.Sum += Data.Sum - (Base != NULL ? Base->Sum : 0);
+
+      // Highest value since the start : it only bounds the percentiles of the interval
+      if(Data.Max > Interval.Max)
+      {
+        Interval.Max = Data.Max;
+      }
+
+      if(Elapsed > 0)
+      {
+        Rate += (Data.Count - Base->Count) / Elapsed;
+      }
+    }
+
+    Text << "   " << std::left << std::setw(NAME_WIDTH) << Name.Name << std::right << std::setw(VALUE_WIDTH) << Interval.Count;
+
+    if(! Previous.empty())
+    {
+      Text << std::setw(VALUE_WIDTH) << Rate << "/s";
+    }
+
+    Text << "   p50 " << HISTOGRAM::GetPercentile(Interval, 0.5)
+         << "  p99 " << HISTOGRAM::GetPercentile(Interval, 0.99)
+         << "  p99.9 " << HISTOGRAM::GetPercentile(Interval, 0.999) << std::endl;
+  }
+
+  std::cout << Text.str() << std::flush;
+}
+
+
+
+/**
+ * \brief   Waiting until the next interval
+ *
+ * \param   IntervalMs Interval (in milliseconds)
+ */
+static void Sleep(int IntervalMs)
+{
+  struct timespec Delay;
+
+  Delay.tv_sec = IntervalMs / 1000;
+  Delay.tv_nsec = (IntervalMs % 1000) * 1000000L;
+
+  nanosleep(&Delay, NULL);
+}
+
+
+
+/**
+ * \brief   Entry point of the metrics reader
+ *
+ * \param   argc      Number of arguments
+ * \param   argv      Values of arguments (path of the stats page, then the interval in ms)
+ *
+ * \return            EXIT_SUCCESS if the page has been read until the end of the server
+ * \return            EXIT_FAILURE if an error occurred
+ */
+int main(int argc, char *argv[])
+{
+  if(argc < 2 || argc > 3)
+  {
+    std::cerr << "Use : " << argv[0] << " statspath [interval in ms, default " << DEFLT_INTERVAL_MS << "]" << std::endl;
+    return EXIT_FAILURE;
+  }
+
+  int IntervalMs = (argc > 2 ? atoi(argv[2]) : DEFLT_INTERVAL_MS);
+
+  if(IntervalMs <= 0)
+  {
+    std::cerr << argv[2] << " : invalid interval" << std::endl;
+    return EXIT_FAILURE;
+  }
+
+  STATPAGE* Page = NULL;
+
+  try
+  {
+    Page = new STATPAGE(argv[1]);
+  }
+
+  catch(EXCEPTION Exception)
+  {
+    std::cerr << argv[1] << " : " << Exception.GetDescription() << std::endl;
+    return EXIT_FAILURE;
+  }
+
+  if(IntervalMs < Page->GetInterval())
+  {
+    std::cerr << "The page is only updated every " << Page->GetInterval() << " ms" << std::endl;
+  }
+
+  std::vector<STAT_SNAPSHOT> Previous;
+  std::vector<STAT_SNAPSHOT> Current;
+
+  while(true)
+  {
+    Current.resize(Page->GetSlotCount());
+
+    for(int Slot = 0; Slot < Page->GetSlotCount(); Slot++)
+    {
+      Page->Snapshot(Slot, Current[Slot]);
+    }
+
+    Print(*Page, Previous, Current);
+
+    Previous.swap(Current);
+
+    Sleep(IntervalMs);
+
+    if(Page->IsAlive())
+    {
+      continue;
+    }
+
+    // A restarted server publishes a new page at the same path
+    try
+    {
+      STATPAGE* Newer = new STATPAGE(argv[1]);
+
+      if(! Newer->IsAlive())
+      {
+        delete Newer;
+        std::cerr << argv[1] << " : server has stopped" << std::endl;
+        break;
+      }
+
+      delete Page;
+
+      Page = Newer;
+
+      Previous.clear();
+    }
+
+    catch(EXCEPTION Exception)
+    {
+      std::cerr << argv[1] << " : " << Exception.GetDescription() << std::endl;
+      break;
+    }
+  }
+
+  delete Page;
+
+  return EXIT_SUCCESS;
+}
@@ -0,0 +1,365 @@
+/**
+ * \file statpage.cpp
+ *
+ * \brief Module for metrics mirrored in shared memory
+ *
+ * \author Olivier de BLIC
+ */
+
+
+
+// Standard headers
+#include <string>
+#include <vector>
+#include <stdio.h>
+#include <string.h>
+#include <unistd.h>
+#include <fcntl.h>
+#include <sys/mman.h>
+#include <sys/stat.h>
+
+// Project headers
+#include "statpage.h"
+#include "metrics.h"
+#include "histogram.h"
+#include "clock.h"
+#include "exception.h"
+
+// Constant values
+#define STAT_PAGE_MAGIC         (0x53455354)
+#define CACHE_LINE_SIZE         (64)
+#define ALIGN_LINE(SIZE)        (((SIZE) + CACHE_LINE_SIZE - 1) / CACHE_LINE_SIZE * CACHE_LINE_SIZE)
+
+
+
+/**
+ * \brief          Stats page constructor (server side, creates the page)
+ *
+ * \param Path       Path of the page file
+ * \param SlotCount  Number of slots
+ * \param IntervalMs Interval between two updates of a slot (in milliseconds)
+ */
+STATPAGE::STATPAGE(const std::string& Path, int SlotCount, int IntervalMs)
+: _FileId(-1), _Size(0), _Header(NULL), _Names(NULL), _Slot(0), _NextMs(0)
+{
+  size_t NameCount = METRIC_ID_COUNT + HISTOGRAM_ID_COUNT;
+  size_t SlotOffset = ALIGN_LINE(sizeof(STAT_HEADER)) + ALIGN_LINE(NameCount * sizeof(STAT_NAME));
+  size_t SlotSize = ALIGN_LINE(sizeof(STAT_SLOT) + METRIC_ID_COUNT * sizeof(long long) + HISTOGRAM_ID_COUNT * sizeof(HISTOGRAM_DATA));
+
+  // The page is built aside, so that a running server keeps its own one until it stops
+  std::string Building = Path + ".new";
+
+  _FileId = open(Building.c_str(), O_RDWR | O_CREAT | O_TRUNC | O_CLOEXEC, 0644);
+
+  if(_FileId == -1 || ftruncate(_FileId, SlotOffset + SlotCount * SlotSize) == -1)
+  {
+    throw EXCEPTION("Error creating stats page");
+  }
+
+  Map(SlotOffset + SlotCount * SlotSize, true);
+
+  _Header->Version = STAT_PAGE_VERSION;
+  _Header->SlotCount = SlotCount;
+  _Header->MetricCount = METRIC_ID_COUNT;
+  _Header->HistogramCount = HISTOGRAM_ID_COUNT;
+  _Header->BucketCount = HISTOGRAM_BUCKETS;
+  _Header->SlotOffset = SlotOffset;
+  _Header->SlotSize = SlotSize;
+  _Header->IntervalMs = IntervalMs;
+  _Header->Pid = getpid();
+
+  _Names = (STAT_NAME*)((char*)_Header + ALIGN_LINE(sizeof(STAT_HEADER)));
+
+  for(int Id = 0; Id < METRIC_ID_COUNT; Id++)
+  {
+    const METRIC_INFO& Info = METRICS::GetInfo((METRIC_ID)Id);
+
+    strncpy(_Names[Id].Name, Info.Name, STAT_NAME_LENGTH - 1);
+    _Names[Id].Kind = Info.Kind;
+  }
+
+  for(int Id = 0; Id < HISTOGRAM_ID_COUNT; Id++)
+  {
+    const METRIC_INFO& Info = METRICS::GetInfo((HISTOGRAM_ID)Id);
+
+    strncpy(_Names[METRIC_ID_COUNT + Id].Name, Info.Name, STAT_NAME_LENGTH - 1);
+    _Names[METRIC_ID_COUNT + Id].Kind = Info.Kind;
+  }
+
+  // Readers check the format last
+  __sync_synchronize();
+
+  _Header->Magic = STAT_PAGE_MAGIC;
+
+  if(rename(Building.c_str(), Path.c_str()) == -1)
+  {
+    throw EXCEPTION("Error publishing stats page");
+  }
+}
+
+
+
+/**
+ * \brief          Stats page constructor (reader side, maps an existing page read-only)
+ *
+ * \param Path     Path of the page file
+ */
+STATPAGE::STATPAGE(const std::string& Path)
+: _FileId(-1), _Size(0), _Header(NULL), _Names(NULL), _Slot(-1), _NextMs(0)
+{
+  struct stat Status;
+
+  _FileId = open(Path.c_str(), O_RDONLY | O_CLOEXEC);
+
+  if(_FileId == -1 || fstat(_FileId, &Status) == -1 || (size_t)Status.st_size < sizeof(STAT_HEADER))
+  {
+    throw EXCEPTION("Error opening stats page");
+  }
+
+  Map(Status.st_size, false);
+
+  size_t NameCount = _Header->MetricCount + _Header->HistogramCount;
+  size_t SlotSize = sizeof(STAT_SLOT) + _Header->MetricCount * sizeof(long long) + _Header->HistogramCount * sizeof(HISTOGRAM_DATA);
+
+  if(_Header->Magic != STAT_PAGE_MAGIC || _Header->Version != STAT_PAGE_VERSION ||
+     _Header->BucketCount != HISTOGRAM_BUCKETS || _Header->SlotSize < SlotSize ||
+     _Header->SlotOffset < ALIGN_LINE(sizeof(STAT_HEADER)) + NameCount * sizeof(STAT_NAME) ||
+     _Header->SlotOffset + (size_t)_Header->SlotCount * _Header->SlotSize > _Size)
+  {
+    throw EXCEPTION("Stats page has an unknown format");
+  }
+
+  _Names = (STAT_NAME*)((char*)_Header + ALIGN_LINE(sizeof(STAT_HEADER)));
+}
+
+
+
+/**
+ * \brief          Stats page destructor
+ */
+STATPAGE::~STATPAGE()
+{
+  if(_Header != NULL)
+  {
+    // Only the process which has created the page marks it as stopped (not its workers)
+    if(_Slot != -1 && _Header->Pid == getpid())
+    {
+      _Header->Pid = 0;
+    }
+
+    munmap(_Header, _Size);
+  }
+
+  if(_FileId != -1)
+  {
+    close(_FileId);
+  }
+}
+
+
+
+/**
+ * \brief          Selects the slot updated by the current process (server side)
+ *
+ * \param Slot     Index of the slot
+ */
+void STATPAGE::SetSlot(int Slot)
+{
+  if(Slot < 0 || Slot >= (int)_Header->SlotCount)
+  {
+    throw EXCEPTION("Slot index is out of range");
+  }
+
+  _Slot = Slot;
+  _NextMs = 0;
+}
+
+
+
+/**
+ * \brief          Updates the slot of the current process once its interval has elapsed (server side)
+ *
+ * \return         Time left before the next update (in milliseconds)
+ */
+int STATPAGE::Publish()
+{
+  long long NowMs = CLOCK::GetMonotonicMs();
+
+  if(NowMs < _NextMs)
+  {
+    return (int)(_NextMs - NowMs);
+  }
+
+  STAT_SLOT* Slot = GetSlot(_Slot);
+
+  long long* Values = (long long*)(Slot + 1);
+
+  HISTOGRAM_DATA* Histograms = (HISTOGRAM_DATA*)(Values + METRIC_ID_COUNT);
+
+  // Single writer : the sequence number alone tells the readers to retry
+  __sync_fetch_and_add(&Slot->Sequence, 1);
+
+  Slot->Pid = getpid();
+  Slot->TimeNs = CLOCK::GetMonotonicNs();
+
+  METRICS::ReadAll(Values);
+
+  for(int Id = 0; Id < HISTOGRAM_ID_COUNT; Id++)
+  {
+    METRICS::ReadHistogram((HISTOGRAM_ID)Id, Histograms[Id]);
+  }
+
+  __sync_fetch_and_add(&Slot->Sequence, 1);
+
+  _NextMs = NowMs + _Header->IntervalMs;
+
+  return _Header->IntervalMs;
+}
+
+
+
+/**
+ * \brief          Reads a consistent copy of a slot (no system call)
+ *
+ * \param Slot     Index of the slot
+ * \param Snapshot Copy of the slot
+ */
+void STATPAGE::Snapshot(int Slot, STAT_SNAPSHOT& Snapshot) const
+{
+  const STAT_SLOT* Source = GetSlot(Slot);
+
+  const long long* Values = (const long long*)(Source + 1);
+
+  const HISTOGRAM_DATA* Histograms = (const HISTOGRAM_DATA*)(Values + _Header->MetricCount);
+
+  Snapshot.Values.resize(_Header->MetricCount);
+  Snapshot.Histograms.resize(_Header->HistogramCount);
+
+  unsigned Sequence;
+
+  do
+  {
+    Sequence = Source->Sequence;
+
+    __sync_synchronize();
+
+    Snapshot.Pid = Source->Pid;
+    Snapshot.TimeNs = Source->TimeNs;
+
+    memcpy(&Snapshot.Values[0], Values, Snapshot.Values.size() * sizeof(long long));
+    memcpy(&Snapshot.Histograms[0], Histograms, Snapshot.Histograms.size() * sizeof(HISTOGRAM_DATA));
+
+    __sync_synchronize();
+  }
+  while((Sequence & 1) || Sequence != Source->Sequence);
+}
+
+
+
+/**
+ * \brief          Getter for the number of slots
+ *
+ * \return         Number of slots of the page
+ */
+int STATPAGE::GetSlotCount() const
+{
+  return _Header->SlotCount;
+}
+
+
+
+/**
+ * \brief          Getter for the number of metrics
+ *
+ * \return         Number of metrics of each slot
+ */
+int STATPAGE::GetMetricCount() const
+{
+  return _Header->MetricCount;
+}
+
+
+
+/**
+ * \brief          Getter for the number of histograms
+ *
+ * \return         Number of histograms of each slot
+ */
+int STATPAGE::GetHistogramCount() const
+{
+  return _Header->HistogramCount;
+}
+
+
+
+/**
+ * \brief          Getter for the description of a metric or a histogram
+ *
+ * \param Index    Index of the metric (the histograms follow the metrics)
+ *
+ * \return         Description written in the page
+ */
+const STAT_NAME& STATPAGE::GetName(int Index) const
+{
+  return _Names[Index];
+}
+
+
+
+/**
+ * \brief          Getter for the interval between two updates of a slot
+ *
+ * \return         Interval (in milliseconds)
+ */
+int STATPAGE::GetInterval() const
+{
+  return _Header->IntervalMs;
+}
+
+
+
+/**
+ * \brief          Tells if the server publishing the page is still running
+ *
+ * \return         \b true if the page is alive
+ * \return         \b false if the server has stopped (the path may hold a newer page)
+ */
+bool STATPAGE::IsAlive() const
+{
+  return (_Header->Pid != 0);
+}
+
+
+
+/**
+ * \brief          Maps the page file
+ *
+ * \param Size     Size of the file (in bytes)
+ * \param Writable Mapping of the server (the readers only read the page)
+ */
+void STATPAGE::Map(size_t Size, bool Writable)
+{
+  void* Memory = mmap(NULL, Size, Writable ? PROT_READ | PROT_WRITE : PROT_READ, MAP_SHARED, _FileId, 0);
+
+  if(Memory == MAP_FAILED)
+  {
+    throw EXCEPTION("Error mapping stats page");
+  }
+
+  _Header = (STAT_HEADER*)Memory;
+  _Size = Size;
+}
+
+
+
+/**
+ * \brief          Getter for the header of a slot
+ *
+ * \param Slot     Index of the slot
+ *
+ * \return         Header of the slot
+ */
+STAT_SLOT* STATPAGE::GetSlot(int Slot) const
+{
+  return (STAT_SLOT*)((char*)_Header + _Header->SlotOffset + (size_t)Slot * _Header->SlotSize);
+}
@@ -11,6 +11,7 @@
 // Standard headers
 #include <pthread.h>
 #include <signal.h>
+#include <sched.h>
 
 // Project headers
 #include "thread.h"
@@ -27,9 +28,11 @@
  * \param Proc   Pointer to function used to run thread
  *
  * \param Arg    Argument to pass to the function
+ *
+ * \param Joinable Flag telling if the thread end can be waited for (detached otherwise)
  */
-THREAD::THREAD(void* (*Proc)(void*), void* Arg)
-: OBJECT("THREAD"), _Procedure(Proc), _Argument(Arg)
+THREAD::THREAD(void* (*Proc)(void*), void* Arg, bool Joinable)
+: OBJECT("THREAD"), _Procedure(Proc), _Argument(Arg), _Ended(true)
 {
 #ifdef DEBUG
   App().Console.LogCtor(_ObjName);
@@ -42,17 +45,15 @@ THREAD::THREAD(void* (*Proc)(void*), void* Arg)
   }
 
   // Set the attributes with detached proprety at thread creation
-  if(pthread_attr_setdetachstate(&_Attr, PTHREAD_CREATE_DETACHED) != 0)
+  if(pthread_attr_setdetachstate(&_Attr, Joinable ? PTHREAD_CREATE_JOINABLE : PTHREAD_CREATE_DETACHED) != 0)
   {
     throw EXCEPTION("Error setting thread attributes");
   }
 
-  // Blocks all signals except SEGV, ABORT, INT, TERM
+  // Blocks all signals except SEGV, ABORT (INT, TERM and HUP are read by the main loop)
   if(sigfillset(&_SigMask) != 0          ||
      sigdelset(&_SigMask, SIGSEGV) != 0  ||
-     sigdelset(&_SigMask, SIGABRT) != 0  ||
-     sigdelset(&_SigMask, SIGINT)  != 0  ||
-     sigdelset(&_SigMask, SIGTERM) != 0  )
+     sigdelset(&_SigMask, SIGABRT) != 0  )
   {
     throw EXCEPTION("Error setting thread signal mask");
   }
@@ -69,10 +70,7 @@ THREAD::~THREAD()
   App().Console.LogDtor(_ObjName);
 #endif
 
-  if(pthread_cancel(_ThreadId) != 0)
-  {
-    throw EXCEPTION("Error cancelling thread");
-  }
+  Cancel();
 
   if(pthread_attr_destroy(&_Attr) != 0)
   {
@@ -87,13 +85,13 @@ THREAD::~THREAD()
  */
 void THREAD::Run()
 {
-  if(pthread_sigmask(SIG_SETMASK, &_SigMask, NULL) != 0)
-  {
-    throw EXCEPTION("Error setting signal mask for thread");
-  }
+  // A thread never run is not cancelled
+  _Ended = false;
 
   if(pthread_create(&_ThreadId, &_Attr, ThreadFunction, this) != 0)
   {
+    _Ended = true;
+
     throw EXCEPTION("Error creating thread");
   }
 }
@@ -105,11 +103,66 @@ void THREAD::Run()
  */
 void THREAD::Cancel()
 {
+  // A thread already ended cannot be cancelled, a thread stopping itself just returns from its function
+  if(_Ended || pthread_equal(pthread_self(), _ThreadId))
+  {
+    return;
+  }
 
   if(pthread_cancel(_ThreadId) != 0)
   {
     throw EXCEPTION("Error cancelling thread");
   }
+
+  _Ended = true;
+}
+
+
+
+/**
+ * \brief        Waits for the end of the thread (joinable threads only)
+ */
+void THREAD::Join()
+{
+  if(pthread_join(_ThreadId, NULL) != 0)
+  {
+    throw EXCEPTION("Error joining thread");
+  }
+
+  _Ended = true;
+}
+
+
+
+/**
+ * \brief        Binds the thread to a processor (before it starts)
+ *
+ * \param Cpu    Processor index
+ */
+void THREAD::SetAffinity(int Cpu)
+{
+  cpu_set_t CpuSet;
+
+  CPU_ZERO(&CpuSet);
+  CPU_SET(Cpu, &CpuSet);
+
+  if(pthread_attr_setaffinity_np(&_Attr, sizeof(CpuSet), &CpuSet) != 0)
+  {
+    throw EXCEPTION("Error setting thread affinity");
+  }
+}
+
+
+
+/**
+ * \brief        Tells if the calling thread is this thread
+ *
+ * \return       \b true if called from the thread itself
+ * \return       \b false otherwise
+ */
+bool THREAD::IsCurrent() const
+{
+  return pthread_equal(pthread_self(), _ThreadId);
 }
 
 
@@ -125,6 +178,9 @@ void* THREAD::ThreadFunction(void* Arg)
 {
   THREAD& ThisThread = *(THREAD*)Arg;
 
+  // The mask is set by the thread itself, the creating thread keeps its own
+  pthread_sigmask(SIG_SETMASK, &ThisThread._SigMask, NULL);
+
   pthread_setcanceltype(PTHREAD_CANCEL_ASYNCHRONOUS, NULL);
 
   pthread_setcancelstate(PTHREAD_CANCEL_ENABLE, NULL);
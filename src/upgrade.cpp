@@ -0,0 +1,394 @@
+/**
+ * \file upgrade.cpp
+ *
+ * \brief Module for sockets handover between processes (hot upgrade)
+ *
+ * \author Olivier de BLIC
+ */
+
+
+
+// Standard headers
+#include <string>
+#include <vector>
+#include <map>
+#include <utility>
+#include <string.h>
+#include <unistd.h>
+#include <errno.h>
+#include <sys/socket.h>
+#include <sys/un.h>
+
+// Project headers
+#include "upgrade.h"
+#include "application.h"
+#include "exception.h"
+
+// Constant values
+#define RECORDS_PER_MESSAGE     (250)
+#define HANDOVER_TIMEOUT_S      (5)
+#define HANDOVER_ACK            'A'
+
+
+
+/**
+ * \brief          Upgrade socket constructor
+ *
+ * \param Path     Path of the Unix socket
+ */
+UPGRADE::UPGRADE(const std::string& Path)
+: OBJECT("UPGRADE"), _Path(Path), _SocketId(-1), _HandedOver(false)
+{
+  if(Path.length() >= sizeof(((sockaddr_un*)NULL)->sun_path))
+  {
+    throw EXCEPTION("Upgrade socket path is too long");
+  }
+}
+
+
+
+/**
+ * \brief          Upgrade socket destructor
+ */
+UPGRADE::~UPGRADE()
+{
+  if(_SocketId != -1)
+  {
+    close(_SocketId);
+
+    if(! _HandedOver)
+    {
+      unlink(_Path.c_str());
+    }
+  }
+}
+
+
+
+/**
+ * \brief          Takes the sockets over from a running process, if any
+ *
+ * \param Listeners    Received listening sockets (with their namespace)
+ * \param Connections  Received connections
+ * \param Leases       Identifiers leased by each received connection (in the order of the connections)
+ *
+ * \return         \b true if the sockets have been taken over
+ * \return         \b false if no process was running
+ */
+bool UPGRADE::TakeOver(std::vector<HANDOVER>& Listeners, std::vector<HANDOVER>& Connections, std::vector<ID_RANGES>& Leases)
+{
+  sockaddr_un Addr;
+
+  memset(&Addr, 0, sizeof(Addr));
+  Addr.sun_family = AF_UNIX;
+  strcpy(Addr.sun_path, _Path.c_str());
+
+  int PeerId = socket(AF_UNIX, SOCK_SEQPACKET | SOCK_CLOEXEC, 0);
+
+  if(PeerId == -1)
+  {
+    throw EXCEPTION("Error creating upgrade socket");
+  }
+
+  // Nobody listening means a fresh start
+  if(connect(PeerId, (sockaddr*)&Addr, sizeof(Addr)) == -1)
+  {
+    close(PeerId);
+    return false;
+  }
+
+  struct timeval Timeout = {HANDOVER_TIMEOUT_S, 0};
+
+  setsockopt(PeerId, SOL_SOCKET, SO_RCVTIMEO, &Timeout, sizeof(Timeout));
+
+  RECORD Records[RECORDS_PER_MESSAGE];
+
+  char Control[CMSG_SPACE(RECORDS_PER_MESSAGE * sizeof(int))];
+
+  // Connections by namespace and host identifier, for their lease records
+  std::map<std::pair<int, int>, size_t> Owners;
+
+  while(true)
+  {
+    struct iovec Vector = {Records, sizeof(Records)};
+
+    struct msghdr Message;
+
+    memset(&Message, 0, sizeof(Message));
+    Message.msg_iov = &Vector;
+    Message.msg_iovlen = 1;
+    Message.msg_control = Control;
+    Message.msg_controllen = sizeof(Control);
+
+    ssize_t Length = recvmsg(PeerId, &Message, MSG_CMSG_CLOEXEC);
+
+    if(Length <= 0 || (Message.msg_flags & (MSG_TRUNC | MSG_CTRUNC)))
+    {
+      close(PeerId);
+      throw EXCEPTION("Error receiving sockets from the running process");
+    }
+
+    size_t Count = Length / sizeof(RECORD);
+
+    if(Count == 1 && Records[0].Kind == RECORD_END)
+    {
+      break;
+    }
+
+    // Lease records come without any socket, after all the connections
+    if(Records[0].Kind == RECORD_LEASE)
+    {
+      for(size_t Index = 0; Index < Count; Index++)
+      {
+        std::map<std::pair<int, int>, size_t>::iterator Owner = Owners.find(std::make_pair(Records[Index].State.Namespace, Records[Index].State.HostId));
+
+        if(Records[Index].Kind != RECORD_LEASE || Owner == Owners.end())
+        {
+          close(PeerId);
+          throw EXCEPTION("Lease of an unknown connection in handover message");
+        }
+
+        Leases[Owner->second].push_back(std::make_pair(Records[Index].Range[0], Records[Index].Range[1]));
+      }
+
+      continue;
+    }
+
+    struct cmsghdr* Header = CMSG_FIRSTHDR(&Message);
+
+    if(Header == NULL || Header->cmsg_type != SCM_RIGHTS || Header->cmsg_len != CMSG_LEN(Count * sizeof(int)))
+    {
+      close(PeerId);
+      throw EXCEPTION("Sockets missing in handover message");
+    }
+
+    int* SocketIds = (int*)CMSG_DATA(Header);
+
+    for(size_t Index = 0; Index < Count; Index++)
+    {
+      Records[Index].State.SocketId = SocketIds[Index];
+
+      if(Records[Index].Kind == RECORD_LISTENER)
+      {
+        Listeners.push_back(Records[Index].State);
+      }
+      else
+      {
+        Owners[std::make_pair(Records[Index].State.Namespace, Records[Index].State.HostId)] = Connections.size();
+
+        Connections.push_back(Records[Index].State);
+        Leases.push_back(ID_RANGES());
+      }
+    }
+  }
+
+  // The running process exits once it knows all the sockets are received
+  char Ack = HANDOVER_ACK;
+
+  send(PeerId, &Ack, sizeof(Ack), MSG_NOSIGNAL);
+
+  close(PeerId);
+
+  return true;
+}
+
+
+
+/**
+ * \brief          Listens for a new process taking the sockets over
+ */
+void UPGRADE::Listen()
+{
+  sockaddr_un Addr;
+
+  memset(&Addr, 0, sizeof(Addr));
+  Addr.sun_family = AF_UNIX;
+  strcpy(Addr.sun_path, _Path.c_str());
+
+  _SocketId = socket(AF_UNIX, SOCK_SEQPACKET | SOCK_CLOEXEC, 0);
+
+  if(_SocketId == -1)
+  {
+    throw EXCEPTION("Error creating upgrade socket");
+  }
+
+  // The path of a previous process is taken over too
+  unlink(_Path.c_str());
+
+  if(bind(_SocketId, (sockaddr*)&Addr, sizeof(Addr)) == -1 || listen(_SocketId, 1) == -1)
+  {
+    throw EXCEPTION("Error listening on upgrade socket");
+  }
+  else
+  {
+    LOG_LINE(LOG_INFO, "Upgrade socket now listening on %s", _Path);
+  }
+}
+
+
+
+/**
+ * \brief          Hands the sockets over to the new process which has connected
+ *
+ * \param Listeners    Listening sockets (with their namespace)
+ * \param Connections  Frozen connections
+ * \param Leases       Identifiers leased by each frozen connection (in the order of the connections)
+ */
+void UPGRADE::HandOver(const std::vector<HANDOVER>& Listeners, const std::vector<HANDOVER>& Connections, const std::vector<ID_RANGES>& Leases)
+{
+  int PeerId = accept4(_SocketId, NULL, NULL, SOCK_CLOEXEC);
+
+  if(PeerId == -1)
+  {
+    throw EXCEPTION("Error accepting the new process");
+  }
+
+  struct timeval Timeout = {HANDOVER_TIMEOUT_S, 0};
+
+  setsockopt(PeerId, SOL_SOCKET, SO_RCVTIMEO, &Timeout, sizeof(Timeout));
+  setsockopt(PeerId, SOL_SOCKET, SO_SNDTIMEO, &Timeout, sizeof(Timeout));
+
+  RECORD Records[RECORDS_PER_MESSAGE];
+
+  memset(Records, 0, sizeof(Records));
+
+  size_t Count = 0;
+
+  try
+  {
+    for(size_t Index = 0; Index < Listeners.size() + Connections.size(); Index++)
+    {
+      if(Index < Listeners.size())
+      {
+        Records[Count].Kind = RECORD_LISTENER;
+        Records[Count].State = Listeners[Index];
+      }
+      else
+      {
+        Records[Count].Kind = RECORD_CONNECTION;
+        Records[Count].State = Connections[Index - Listeners.size()];
+      }
+
+      if(++Count == RECORDS_PER_MESSAGE)
+      {
+        SendRecords(PeerId, Records, Count);
+        Count = 0;
+      }
+    }
+
+    if(Count > 0)
+    {
+      SendRecords(PeerId, Records, Count);
+      Count = 0;
+    }
+
+    memset(Records, 0, sizeof(Records));
+
+    // A record per leased range, in messages of their own
+    for(size_t Index = 0; Index < Leases.size(); Index++)
+    {
+      for(size_t Range = 0; Range < Leases[Index].size(); Range++)
+      {
+        Records[Count].Kind = RECORD_LEASE;
+        Records[Count].State.Namespace = Connections[Index].Namespace;
+        Records[Count].State.HostId = Connections[Index].HostId;
+        Records[Count].Range[0] = Leases[Index][Range].first;
+        Records[Count].Range[1] = Leases[Index][Range].second;
+
+        if(++Count == RECORDS_PER_MESSAGE)
+        {
+          SendRecords(PeerId, Records, Count);
+          Count = 0;
+        }
+      }
+    }
+
+    if(Count > 0)
+    {
+      SendRecords(PeerId, Records, Count);
+    }
+
+    memset(&Records[0], 0, sizeof(RECORD));
+    Records[0].Kind = RECORD_END;
+
+    SendRecords(PeerId, Records, 1);
+
+    char Ack = 0;
+
+    if(recv(PeerId, &Ack, sizeof(Ack), 0) != sizeof(Ack) || Ack != HANDOVER_ACK)
+    {
+      throw EXCEPTION("The new process has not acknowledged the handover");
+    }
+  }
+
+  catch(EXCEPTION Exception)
+  {
+    close(PeerId);
+    throw;
+  }
+
+  close(PeerId);
+
+  _HandedOver = true;
+}
+
+
+
+/**
+ * \brief          Socket identifier getter
+ *
+ * \return         Socket identifier (-1 if not listening)
+ */
+int UPGRADE::GetId() const
+{
+  return _SocketId;
+}
+
+
+
+/**
+ * \brief          Sends records with their sockets in a single message
+ *
+ * \param PeerId   Socket identifier of the new process
+ * \param Records  Records to send
+ * \param Count    Number of records
+ */
+void UPGRADE::SendRecords(int PeerId, const RECORD* Records, size_t Count)
+{
+  char Control[CMSG_SPACE(RECORDS_PER_MESSAGE * sizeof(int))];
+
+  struct iovec Vector = {(void*)Records, Count * sizeof(RECORD)};
+
+  struct msghdr Message;
+
+  memset(&Message, 0, sizeof(Message));
+  Message.msg_iov = &Vector;
+  Message.msg_iovlen = 1;
+
+  // Lease records and the end record come without any socket
+  if(Records[0].Kind != RECORD_END && Records[0].Kind != RECORD_LEASE)
+  {
+    memset(Control, 0, sizeof(Control));
+
+    Message.msg_control = Control;
+    Message.msg_controllen = CMSG_SPACE(Count * sizeof(int));
+
+    struct cmsghdr* Header = CMSG_FIRSTHDR(&Message);
+
+    Header->cmsg_level = SOL_SOCKET;
+    Header->cmsg_type = SCM_RIGHTS;
+    Header->cmsg_len = CMSG_LEN(Count * sizeof(int));
+
+    int* SocketIds = (int*)CMSG_DATA(Header);
+
+    for(size_t Index = 0; Index < Count; Index++)
+    {
+      SocketIds[Index] = Records[Index].State.SocketId;
+    }
+  }
+
+  if(sendmsg(PeerId, &Message, MSG_NOSIGNAL) != (ssize_t)(Count * sizeof(RECORD)))
+  {
+    throw EXCEPTION("Error sending sockets to the new process");
+  }
+}
@@ -0,0 +1,438 @@
+/**
+ * \file workers.cpp
+ *
+ * \brief Module for worker processes (prefork mode)
+ *
+ * \author Olivier de BLIC
+ */
+
+
+
+// Standard headers
+#include <vector>
+#include <string.h>
+#include <unistd.h>
+#include <errno.h>
+#include <signal.h>
+#include <sys/mman.h>
+#include <sys/prctl.h>
+#include <sys/socket.h>
+#include <sys/wait.h>
+
+// Project headers
+#include "workers.h"
+#include "application.h"
+#include "exception.h"
+
+
+
+/**
+ * \brief          Workers pool constructor
+ *
+ * \param Count      Number of worker processes
+ * \param IdCapacity Number of host identifiers shared by the workers (in each namespace)
+ * \param Namespaces Number of identifiers namespaces
+ */
+WORKERS::WORKERS(int Count, unsigned int IdCapacity, int Namespaces)
+: OBJECT("WORKERS"), _Count(Count), _Namespaces(Namespaces), _Index(-1), _Pids(Count, -1), _Channels(Count, -1), _Dispatched(Count, 0), _Memory(NULL), _Size(0), _Slots(NULL), _Counts(NULL), _Stride(0)
+{
+  _Stride = (Namespaces * sizeof(int) + sizeof(WORKER_SLOT) - 1) / sizeof(WORKER_SLOT) * sizeof(WORKER_SLOT) / sizeof(int);
+
+  size_t CountsOffset = Count * sizeof(WORKER_SLOT);
+  size_t IdsOffset = CountsOffset + Count * _Stride * sizeof(int);
+
+  _Size = IdsOffset + Namespaces * ALLOCATOR::GetMemorySize(IdCapacity);
+
+  // The segment is inherited by the workers (its content is zeroed by the system)
+  _Memory = mmap(NULL, _Size, PROT_READ | PROT_WRITE, MAP_SHARED | MAP_ANONYMOUS, -1, 0);
+
+  if(_Memory == MAP_FAILED)
+  {
+    throw EXCEPTION("Error creating shared memory segment");
+  }
+
+  _Slots = (WORKER_SLOT*)_Memory;
+
+  _Counts = (volatile int*)((char*)_Memory + CountsOffset);
+
+  for(int Namespace = 0; Namespace < Namespaces; Namespace++)
+  {
+    _Allocators.push_back(new ALLOCATOR(IdCapacity, (char*)_Memory + IdsOffset + Namespace * ALLOCATOR::GetMemorySize(IdCapacity), false));
+  }
+}
+
+
+
+/**
+ * \brief          Workers pool destructor
+ */
+WORKERS::~WORKERS()
+{
+  for(int Index = 0; Index < _Count; Index++)
+  {
+    if(_Channels[Index] != -1)
+    {
+      close(_Channels[Index]);
+    }
+  }
+
+  for(size_t Namespace = 0; Namespace < _Allocators.size(); Namespace++)
+  {
+    delete _Allocators[Namespace];
+  }
+
+  munmap(_Memory, _Size);
+}
+
+
+
+/**
+ * \brief          Starts the worker processes (before any thread is created)
+ *
+ * \return         \b true in a worker process
+ * \return         \b false in the master process
+ */
+bool WORKERS::Spawn()
+{
+  std::vector<int> WorkerEnds(_Count, -1);
+
+  for(int Index = 0; Index < _Count; Index++)
+  {
+    int Pair[2];
+
+    if(socketpair(AF_UNIX, SOCK_SEQPACKET | SOCK_CLOEXEC, 0, Pair) == -1)
+    {
+      throw EXCEPTION("Error creating worker channel");
+    }
+
+    _Channels[Index] = Pair[0];
+    WorkerEnds[Index] = Pair[1];
+  }
+
+  pid_t MasterPid = getpid();
+
+  for(int Index = 0; Index < _Count; Index++)
+  {
+    pid_t Pid = fork();
+
+    if(Pid == -1)
+    {
+      throw EXCEPTION("Error starting worker process");
+    }
+
+    if(Pid == 0)
+    {
+      _Index = Index;
+
+      // A worker only keeps its own end of its own channel
+      for(int Other = 0; Other < _Count; Other++)
+      {
+        close(_Channels[Other]);
+
+        if(Other != Index)
+        {
+          close(WorkerEnds[Other]);
+        }
+
+        _Channels[Other] = -1;
+      }
+
+      _Channels[Index] = WorkerEnds[Index];
+
+      // Workers stop with the master (the signal is read from the signal descriptor)
+      prctl(PR_SET_PDEATHSIG, SIGTERM);
+
+      if(getppid() != MasterPid)
+      {
+        kill(getpid(), SIGTERM);
+      }
+
+      return true;
+    }
+
+    _Pids[Index] = Pid;
+    _Slots[Index].Alive = 1;
+  }
+
+  for(int Index = 0; Index < _Count; Index++)
+  {
+    close(WorkerEnds[Index]);
+  }
+
+  LOG_LINE(LOG_INFO, "%d worker process(es) started", _Count);
+
+  return false;
+}
+
+
+
+/**
+ * \brief          Passes an accepted connection to the least loaded worker (master only)
+ *
+ * \param SocketId Socket identifier of the connection (still to close by the caller)
+ * \param Namespace Identifiers namespace of the connection
+ */
+void WORKERS::Dispatch(int SocketId, int Namespace)
+{
+  int Selected = -1;
+
+  int MinLoad = 0;
+
+  // Connections sent but not received yet are part of the load
+  for(int Index = 0; Index < _Count; Index++)
+  {
+    if(_Slots[Index].Alive)
+    {
+      int Load = _Slots[Index].Active + (int)(_Dispatched[Index] - _Slots[Index].Received);
+
+      if(Selected == -1 || Load < MinLoad)
+      {
+        Selected = Index;
+        MinLoad = Load;
+      }
+    }
+  }
+
+  if(Selected == -1)
+  {
+    throw EXCEPTION("Connection dropped (no worker running)");
+  }
+
+  char Control[CMSG_SPACE(sizeof(int))];
+
+  // The namespace comes as the data of the message
+  unsigned char Data = Namespace;
+
+  struct iovec Vector = {&Data, sizeof(Data)};
+
+  struct msghdr Message;
+
+  memset(&Message, 0, sizeof(Message));
+  memset(Control, 0, sizeof(Control));
+
+  Message.msg_iov = &Vector;
+  Message.msg_iovlen = 1;
+  Message.msg_control = Control;
+  Message.msg_controllen = sizeof(Control);
+
+  struct cmsghdr* Header = CMSG_FIRSTHDR(&Message);
+
+  Header->cmsg_level = SOL_SOCKET;
+  Header->cmsg_type = SCM_RIGHTS;
+  Header->cmsg_len = CMSG_LEN(sizeof(int));
+
+  memcpy(CMSG_DATA(Header), &SocketId, sizeof(int));
+
+  // Several acceptors may dispatch at the same time
+  __sync_fetch_and_add(&_Dispatched[Selected], 1);
+
+  // A worker which does not read its channel must not block the acceptor
+  if(sendmsg(_Channels[Selected], &Message, MSG_DONTWAIT | MSG_NOSIGNAL) != sizeof(Data))
+  {
+    __sync_fetch_and_sub(&_Dispatched[Selected], 1);
+
+    throw EXCEPTION("Connection dropped (worker channel is full)");
+  }
+}
+
+
+
+/**
+ * \brief          Receives a connection passed by the master (worker only)
+ *
+ * \param Namespace Identifiers namespace of the connection
+ *
+ * \return         Socket identifier of the connection (-1 if none is waiting)
+ */
+int WORKERS::Receive(int& Namespace)
+{
+  char Control[CMSG_SPACE(sizeof(int))];
+
+  unsigned char Data = 0;
+
+  struct iovec Vector = {&Data, sizeof(Data)};
+
+  struct msghdr Message;
+
+  memset(&Message, 0, sizeof(Message));
+
+  Message.msg_iov = &Vector;
+  Message.msg_iovlen = 1;
+  Message.msg_control = Control;
+  Message.msg_controllen = sizeof(Control);
+
+  ssize_t Length = recvmsg(_Channels[_Index], &Message, MSG_DONTWAIT | MSG_CMSG_CLOEXEC);
+
+  if(Length == -1 && (errno == EAGAIN || errno == EWOULDBLOCK || errno == EINTR))
+  {
+    return -1;
+  }
+
+  if(Length <= 0)
+  {
+    close(_Channels[_Index]);
+    _Channels[_Index] = -1;
+
+    throw EXCEPTION("Channel from the master process closed");
+  }
+
+  __sync_fetch_and_add(&_Slots[_Index].Received, 1);
+
+  struct cmsghdr* Header = CMSG_FIRSTHDR(&Message);
+
+  if(Header == NULL || Header->cmsg_type != SCM_RIGHTS || Header->cmsg_len != CMSG_LEN(sizeof(int)))
+  {
+    throw EXCEPTION("Connection missing in message from the master process");
+  }
+
+  int SocketId;
+
+  memcpy(&SocketId, CMSG_DATA(Header), sizeof(int));
+
+  Namespace = Data;
+
+  return SocketId;
+}
+
+
+
+/**
+ * \brief          Stops the worker processes and waits for them (master only)
+ */
+void WORKERS::Stop()
+{
+  for(int Index = 0; Index < _Count; Index++)
+  {
+    if(_Slots[Index].Alive)
+    {
+      kill(_Pids[Index], SIGTERM);
+    }
+  }
+
+  // Each worker says goodbye to its own clients
+  for(int Index = 0; Index < _Count; Index++)
+  {
+    if(_Slots[Index].Alive)
+    {
+      waitpid(_Pids[Index], NULL, 0);
+
+      _Slots[Index].Alive = 0;
+      _Slots[Index].Active = 0;
+
+      memset((void*)&_Counts[Index * _Stride], 0, _Namespaces * sizeof(int));
+    }
+  }
+}
+
+
+
+/**
+ * \brief          Collects the worker processes which have exited (master only)
+ *
+ * \param Exited   Indexes of the workers which have exited
+ */
+void WORKERS::Reap(std::vector<int>& Exited)
+{
+  for(int Index = 0; Index < _Count; Index++)
+  {
+    if(_Slots[Index].Alive && waitpid(_Pids[Index], NULL, WNOHANG) == _Pids[Index])
+    {
+      LOG_LINE(LOG_ERROR, "Worker process %d has exited, %d client(s) lost", (int)_Pids[Index], (int)_Slots[Index].Active);
+
+      // The system has closed its connections : they are no longer counted
+      _Slots[Index].Alive = 0;
+      _Slots[Index].Active = 0;
+
+      memset((void*)&_Counts[Index * _Stride], 0, _Namespaces * sizeof(int));
+
+      Exited.push_back(Index);
+    }
+  }
+}
+
+
+
+/**
+ * \brief          Updates the number of connections run by the current worker
+ *
+ * \param Namespace Identifiers namespace of the connections
+ * \param Delta    Number of connections added (negative if removed)
+ */
+void WORKERS::Update(int Namespace, int Delta)
+{
+  __sync_fetch_and_add(&_Slots[_Index].Active, Delta);
+
+  __sync_fetch_and_add(&_Counts[_Index * _Stride + Namespace], Delta);
+}
+
+
+
+/**
+ * \brief          Getter for the number of connections of the whole server
+ *
+ * \param Namespace Identifiers namespace
+ *
+ * \return         Number of connections of the namespace run by all the workers
+ */
+int WORKERS::GetCount(int Namespace) const
+{
+  int Count = 0;
+
+  for(int Index = 0; Index < _Count; Index++)
+  {
+    Count += _Counts[Index * _Stride + Namespace];
+  }
+
+  return Count;
+}
+
+
+
+/**
+ * \brief          Getter for the host identifiers allocator shared by the workers
+ *
+ * \param Namespace Identifiers namespace
+ *
+ * \return         Reference to the allocator
+ */
+ALLOCATOR& WORKERS::GetAllocator(int Namespace)
+{
+  return *_Allocators[Namespace];
+}
+
+
+
+/**
+ * \brief          Getter for the socket identifier of the channel from the master (worker only)
+ *
+ * \return         Socket identifier (-1 if the master has left)
+ */
+int WORKERS::GetChannelId() const
+{
+  return _Channels[_Index];
+}
+
+
+
+/**
+ * \brief          Tells if the current process is the master
+ *
+ * \return         \b true in the master process
+ * \return         \b false in a worker process
+ */
+bool WORKERS::IsMaster() const
+{
+  return (_Index == -1);
+}
+
+
+
+/**
+ * \brief          Getter for the index of the current worker process
+ *
+ * \return         Index of the worker (-1 in the master process)
+ */
+int WORKERS::GetIndex() const
+{
+  return _Index;
+}